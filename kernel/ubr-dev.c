@@ -4,6 +4,7 @@
 
 #include <net/rtnetlink.h>
 
+#include "ubr-netlink.h"
 #include "ubr-private.h"
 
 void ubr_update_headroom(struct ubr *ubr, struct net_device *new_dev)
@@ -20,26 +21,162 @@ void ubr_update_headroom(struct ubr *ubr, struct net_device *new_dev)
 	}
 }
 
+/* Offloads the bridge can advertise, given that all ports have them */
+#define UBR_COMMON_FEATURES						\
+	(NETIF_F_SG | NETIF_F_FRAGLIST | NETIF_F_HIGHDMA |		\
+	 NETIF_F_GSO_MASK | NETIF_F_HW_CSUM)
+
+static void ubr_update_gso_limits(struct ubr *ubr)
+{
+	unsigned int gso_max_size = GSO_MAX_SIZE;
+	u16 gso_max_segs = GSO_MAX_SEGS;
+	unsigned pidx;
+
+	ubr_vec_foreach(&ubr->busy, pidx) {
+		struct net_device *dev = ubr->ports[pidx].dev;
+
+		if (!pidx)
+			continue;
+
+		gso_max_size = min(gso_max_size, dev->gso_max_size);
+		gso_max_segs = min(gso_max_segs, dev->gso_max_segs);
+	}
+
+	netif_set_gso_max_size(ubr->dev, gso_max_size);
+	netif_set_gso_max_segs(ubr->dev, gso_max_segs);
+}
+
+/*
+ * Recompute the offloads of the bridge device after a port joined,
+ * left or changed its features.  Host traffic is only segmented, or
+ * checksummed, in software if some port cannot do it.
+ */
+void ubr_update_features(struct ubr *ubr)
+{
+	ubr_update_gso_limits(ubr);
+	netdev_update_features(ubr->dev);
+}
+
+static netdev_features_t ubr_ndo_fix_features(struct net_device *dev,
+					      netdev_features_t features)
+{
+	struct ubr *ubr = netdev_priv(dev);
+	netdev_features_t mask = features;
+	unsigned pidx;
+
+	/* Without ports, keep whatever is requested */
+	if (bitmap_weight(ubr->busy.bitmap, UBR_MAX_PORTS) <= 1)
+		return features;
+
+	features &= ~NETIF_F_ONE_FOR_ALL;
+	ubr_vec_foreach(&ubr->busy, pidx) {
+		if (!pidx)
+			continue;
+
+		features = netdev_increment_features(features,
+						     ubr->ports[pidx].dev->features,
+						     mask);
+	}
+
+	return netdev_add_tso_features(features, mask);
+}
+
 netdev_tx_t ubr_ndo_start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct ubr *ubr = netdev_priv(dev);
 	struct ubr_cb *cb = ubr_cb(skb);
 
+	dev_sw_netstats_tx_add(dev, 1, skb->len);
 	skb_pull(skb, ETH_HLEN);
 
 	memcpy(cb, &ubr->ports[0].ingress_cb, sizeof(*cb));
 
-	if (ubr_forward(ubr, skb)) {
+	rcu_read_lock();
+	skb = ubr_forward(ubr, skb);
+	if (skb) {
 		/* The forward stage classified the frame as control
 		 * traffic, but the frame originates from the
 		 * host. Weird, but we dutifully loop it back for
 		 * symmetry's sake. */
 		dev_forward_skb(ubr->dev, skb);
 	}
+	rcu_read_unlock();
 
 	return NETDEV_TX_OK;
 }
 
+/*
+ * The pipeline state lives from ndo_init to ndo_uninit, which the core
+ * only runs once the device is closed and in-flight transmits are done,
+ * i.e. once nothing can look at VLAN 0 through port 0 anymore.
+ */
+static int ubr_ndo_init(struct net_device *dev)
+{
+	struct ubr *ubr = netdev_priv(dev);
+	struct ubr_port *p;
+	int err;
+
+	dev->tstats = netdev_alloc_pcpu_stats(struct pcpu_sw_netstats);
+	if (!dev->tstats)
+		return -ENOMEM;
+
+	err = gro_cells_init(&ubr->gro_cells, dev);
+	if (err)
+		goto err_free_tstats;
+
+	/* VLANs flush their FDB and neighbour entries on removal, so
+	 * both must outlive them. */
+	err = ubr_fdb_newlink(&ubr->fdb);
+	if (err)
+		goto err_gro_cells;
+
+	err = ubr_neigh_newlink(&ubr->neigh);
+	if (err)
+		goto err_fdb_dellink;
+
+	err = ubr_vlan_newlink(ubr);
+	if (err)
+		goto err_neigh_dellink;
+
+	p = ubr_port_init(ubr, 0, dev);
+	if (IS_ERR(p)) {
+		err = PTR_ERR(p);
+		goto err_vlan_dellink;
+	}
+
+	/* The stack takes frames regardless of our own link state */
+	ubr_vec_set(&ubr->active, 0);
+	return 0;
+
+err_vlan_dellink:
+	ubr_vlan_dellink(ubr);
+err_neigh_dellink:
+	ubr_neigh_dellink(&ubr->neigh);
+err_fdb_dellink:
+	ubr_fdb_dellink(&ubr->fdb);
+err_gro_cells:
+	gro_cells_destroy(&ubr->gro_cells);
+err_free_tstats:
+	free_percpu(dev->tstats);
+	return err;
+}
+
+static void ubr_ndo_uninit(struct net_device *dev)
+{
+	struct ubr *ubr = netdev_priv(dev);
+
+	mutex_lock(&ubr->cfg_lock);
+	ubr_flow_cache_set(ubr, 0);
+	ubr_vlan_dellink(ubr);
+	ubr_neigh_dellink(&ubr->neigh);
+	ubr_fdb_dellink(&ubr->fdb);
+	ubr_port_cleanup(&ubr->ports[0]);
+	mutex_unlock(&ubr->cfg_lock);
+
+	gro_cells_destroy(&ubr->gro_cells);
+	free_percpu(dev->tstats);
+}
+
 static int ubr_ndo_add_slave(struct net_device *dev,
 			     struct net_device *slave_dev,
 			     struct netlink_ext_ack *extack)
@@ -61,10 +198,10 @@ static int ubr_ndo_del_slave(struct net_device *dev,
 static const struct net_device_ops ubr_dev_ops = {
 	/* .ndo_open		 = br_dev_open, */
 	/* .ndo_stop		 = br_dev_stop, */
-	/* .ndo_init		 = br_dev_init, */
-	/* .ndo_uninit		 = br_dev_uninit, */
+	.ndo_init		 = ubr_ndo_init,
+	.ndo_uninit		 = ubr_ndo_uninit,
 	.ndo_start_xmit		 = ubr_ndo_start_xmit,
-	/* .ndo_get_stats64	 = br_get_stats64, */
+	.ndo_get_stats64	 = dev_get_tstats64,
 	/* .ndo_set_mac_address	 = br_set_mac_address, */
 	/* .ndo_set_rx_mode	 = br_dev_set_multicast_list, */
 	/* .ndo_change_rx_flags	 = br_dev_change_rx_flags, */
@@ -73,7 +210,7 @@ static const struct net_device_ops ubr_dev_ops = {
 
 	.ndo_add_slave		 = ubr_ndo_add_slave,
 	.ndo_del_slave		 = ubr_ndo_del_slave,
-	/* .ndo_fix_features        = br_fix_features, */
+	.ndo_fix_features	 = ubr_ndo_fix_features,
 	/* .ndo_fdb_add		 = br_fdb_add, */
 	/* .ndo_fdb_del		 = br_fdb_delete, */
 	/* .ndo_fdb_dump		 = br_fdb_dump, */
@@ -83,6 +220,55 @@ static const struct net_device_ops ubr_dev_ops = {
 	/* .ndo_features_check	 = passthru_features_check, */
 };
 
+static const struct nla_policy ubr_nl_bridge_policy[UBR_NLA_BRIDGE_MAX + 1] = {
+	[UBR_NLA_BRIDGE_UNSPEC]     = { .type = NLA_UNSPEC },
+	[UBR_NLA_BRIDGE_VLAN_PROTO] = { .type = NLA_U16 },
+	[UBR_NLA_BRIDGE_FLOW_CACHE] = { .type = NLA_U32 },
+};
+
+int ubr_dev_nl_set_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *attrs[UBR_NLA_BRIDGE_MAX + 1];
+	struct net_device *dev;
+	struct ubr *ubr;
+	int err;
+
+	if (!info->attrs || !info->attrs[UBR_NLA_BRIDGE])
+		return -EINVAL;
+
+	err = nla_parse_nested(attrs, UBR_NLA_BRIDGE_MAX,
+			       info->attrs[UBR_NLA_BRIDGE],
+			       ubr_nl_bridge_policy, info->extack);
+	if (err)
+		return err;
+
+	dev = ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+
+	if (attrs[UBR_NLA_BRIDGE_VLAN_PROTO]) {
+		err = ubr_vlan_proto_set(ubr,
+					 nla_get_u16(attrs[UBR_NLA_BRIDGE_VLAN_PROTO]));
+		if (err)
+			goto out;
+	}
+
+	if (attrs[UBR_NLA_BRIDGE_FLOW_CACHE]) {
+		err = ubr_flow_cache_set(ubr,
+					 nla_get_u32(attrs[UBR_NLA_BRIDGE_FLOW_CACHE]));
+		if (err)
+			goto out;
+	}
+
+	printk(KERN_NOTICE "Set bridge %s, VLAN protocol %#06x\n",
+	       dev->name, ubr->vlan_proto);
+out:
+	dev_put(dev);
+	return err;
+}
+
 static struct device_type ubr_dev_type = {
 	.name	= "ubr",
 };
@@ -95,8 +281,17 @@ void ubr_dev_setup(struct net_device *dev)
 	dev->netdev_ops = &ubr_dev_ops;
 	SET_NETDEV_DEVTYPE(dev, &ubr_dev_type);
 
-	dev->features = NETIF_F_NETNS_LOCAL | NETIF_F_HW_VLAN_CTAG_TX;
-	dev->hw_features = NETIF_F_HW_VLAN_CTAG_TX;
+	/* No qdisc and no TX lock, host traffic is forwarded on the
+	 * sending CPU.  The pipeline is per-CPU safe already, same as
+	 * for frames received on the ports.
+	 */
+	dev->priv_flags |= IFF_NO_QUEUE;
+
+	dev->features = UBR_COMMON_FEATURES | NETIF_F_NETNS_LOCAL |
+		NETIF_F_HW_VLAN_CTAG_TX | NETIF_F_HW_VLAN_STAG_TX | NETIF_F_LLTX;
+	dev->hw_features = UBR_COMMON_FEATURES | NETIF_F_HW_VLAN_CTAG_TX |
+		NETIF_F_HW_VLAN_STAG_TX;
+	dev->vlan_features = UBR_COMMON_FEATURES;
 }
 
 static int ubr_dev_newlink(struct net *src_net, struct net_device *dev,
@@ -104,38 +299,26 @@ static int ubr_dev_newlink(struct net *src_net, struct net_device *dev,
 			   struct netlink_ext_ack *extack)
 {
 	struct ubr *ubr = netdev_priv(dev);
-	int err;
 
 	printk(KERN_NOTICE "ubr: new bridge %s\n", dev->name);
 	memset(ubr, 0, sizeof(*ubr));
 
+	mutex_init(&ubr->cfg_lock);
 	ubr->dev = dev;
 	ubr->vlan_proto = ETH_P_8021Q;
 	hash_init(ubr->vlans);
 	hash_init(ubr->stps);
+#if IS_ENABLED(CONFIG_VXLAN)
+	hash_init(ubr->vnis);
+#endif
 
-	err = ubr_vlan_newlink(ubr);
-	if (err)
-		goto err;
+	/* Flood to all ports by default. */
+	ubr_vec_fill(&ubr->ucflood);
+	ubr_vec_fill(&ubr->mcflood);
+	ubr_vec_fill(&ubr->bcflood);
 
-	err = ubr_fdb_newlink(&ubr->fdb);
-	if (err)
-		goto err_vlan_dellink;
-
-	ubr_port_init(ubr, 0, dev);
-
-	err = register_netdevice(dev);
-	if (err)
-		goto err_fdb_dellink;
-
-	return 0;
-
-err_fdb_dellink:
-	ubr_fdb_dellink(&ubr->fdb);
-err_vlan_dellink:
-	ubr_vlan_dellink(ubr);
-err:
-	return err;
+	/* The rest is set up by ubr_ndo_init() */
+	return register_netdevice(dev);
 }
 
 void ubr_dev_dellink(struct net_device *dev, struct list_head *head)
@@ -151,8 +334,13 @@ void ubr_dev_dellink(struct net_device *dev, struct list_head *head)
 		ubr_port_del(ubr, ubr->ports[pidx].dev);
 	}
 
-	ubr_fdb_dellink(&ubr->fdb);
-	ubr_vlan_dellink(ubr);
+	/* Commands already waiting for the lock must find it dead.  The
+	 * pipeline state is freed by ubr_ndo_uninit(), the host may
+	 * still be transmitting until the device is unregistered.
+	 */
+	mutex_lock(&ubr->cfg_lock);
+	ubr->dead = true;
+	mutex_unlock(&ubr->cfg_lock);
 
 	unregister_netdevice_queue(ubr->dev, head);
 }
@@ -194,13 +382,20 @@ static int ubr_device_event(struct notifier_block *unused, unsigned long event,
 	/* 	ubr_mtu_auto_adjust(ubr); */
 	/* 	break; */
 
-	/* case NETDEV_CHANGE: */
-	/* 	ubr_port_carrier_check(p, &notified); */
-	/* 	break; */
+	case NETDEV_UP:
+	case NETDEV_DOWN:
+	case NETDEV_CHANGE:
+		mutex_lock(&ubr_from_port(p)->cfg_lock);
+		ubr_port_link_update(p);
+		mutex_unlock(&ubr_from_port(p)->cfg_lock);
+		break;
 
-	/* case NETDEV_FEAT_CHANGE: */
-	/* 	netdev_update_features(ubr->dev); */
-	/* 	break; */
+	case NETDEV_FEAT_CHANGE:
+		mutex_lock(&ubr_from_port(p)->cfg_lock);
+		ubr_port_update_offloads(p);
+		ubr_update_features(ubr_from_port(p));
+		mutex_unlock(&ubr_from_port(p)->cfg_lock);
+		break;
 
 	case NETDEV_UNREGISTER:
 		ubr_port_del(ubr_from_port(p), dev);
@@ -237,16 +432,22 @@ static int __init ubr_module_init(void)
 	if (err)
 		goto err_cache_fini;
 
-	err = rtnl_link_register(&ubr_link_ops);
+	err = ubr_switchdev_init();
 	if (err)
 		goto err_unreg_notifier;
 
+	err = rtnl_link_register(&ubr_link_ops);
+	if (err)
+		goto err_switchdev_fini;
+
 	err = ubr_netlink_init(&ubr_dev_ops);
 	if (err)
-		goto err_unreg_notifier;
+		goto err_switchdev_fini;
 
 	return 0;
 
+err_switchdev_fini:
+	ubr_switchdev_fini();
 err_unreg_notifier:
 	unregister_netdevice_notifier(&ubr_device_notifier);
 err_cache_fini:
@@ -259,7 +460,11 @@ static void __exit ubr_module_cleanup(void)
 {
 	ubr_netlink_exit();
 	rtnl_link_unregister(&ubr_link_ops);
+	ubr_switchdev_fini();
 	unregister_netdevice_notifier(&ubr_device_notifier);
+
+	/* Wait for pending RCU frees of nodes, VLANs and policers */
+	rcu_barrier();
 	ubr_fdb_cache_fini();
 }
 
@@ -1,14 +1,26 @@
 #include <linux/etherdevice.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/llist.h>
 #include <linux/rhashtable.h>
 #include <linux/slab.h>
 
+#include "ubr-netlink.h"
 #include "ubr-private.h"
 
 
+#define UBR_FDB_POOL_DEFAULT	256
+#define UBR_FDB_POOL_MAX	(1 << 16)
+
 struct kmem_cache *ubr_fdb_cache __read_mostly;
 
+/* Nodes removed by a flush, recycled together after a grace period */
+struct ubr_fdb_batch {
+	struct rcu_head rcu;
+	struct ubr_fdb_pool *pool;
+	struct llist_head nodes;
+};
+
 static const struct rhashtable_params ubr_rht_params = {
 	.head_offset = offsetof(struct ubr_fdb_node, rhnode),
 	.key_offset = offsetof(struct ubr_fdb_node, addr),
@@ -20,20 +32,284 @@ static void ubr_fdb_node_delete_rcu(struct rcu_head *rcu)
 {
 	struct ubr_fdb_node *node = container_of(rcu, struct ubr_fdb_node, rcu);
 
+	ubr_fdb_node_remote_put(node);
 	kmem_cache_free(ubr_fdb_cache, node);
 }
 
-static inline bool ubr_fdb_node_is_old(struct ubr_fdb *fdb,
-				       struct ubr_fdb_node *node)
+/*
+ * Hand out a zeroed node from this CPU's pool.  Must be called with
+ * BHs disabled, the pool is refilled from process context when it
+ * runs low.  With a pool size of zero, nodes come from the slab.
+ */
+static struct ubr_fdb_node *ubr_fdb_pool_get(struct ubr_fdb_pool *pool)
+{
+	struct ubr_fdb_pool_pcpu *pc;
+	struct ubr_fdb_node *node;
+	struct llist_node *free;
+	unsigned int size = READ_ONCE(pool->size);
+
+	if (unlikely(!size))
+		return kmem_cache_zalloc(ubr_fdb_cache, GFP_ATOMIC);
+
+	pc = this_cpu_ptr(pool->pcpu);
+	free = llist_del_first(&pc->free);
+	if (likely(free))
+		atomic_dec(&pc->avail);
+
+	if (unlikely(atomic_read(&pc->avail) < size / 2))
+		schedule_work(&pool->refill_work);
+
+	if (unlikely(!free))
+		return NULL;
+
+	node = llist_entry(free, struct ubr_fdb_node, free);
+	memset(node, 0, sizeof(*node));
+	return node;
+}
+
+/* Return an unpublished, or no longer referenced, node to this CPU's pool */
+static void ubr_fdb_pool_put(struct ubr_fdb_pool *pool,
+			     struct ubr_fdb_node *node)
 {
-	return (node->proto == UBR_FDB_DYNAMIC) &&
-		time_is_before_jiffies(node->tstamp + fdb->ageing_timeout);
+	struct ubr_fdb_pool_pcpu *pc = this_cpu_ptr(pool->pcpu);
+
+	ubr_fdb_node_remote_put(node);
+	if (atomic_read(&pc->avail) >= READ_ONCE(pool->size)) {
+		kmem_cache_free(ubr_fdb_cache, node);
+		return;
+	}
+
+	llist_add(&node->free, &pc->free);
+	atomic_inc(&pc->avail);
+}
+
+static void ubr_fdb_batch_rcu(struct rcu_head *rcu)
+{
+	struct ubr_fdb_batch *batch = container_of(rcu, struct ubr_fdb_batch, rcu);
+	struct ubr_fdb_node *node, *tmp;
+
+	local_bh_disable();
+	llist_for_each_entry_safe(node, tmp, batch->nodes.first, free)
+		ubr_fdb_pool_put(batch->pool, node);
+	local_bh_enable();
+
+	kfree(batch);
+}
+
+static void ubr_fdb_pool_refill(struct ubr_fdb_pool *pool)
+{
+	struct ubr_fdb_pool_pcpu *pc;
+	struct ubr_fdb_node *node;
+	struct llist_node *first, *last;
+	unsigned int size = READ_ONCE(pool->size);
+	int cpu, n, need;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(pool->pcpu, cpu);
+		need = (int)size - atomic_read(&pc->avail);
+		first = last = NULL;
+
+		for (n = 0; n < need; n++) {
+			node = kmem_cache_alloc(ubr_fdb_cache, GFP_KERNEL);
+			if (!node)
+				break;
+
+			node->free.next = first;
+			first = &node->free;
+			if (!last)
+				last = first;
+		}
+
+		if (first) {
+			llist_add_batch(first, last, &pc->free);
+			atomic_add(n, &pc->avail);
+		}
+
+		cond_resched();
+	}
+}
+
+/* Set the per-CPU capacity, growing the pool before returning */
+int ubr_fdb_pool_resize(struct ubr_fdb *fdb, unsigned int size)
+{
+	if (size > UBR_FDB_POOL_MAX)
+		return -ERANGE;
+
+	/* Shrinking is lazy, surplus nodes are consumed by learning */
+	WRITE_ONCE(fdb->pool.size, size);
+	ubr_fdb_pool_refill(&fdb->pool);
+	return 0;
+}
+UBR_EXPORT_FOR_TEST(ubr_fdb_pool_resize);
+
+static void ubr_fdb_pool_refill_work(struct work_struct *work)
+{
+	struct ubr_fdb_pool *pool =
+		container_of(work, struct ubr_fdb_pool, refill_work);
+
+	ubr_fdb_pool_refill(pool);
+}
+
+static int ubr_fdb_pool_init(struct ubr_fdb_pool *pool)
+{
+	pool->pcpu = alloc_percpu(struct ubr_fdb_pool_pcpu);
+	if (!pool->pcpu)
+		return -ENOMEM;
+
+	pool->size = UBR_FDB_POOL_DEFAULT;
+	INIT_WORK(&pool->refill_work, ubr_fdb_pool_refill_work);
+
+	/* Start out full, a short pool only costs learning misses */
+	ubr_fdb_pool_refill(pool);
+	return 0;
+}
+
+static void ubr_fdb_pool_destroy(struct ubr_fdb_pool *pool)
+{
+	struct ubr_fdb_node *node, *tmp;
+	int cpu;
+
+	cancel_work_sync(&pool->refill_work);
+
+	/* Let pending recycle batches land before draining */
+	rcu_barrier();
+
+	for_each_possible_cpu(cpu) {
+		struct ubr_fdb_pool_pcpu *pc = per_cpu_ptr(pool->pcpu, cpu);
+
+		llist_for_each_entry_safe(node, tmp, llist_del_all(&pc->free), free)
+			kmem_cache_free(ubr_fdb_cache, node);
+	}
+
+	free_percpu(pool->pcpu);
+}
+
+int ubr_learn_limit_init(struct ubr_learn_limit *ll)
+{
+	ll->max = 0;
+	ll->action = UBR_LEARN_LIMIT_FORWARD;
+	ll->disabled = 0;
+	RCU_INIT_POINTER(ll->rate, NULL);
+
+	return percpu_counter_init(&ll->count, 0, GFP_KERNEL);
+}
+
+void ubr_learn_limit_destroy(struct ubr_learn_limit *ll)
+{
+	ubr_police_free(rcu_dereference_protected(ll->rate, 1));
+	percpu_counter_destroy(&ll->count);
+}
+
+/* A max of zero means no limit, likewise for the rate (in pps) */
+static int ubr_learn_limit_build(u32 max, u32 rate, u32 action,
+				 struct ubr_learn_limit_cfg *cfg)
+{
+	if (action > UBR_LEARN_LIMIT_MAX)
+		return -EINVAL;
+
+	if (rate) {
+		cfg->rate = ubr_police_new(rate, true);
+		if (!cfg->rate)
+			return -ENOMEM;
+	}
+
+	cfg->set = true;
+	cfg->max = max;
+	cfg->action = action;
+	return 0;
+}
+
+void ubr_learn_limit_publish(struct ubr_learn_limit *ll,
+			     struct ubr_learn_limit_cfg *cfg)
+{
+	struct ubr_police *old;
+
+	if (!cfg->set)
+		return;
+
+	/* Serialised by the owning bridge's cfg_lock */
+	old = rcu_dereference_protected(ll->rate, 1);
+	rcu_assign_pointer(ll->rate, cfg->rate);
+	ubr_police_free(old);
+
+	WRITE_ONCE(ll->max, cfg->max);
+	WRITE_ONCE(ll->action, cfg->action);
+	WRITE_ONCE(ll->disabled, 0);
+}
+
+/*
+ * Build an update of the limit from netlink attributes, absent ones
+ * are kept as is.  Nothing changes until ubr_learn_limit_publish(),
+ * an unused cfg->rate is freed with ubr_police_free().
+ */
+int ubr_learn_limit_nl_build(struct ubr_learn_limit *ll, struct nlattr *max,
+			     struct nlattr *rate, struct nlattr *action,
+			     struct ubr_learn_limit_cfg *cfg)
+{
+	struct ubr_police *pol = rcu_dereference_protected(ll->rate, 1);
+
+	memset(cfg, 0, sizeof(*cfg));
+	if (!max && !rate && !action)
+		return 0;
+
+	return ubr_learn_limit_build(max ? nla_get_u32(max) : ll->max,
+				     rate ? nla_get_u32(rate) : (pol ? pol->rate : 0),
+				     action ? nla_get_u32(action) : ll->action,
+				     cfg);
+}
+
+static bool ubr_learn_limit_allow(struct ubr_learn_limit *ll)
+{
+	struct ubr_police *pol;
+	u32 max = READ_ONCE(ll->max);
+
+	if (READ_ONCE(ll->disabled))
+		return false;
+
+	if (max && percpu_counter_compare(&ll->count, max) >= 0)
+		return false;
+
+	pol = rcu_dereference(ll->rate);
+	if (pol && !ubr_police_allow(pol, 0))
+		return false;
+
+	return true;
+}
+
+/* Account for a dynamic entry that is no longer in the table. */
+static void ubr_fdb_node_unlearn(struct ubr_fdb *fdb, struct ubr_fdb_node *node)
+{
+	struct ubr *ubr = ubr_from_fdb(fdb);
+	struct ubr_vlan *vlan;
+	unsigned pidx;
+
+	if (node->proto != UBR_FDB_DYNAMIC)
+		return;
+
+	pidx = find_first_bit(node->vec.bitmap, UBR_MAX_PORTS);
+	if (pidx < UBR_MAX_PORTS)
+		percpu_counter_dec(&ubr->ports[pidx].learn.count);
+
+	rcu_read_lock();
+	vlan = ubr_vlan_find(ubr, node->vid);
+	if (vlan)
+		percpu_counter_dec(&vlan->learn.count);
+	rcu_read_unlock();
 }
 
 int ubr_fdb_flush(struct ubr_fdb *fdb, struct ubr_fdb_flush_op op)
 {
 	struct rhashtable_iter iter;
+	struct ubr_fdb_batch *batch;
 	struct ubr_fdb_node *node;
+	bool removed = false;
+
+	/* If we cannot batch, fall back to freeing nodes one by one */
+	batch = kmalloc(sizeof(*batch), GFP_KERNEL);
+	if (batch) {
+		batch->pool = &fdb->pool;
+		init_llist_head(&batch->nodes);
+	}
 
 	rhashtable_walk_enter(&fdb->nodes, &iter);
 	rhashtable_walk_start(&iter);
@@ -49,7 +325,7 @@ int ubr_fdb_flush(struct ubr_fdb *fdb, struct ubr_fdb_flush_op op)
 		if (op.per_port && !ubr_vec_test(&node->vec, op.pidx))
 			continue;
 
-		if (op.per_vlan && node->addr.vid != op.vid)
+		if (op.per_vlan && node->vid != op.vid)
 			continue;
 
 		if (op.per_proto) {
@@ -61,16 +337,36 @@ int ubr_fdb_flush(struct ubr_fdb *fdb, struct ubr_fdb_flush_op op)
 				continue;
 		}
 
-		rhashtable_remove_fast(&fdb->nodes, &node->rhnode,
-				       ubr_rht_params);
-		call_rcu(&node->rcu, ubr_fdb_node_delete_rcu);
+		if (rhashtable_remove_fast(&fdb->nodes, &node->rhnode,
+					   ubr_rht_params))
+			continue;
+
+		ubr_fdb_node_unlearn(fdb, node);
+		ubr_switchdev_fdb_notify(ubr_from_fdb(fdb), node, false);
+		removed = true;
+		if (batch)
+			llist_add(&node->free, &batch->nodes);
+		else
+			call_rcu(&node->rcu, ubr_fdb_node_delete_rcu);
 	}
 
 	rhashtable_walk_stop(&iter);
 	rhashtable_walk_exit(&iter);
 
+	/* Before the nodes can be freed, see ubr-flow.c */
+	if (removed)
+		ubr_flow_flush(ubr_from_fdb(fdb));
+
+	if (batch) {
+		if (llist_empty(&batch->nodes))
+			kfree(batch);
+		else
+			call_rcu(&batch->rcu, ubr_fdb_batch_rcu);
+	}
+
 	return IS_ERR(node) ? PTR_ERR(node) : 0;
 }
+UBR_EXPORT_FOR_TEST(ubr_fdb_flush);
 
 static void ubr_fdb_age(struct work_struct *work)
 {
@@ -86,65 +382,120 @@ static void ubr_fdb_age(struct work_struct *work)
 			   fdb->ageing_timeout / 2);
 }
 
-static void ubr_fdb_learn(struct ubr_fdb *fdb, struct sk_buff *skb)
+/*
+ * Called when a limit prevents a new address from being learned.
+ * Returns false if the frame should be dropped.
+ */
+static bool ubr_learn_overflow(struct ubr_port *p, struct ubr_learn_limit *ll)
+{
+	ubr_port_stats_inc(p, learn_overflows);
+
+	switch (READ_ONCE(ll->action)) {
+	case UBR_LEARN_LIMIT_DROP:
+		return false;
+	case UBR_LEARN_LIMIT_DISABLE:
+		/* No more learning until the limit is reconfigured */
+		WRITE_ONCE(ll->disabled, 1);
+		break;
+	}
+
+	return true;
+}
+
+/* Returns false if the frame should be dropped. */
+static bool ubr_fdb_learn(struct ubr_fdb *fdb, struct sk_buff *skb)
 {
+	struct ubr *ubr = ubr_from_fdb(fdb);
 	struct ubr_fdb_node *node;
 	struct ubr_fdb_addr key = {};
 	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_port *p = &ubr->ports[cb->lpidx];
+	unsigned old;
 
 	if (unlikely(!is_valid_ether_addr(eth_hdr(skb)->h_source)))
-		return;
+		return true;
 
 	key.type = UBR_ADDR_MAC;
-	key.vid = cb->vlan->vid;
+	key.fid = READ_ONCE(cb->vlan->fid);
 	ether_addr_copy(key.mac, eth_hdr(skb)->h_source);
 
 	node = rhashtable_lookup(&fdb->nodes, &key, ubr_rht_params);
 	if (likely(node)) {
 		if (node->proto != UBR_FDB_DYNAMIC)
-			return;
+			return true;
 
-		if (unlikely(!ubr_vec_test(&node->vec, cb->pidx))) {
+		if (unlikely(!ubr_vec_test(&node->vec, cb->lpidx))) {
 			/* TODO counter: station moved */
+			old = find_first_bit(node->vec.bitmap, UBR_MAX_PORTS);
+			if (old < UBR_MAX_PORTS)
+				percpu_counter_dec(&ubr->ports[old].learn.count);
+			percpu_counter_inc(&p->learn.count);
+
 			ubr_vec_zero(&node->vec);
-			ubr_vec_set(&node->vec, cb->pidx);
+			ubr_vec_set(&node->vec, cb->lpidx);
+			ubr_tunnel_learn(node, skb);
+			ubr_switchdev_fdb_notify(ubr, node, true);
+			ubr_flow_flush(ubr);
+		} else if (unlikely(cb->tunnel)) {
+			/* Same overlay, the endpoint may have changed */
+			ubr_tunnel_learn(node, skb);
 		}
 
 		node->tstamp = jiffies;
-		return;
+		return true;
 	}
 
-	node = kmem_cache_zalloc(ubr_fdb_cache, GFP_ATOMIC);
+	if (unlikely(!ubr_learn_limit_allow(&p->learn)))
+		return ubr_learn_overflow(p, &p->learn);
+
+	if (unlikely(!ubr_learn_limit_allow(&cb->vlan->learn)))
+		return ubr_learn_overflow(p, &cb->vlan->learn);
+
+	node = ubr_fdb_pool_get(&fdb->pool);
 	if (unlikely(!node)) {
-		/* TODO counter: learn no memory */
-		return;
+		ubr_port_stats_inc(p, learn_pool_empty);
+		return true;
 	}
 
 	node->proto = UBR_FDB_DYNAMIC;
+	node->vid = cb->vlan->vid;
 	node->addr = key;
 	node->tstamp = jiffies;
-	ubr_vec_set(&node->vec, cb->pidx);
+	ubr_vec_set(&node->vec, cb->lpidx);
+	if (unlikely(cb->tunnel))
+		ubr_tunnel_learn(node, skb);
 
 	if (rhashtable_lookup_insert_fast(&fdb->nodes, &node->rhnode,
 					  ubr_rht_params)) {
-		kmem_cache_free(ubr_fdb_cache, node);
+		ubr_fdb_pool_put(&fdb->pool, node);
 		/* TODO counter: learn insert fail */
-		return;
+		return true;
 	}
+
+	percpu_counter_inc(&p->learn.count);
+	percpu_counter_inc(&cb->vlan->learn.count);
+	ubr_switchdev_fdb_notify(ubr, node, true);
+	ubr_flow_flush(ubr);
+	return true;
 }
 
-bool ubr_fdb_forward(struct ubr_fdb *fdb, struct sk_buff *skb)
+/* Number of IP multicast group entries, in any bridge.  Until there
+ * are any, multicast is looked up by MAC like everything else.
+ */
+DEFINE_STATIC_KEY_FALSE(ubr_fdb_mc_groups);
+
+/* Destination lookup only, for pipelines that do not learn */
+bool __ubr_fdb_forward(struct ubr_fdb *fdb, struct sk_buff *skb)
 {
 	struct ubr_fdb_node *node;
 	struct ubr_fdb_addr key = {};
 	struct ubr_vec *filter;
 	struct ubr_cb *cb = ubr_cb(skb);
+	enum ubr_storm_class class;
 
-	if (cb->sa_learning && cb->vlan->sa_learning)
-		ubr_fdb_learn(fdb, skb);
-
-	key.vid = cb->vlan->vid;
-	if (unlikely(is_multicast_ether_addr(eth_hdr(skb)->h_dest))) {
+	key.fid = READ_ONCE(cb->vlan->fid);
+	if (static_branch_unlikely(&ubr_fdb_mc_groups) &&
+	    is_multicast_ether_addr(eth_hdr(skb)->h_dest)) {
 		switch (skb->protocol) {
 		case htons(ETH_P_IP):
 			key.type = UBR_ADDR_IP4;
@@ -168,34 +519,272 @@ lookup:
 			goto flood;
 
 		filter = &node->vec;
+		if (unlikely(ubr_fdb_node_is_remote(node)) && !cb->tunnel)
+			ubr_tunnel_fdb_forward(skb, node);
 	} else {
 	flood:
 		if (is_multicast_ether_addr(eth_hdr(skb)->h_dest)) {
-			if (is_broadcast_ether_addr(eth_hdr(skb)->h_dest))
+			if (is_broadcast_ether_addr(eth_hdr(skb)->h_dest)) {
 				filter = &cb->vlan->bcflood;
-			else
+				class = UBR_STORM_BC;
+			} else {
 				/* TODO cb->vlan->ip4mcflood and
 				 * cb->vlan->ip6mcflood */
 				filter = &cb->vlan->mcflood;
+				class = UBR_STORM_MC;
+			}
 		} else {
 			filter = &cb->vlan->ucflood;
+			class = UBR_STORM_UC;
 		}
+
+		if (!ubr_storm_allow(&ubr_from_fdb(fdb)->ports[cb->pidx],
+				     skb, class))
+			return false;
 	}
 
 	ubr_vec_and(&cb->vec, filter);
 	return true;
 }
 
+bool ubr_fdb_forward(struct ubr_fdb *fdb, struct sk_buff *skb)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+
+	if (cb->sa_learning && cb->vlan->sa_learning &&
+	    !ubr_fdb_learn(fdb, skb))
+		return false;
+
+	return __ubr_fdb_forward(fdb, skb);
+}
+UBR_EXPORT_FOR_TEST(ubr_fdb_forward);
+
+/*
+ * Entries a frame's forwarding decision was made from, for the flow
+ * cache.  Returns false unless the destination is a known local
+ * address and the source is already learned where it came from.
+ */
+bool ubr_fdb_flow_nodes(struct ubr_fdb *fdb, struct sk_buff *skb,
+			struct ubr_fdb_node **sa, struct ubr_fdb_node **da)
+{
+	struct ubr_fdb_addr key = {};
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_fdb_node *node;
+
+	key.type = UBR_ADDR_MAC;
+	key.fid = READ_ONCE(cb->vlan->fid);
+
+	ether_addr_copy(key.mac, eth_hdr(skb)->h_dest);
+	node = rhashtable_lookup(&fdb->nodes, &key, ubr_rht_params);
+	if (!node || ubr_fdb_node_is_old(fdb, node) ||
+	    ubr_fdb_node_is_remote(node))
+		return false;
+
+	*da = node;
+	*sa = NULL;
+	if (!cb->sa_learning || !cb->vlan->sa_learning)
+		return true;
+
+	ether_addr_copy(key.mac, eth_hdr(skb)->h_source);
+	node = rhashtable_lookup(&fdb->nodes, &key, ubr_rht_params);
+	if (!node)
+		return false;
+
+	if (node->proto == UBR_FDB_DYNAMIC) {
+		if (!ubr_vec_test(&node->vec, cb->lpidx))
+			return false;
+
+		*sa = node;
+	}
+
+	return true;
+}
+
+/* Ports a known unicast address is behind, NULL if unknown or aged */
+const struct ubr_vec *ubr_fdb_lookup_mac(struct ubr_fdb *fdb, u16 fid,
+					 const u8 *mac)
+{
+	struct ubr_fdb_node *node;
+	struct ubr_fdb_addr key = {};
+
+	key.type = UBR_ADDR_MAC;
+	key.fid = fid;
+	ether_addr_copy(key.mac, mac);
+
+	node = rhashtable_lookup(&fdb->nodes, &key, ubr_rht_params);
+	if (!node || ubr_fdb_node_is_old(fdb, node))
+		return NULL;
+
+	return &node->vec;
+}
+
+static struct ubr_fdb_node *ubr_fdb_find_mac(struct ubr_fdb *fdb,
+					     struct ubr_vlan *vlan,
+					     const u8 *mac)
+{
+	struct ubr_fdb_addr key = {};
+
+	key.type = UBR_ADDR_MAC;
+	key.fid = vlan->fid;
+	ether_addr_copy(key.mac, mac);
+
+	return rhashtable_lookup_fast(&fdb->nodes, &key, ubr_rht_params);
+}
+
+static void ubr_fdb_node_del(struct ubr_fdb *fdb, struct ubr_fdb_node *node)
+{
+	if (rhashtable_remove_fast(&fdb->nodes, &node->rhnode, ubr_rht_params))
+		return;
+
+	ubr_fdb_node_unlearn(fdb, node);
+	ubr_flow_flush(ubr_from_fdb(fdb));
+	call_rcu(&node->rcu, ubr_fdb_node_delete_rcu);
+}
+
+/*
+ * Addresses learned by the hardware below an offloaded port, see
+ * ubr-switchdev.c.  They take over from a dynamic entry for the same
+ * address, but never from a user one.  Called with cfg_lock held.
+ */
+int ubr_fdb_external_add(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+			 const u8 *mac, unsigned pidx)
+{
+	struct ubr_fdb_node *node;
+	int err;
+
+	node = ubr_fdb_find_mac(fdb, vlan, mac);
+	if (node) {
+		switch (node->proto) {
+		case UBR_FDB_USER:
+			return -EEXIST;
+		case UBR_FDB_EXTERNAL:
+			ubr_vec_zero(&node->vec);
+			ubr_vec_set(&node->vec, pidx);
+			node->offloaded = 1;
+			ubr_flow_flush(ubr_from_fdb(fdb));
+			return 0;
+		}
+
+		ubr_fdb_node_del(fdb, node);
+	}
+
+	node = kmem_cache_zalloc(ubr_fdb_cache, GFP_KERNEL);
+	if (!node)
+		return -ENOMEM;
+
+	node->proto = UBR_FDB_EXTERNAL;
+	node->offloaded = 1;
+	node->vid = vlan->vid;
+	node->addr.type = UBR_ADDR_MAC;
+	node->addr.fid = vlan->fid;
+	ether_addr_copy(node->addr.mac, mac);
+	node->tstamp = jiffies;
+	ubr_vec_set(&node->vec, pidx);
+
+	err = rhashtable_lookup_insert_fast(&fdb->nodes, &node->rhnode,
+					    ubr_rht_params);
+	if (err)
+		kmem_cache_free(ubr_fdb_cache, node);
+	else
+		ubr_flow_flush(ubr_from_fdb(fdb));
+
+	return err;
+}
+UBR_EXPORT_FOR_TEST(ubr_fdb_external_add);
+
+void ubr_fdb_external_del(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+			  const u8 *mac)
+{
+	struct ubr_fdb_node *node;
+
+	node = ubr_fdb_find_mac(fdb, vlan, mac);
+	if (node && node->proto == UBR_FDB_EXTERNAL)
+		ubr_fdb_node_del(fdb, node);
+}
+UBR_EXPORT_FOR_TEST(ubr_fdb_external_del);
+
+#if IS_ENABLED(CONFIG_VXLAN)
+/*
+ * Address behind a tunnel endpoint, added by the controller, e.g. from
+ * EVPN.  Replaces any existing entry, takes over the reference to md.
+ */
+int ubr_fdb_remote_add(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+		       const u8 *mac, unsigned pidx, struct metadata_dst *md)
+{
+	struct ubr_fdb_node *node;
+	int err;
+
+	node = ubr_fdb_find_mac(fdb, vlan, mac);
+	if (node)
+		ubr_fdb_node_del(fdb, node);
+
+	node = kmem_cache_zalloc(ubr_fdb_cache, GFP_KERNEL);
+	if (!node) {
+		dst_release(&md->dst);
+		return -ENOMEM;
+	}
+
+	node->proto = UBR_FDB_USER;
+	node->vid = vlan->vid;
+	node->addr.type = UBR_ADDR_MAC;
+	node->addr.fid = vlan->fid;
+	ether_addr_copy(node->addr.mac, mac);
+	node->tstamp = jiffies;
+	ubr_vec_set(&node->vec, pidx);
+	RCU_INIT_POINTER(node->remote, md);
+
+	err = rhashtable_lookup_insert_fast(&fdb->nodes, &node->rhnode,
+					    ubr_rht_params);
+	if (err) {
+		ubr_fdb_node_remote_put(node);
+		kmem_cache_free(ubr_fdb_cache, node);
+	}
+
+	return err;
+}
+
+int ubr_fdb_remote_del(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+		       const u8 *mac)
+{
+	struct ubr_fdb_node *node;
+
+	node = ubr_fdb_find_mac(fdb, vlan, mac);
+	if (!node || node->proto != UBR_FDB_USER ||
+	    !ubr_fdb_node_is_remote(node))
+		return -ENOENT;
+
+	ubr_fdb_node_del(fdb, node);
+	return 0;
+}
+#endif
+
+/* The hardware acknowledged an entry we sent it */
+void ubr_fdb_offloaded_set(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+			   const u8 *mac)
+{
+	struct ubr_fdb_node *node;
+
+	node = ubr_fdb_find_mac(fdb, vlan, mac);
+	if (node)
+		node->offloaded = 1;
+}
+
 int ubr_fdb_newlink(struct ubr_fdb *fdb)
 {
 	int err;
 
 	fdb->ageing_timeout = msecs_to_jiffies(300 * MSEC_PER_SEC);
 
-	err = rhashtable_init(&fdb->nodes, &ubr_rht_params);
+	err = ubr_fdb_pool_init(&fdb->pool);
 	if (err)
 		return err;
 
+	err = rhashtable_init(&fdb->nodes, &ubr_rht_params);
+	if (err) {
+		ubr_fdb_pool_destroy(&fdb->pool);
+		return err;
+	}
+
 	INIT_DELAYED_WORK(&fdb->age_work, ubr_fdb_age);
 
 	queue_delayed_work(system_long_wq, &fdb->age_work,
@@ -203,6 +792,7 @@ int ubr_fdb_newlink(struct ubr_fdb *fdb)
 
 	return 0;
 }
+UBR_EXPORT_FOR_TEST(ubr_fdb_newlink);
 
 void ubr_fdb_dellink(struct ubr_fdb *fdb)
 {
@@ -212,7 +802,9 @@ void ubr_fdb_dellink(struct ubr_fdb *fdb)
 
 	ubr_fdb_flush(fdb, op);
 	rhashtable_destroy(&fdb->nodes);
+	ubr_fdb_pool_destroy(&fdb->pool);
 }
+UBR_EXPORT_FOR_TEST(ubr_fdb_dellink);
 
 int __init ubr_fdb_cache_init(void)
 {
@@ -238,3 +830,44 @@ int ubr_fdb_nl_flush_cmd(struct sk_buff *skb, struct genl_info *info)
 
 	return 0;
 }
+
+static const struct nla_policy ubr_nl_fdb_policy[UBR_NLA_FDB_MAX + 1] = {
+	[UBR_NLA_FDB_UNSPEC]    = { .type = NLA_UNSPEC },
+	[UBR_NLA_FDB_POOL_SIZE] = { .type = NLA_U32 },
+};
+
+int ubr_fdb_nl_set_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *attrs[UBR_NLA_FDB_MAX + 1];
+	struct net_device *dev;
+	struct ubr *ubr;
+	u32 size;
+	int err;
+
+	if (!info->attrs || !info->attrs[UBR_NLA_FDB])
+		return -EINVAL;
+
+	err = nla_parse_nested(attrs, UBR_NLA_FDB_MAX, info->attrs[UBR_NLA_FDB],
+			       ubr_nl_fdb_policy, info->extack);
+	if (err)
+		return err;
+
+	dev = ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+
+	if (attrs[UBR_NLA_FDB_POOL_SIZE]) {
+		size = nla_get_u32(attrs[UBR_NLA_FDB_POOL_SIZE]);
+		err = ubr_fdb_pool_resize(&ubr->fdb, size);
+		if (err)
+			goto out;
+	}
+
+	printk(KERN_NOTICE "Set FDB on %s, pool size %u per CPU\n",
+	       dev->name, READ_ONCE(ubr->fdb.pool.size));
+out:
+	dev_put(dev);
+	return err;
+}
@@ -0,0 +1,248 @@
+#include <linux/etherdevice.h>
+#include <linux/hash.h>
+#include <linux/if_vlan.h>
+#include <linux/log2.h>
+
+#include "ubr-private.h"
+
+/*
+ * Microflow cache.  Each CPU has a direct mapped table of forwarding
+ * decisions for known unicast, keyed by ingress port, VID and
+ * addresses.  A hit restores the VLAN and egress ports of the frame
+ * and goes straight to ubr_deliver(), skipping the ingress stages.
+ *
+ * Entries are never invalidated one by one.  Instead any change that
+ * could alter a decision bumps ubr->flow_gen, see ubr_flow_flush(),
+ * and entries from an older generation are misses.  Entries hold
+ * pointers to the VLAN and FDB entries they were made from, which are
+ * only freed after an RCU grace period, and only after a flush.
+ */
+
+struct ubr_flow {
+	struct ubr_flow_key key;
+	u64 gen;
+
+	/* VID in the bridge, after translation */
+	u16 bvid;
+
+	struct ubr_vlan *vlan;
+
+	/* Source to refresh, NULL if not learning or static */
+	struct ubr_fdb_node *sa;
+	struct ubr_fdb_node *da;
+
+	struct ubr_vec vec;
+};
+
+struct ubr_flow_cache {
+	struct rcu_head rcu;
+	unsigned int bits;
+	struct ubr_flow * __percpu *tables;
+};
+
+/* Number of bridges with a cache */
+DEFINE_STATIC_KEY_FALSE(ubr_flow_used);
+
+static void ubr_flow_cache_free(struct ubr_flow_cache *cache)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		kvfree(*per_cpu_ptr(cache->tables, cpu));
+
+	free_percpu(cache->tables);
+	kfree(cache);
+}
+
+static void ubr_flow_cache_free_rcu(struct rcu_head *head)
+{
+	ubr_flow_cache_free(container_of(head, struct ubr_flow_cache, rcu));
+}
+
+static struct ubr_flow_cache *ubr_flow_cache_new(unsigned int size)
+{
+	struct ubr_flow_cache *cache;
+	struct ubr_flow *table;
+	int cpu;
+
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return NULL;
+
+	cache->bits = ilog2(size);
+	cache->tables = alloc_percpu(struct ubr_flow *);
+	if (!cache->tables)
+		goto err;
+
+	for_each_possible_cpu(cpu) {
+		table = kvcalloc(size, sizeof(*table), GFP_KERNEL);
+		if (!table)
+			goto err;
+
+		*per_cpu_ptr(cache->tables, cpu) = table;
+	}
+
+	return cache;
+err:
+	if (cache->tables)
+		ubr_flow_cache_free(cache);
+	else
+		kfree(cache);
+
+	return NULL;
+}
+
+/*
+ * Set the number of entries per CPU, rounded up to a power of two, 0
+ * disables the cache.
+ */
+int ubr_flow_cache_set(struct ubr *ubr, u32 size)
+{
+	struct ubr_flow_cache *cache = NULL, *old;
+
+	if (size > UBR_FLOW_CACHE_MAX)
+		return -EINVAL;
+
+	old = rcu_dereference_protected(ubr->flows,
+					lockdep_is_held(&ubr->cfg_lock));
+	if (old && size && roundup_pow_of_two(size) == 1U << old->bits)
+		return 0;
+
+	if (size) {
+		cache = ubr_flow_cache_new(roundup_pow_of_two(size));
+		if (!cache)
+			return -ENOMEM;
+	}
+
+	rcu_assign_pointer(ubr->flows, cache);
+	if (old)
+		call_rcu(&old->rcu, ubr_flow_cache_free_rcu);
+
+	if (cache && !old)
+		static_branch_inc(&ubr_flow_used);
+	else if (old && !cache)
+		static_branch_dec(&ubr_flow_used);
+
+	return 0;
+}
+UBR_EXPORT_FOR_TEST(ubr_flow_cache_set);
+
+static u32 ubr_flow_hash(const struct ubr_flow_key *key, unsigned int bits)
+{
+	u64 x = key->w[0] ^ key->w[1];
+
+	return hash_32((u32)x ^ (u32)(x >> 32), bits);
+}
+
+/*
+ * Only known unicast from a local port, with the tag, if any, of the
+ * bridge's protocol in the metadata, is cached.  Frames from the host,
+ * from an overlay, or with a passed through tag, run the full
+ * pipeline.
+ */
+static bool ubr_flow_key_get(struct ubr *ubr, struct sk_buff *skb,
+			     struct ubr_flow_key *key)
+{
+	const struct ethhdr *eth = eth_hdr(skb);
+	struct ubr_cb *cb = ubr_cb(skb);
+	__be16 proto = htons(ubr->vlan_proto);
+
+	if (unlikely(cb->tunnel || !cb->pidx))
+		return false;
+
+	if (is_multicast_ether_addr(eth->h_dest) ||
+	    !is_valid_ether_addr(eth->h_source))
+		return false;
+
+	if (skb_vlan_tag_present(skb)) {
+		if (unlikely(skb->vlan_proto != proto))
+			return false;
+
+		key->vid = skb_vlan_tag_get_id(skb);
+	} else {
+		if (unlikely(skb->protocol == proto))
+			return false;
+
+		key->vid = 0;
+	}
+
+	memcpy(key->addr, eth, 2 * ETH_ALEN);
+	key->pidx = cb->pidx;
+	return true;
+}
+
+bool __ubr_flow_hit(struct ubr *ubr, struct sk_buff *skb,
+		    struct ubr_flow_ctx *ctx)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_flow *flow;
+	struct ubr_fdb_node *sa;
+
+	if (!ubr_flow_key_get(ubr, skb, &ctx->key)) {
+		ctx->cache = NULL;
+		return false;
+	}
+
+	ctx->gen = atomic64_read(&ubr->flow_gen);
+	flow = *this_cpu_ptr(ctx->cache->tables);
+	flow += ubr_flow_hash(&ctx->key, ctx->cache->bits);
+
+	if (flow->gen != ctx->gen ||
+	    flow->key.w[0] != ctx->key.w[0] || flow->key.w[1] != ctx->key.w[1])
+		return false;
+
+	/* Aged out but not yet flushed, the pipeline floods it */
+	if (unlikely(ubr_fdb_node_is_old(&ubr->fdb, flow->da)))
+		return false;
+
+	sa = flow->sa;
+	if (sa && READ_ONCE(sa->tstamp) != jiffies)
+		WRITE_ONCE(sa->tstamp, jiffies);
+
+	/* As ubr_vlan_ingress() leaves the tag */
+	if (cb->vlan_filtering) {
+		if (ctx->key.vid)
+			skb->vlan_tci = (skb->vlan_tci & ~VLAN_VID_MASK) |
+				flow->bvid;
+		else
+			__vlan_hwaccel_put_tag(skb, htons(ubr->vlan_proto),
+					       flow->bvid);
+	}
+
+	cb->vlan = flow->vlan;
+	cb->vec = flow->vec;
+	return true;
+}
+
+/*
+ * Record the decision the pipeline made for a frame that missed, if
+ * nothing changed while it ran.
+ */
+void __ubr_flow_insert(struct ubr *ubr, struct sk_buff *skb,
+		       struct ubr_flow_ctx *ctx)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_fdb_node *sa, *da;
+	struct ubr_flow *flow;
+
+	if (atomic64_read(&ubr->flow_gen) != ctx->gen)
+		return;
+
+	/* Snooping must see every frame */
+	if (cb->vlan_inline || cb->vlan->neigh_suppress)
+		return;
+
+	if (!ubr_fdb_flow_nodes(&ubr->fdb, skb, &sa, &da))
+		return;
+
+	flow = *this_cpu_ptr(ctx->cache->tables);
+	flow += ubr_flow_hash(&ctx->key, ctx->cache->bits);
+
+	flow->key = ctx->key;
+	flow->gen = ctx->gen;
+	flow->bvid = cb->vlan->vid;
+	flow->vlan = cb->vlan;
+	flow->sa = sa;
+	flow->da = da;
+	flow->vec = cb->vec;
+}
@@ -4,24 +4,118 @@
 
 #include "ubr-private.h"
 
-static void ubr_common_egress(struct ubr *ubr, struct sk_buff *skb, int pidx)
+/* skb_vlan_pop() wants data at the MAC header, which is only the
+ * case on the way down.
+ */
+static int ubr_vlan_pop_inline(struct sk_buff *skb)
+{
+	int offset = skb->data - skb_mac_header(skb);
+	int err;
+
+	__skb_push(skb, offset);
+	err = skb_vlan_pop(skb);
+	__skb_pull(skb, offset);
+
+	return err;
+}
+
+/* Move the tag from the metadata into the payload.  Like ingress
+ * frames with an inline tag, data is left right after the addresses
+ * and EtherType, i.e. at the tag.
+ */
+static struct sk_buff *ubr_vlan_push_inline(struct sk_buff *skb)
+{
+	__skb_push(skb, skb->data - skb_mac_header(skb));
+
+	skb = __vlan_hwaccel_push_inside(skb);
+	if (unlikely(!skb))
+		return NULL;
+
+	skb_reset_mac_len(skb);
+	__skb_pull(skb, ETH_HLEN);
+	return skb;
+}
+
+/*
+ * Header variants of a flooded frame.  Egress ports are grouped by
+ * the variant they need, which is then prepared once and shared by
+ * the clones for all ports in the group.
+ */
+enum ubr_variant {
+	UBR_VARIANT_ASIS,	/* Tag, if any, stays where it is */
+	UBR_VARIANT_UNTAGGED,
+	UBR_VARIANT_TAGGED,	/* Tag moved from metadata to payload */
+
+	UBR_VARIANT_MAX
+};
+
+/* The tag is in the hwaccel metadata since ingress.  Leave it there
+ * for ports that insert it in hardware, so GSO frames go out without
+ * any header rewrite.  Tags still in the payload are only touched
+ * when the egress port is untagged.
+ */
+static void ubr_variant_split(struct ubr *ubr, struct sk_buff *skb,
+			      struct ubr_vec *vecs)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+	const struct ubr_vec *tagged;
+
+	memset(vecs, 0, UBR_VARIANT_MAX * sizeof(*vecs));
+	vecs[UBR_VARIANT_ASIS] = cb->vec;
+	if (!cb->vlan_filtering)
+		return;
+
+	tagged = &rcu_dereference(cb->vlan->ports)->tagged;
+
+	vecs[UBR_VARIANT_UNTAGGED] = cb->vec;
+	ubr_vec_andnot(&vecs[UBR_VARIANT_UNTAGGED], tagged);
+	ubr_vec_and(&vecs[UBR_VARIANT_ASIS], tagged);
+
+	if (!cb->vlan_inline) {
+		vecs[UBR_VARIANT_TAGGED] = vecs[UBR_VARIANT_ASIS];
+		ubr_vec_and(&vecs[UBR_VARIANT_TAGGED], &ubr->sw_tagging);
+		ubr_vec_andnot(&vecs[UBR_VARIANT_ASIS], &ubr->sw_tagging);
+	}
+}
+
+/* Returns NULL if the frame was consumed */
+static struct sk_buff *ubr_variant_prepare(struct sk_buff *skb,
+					   enum ubr_variant variant)
 {
 	struct ubr_cb *cb = ubr_cb(skb);
-	int depth;
 
-	if (cb->vlan_filtering) {
-		if (ubr_vec_test(&cb->vlan->tagged, pidx))
-			skb_vlan_push(skb, htons(ubr->vlan_proto), skb->vlan_tci);
-		else
+	switch (variant) {
+	case UBR_VARIANT_UNTAGGED:
+		if (likely(!cb->vlan_inline)) {
 			__vlan_hwaccel_clear_tag(skb);
+		} else if (ubr_vlan_pop_inline(skb)) {
+			kfree_skb(skb);
+			return NULL;
+		}
+		break;
+
+	case UBR_VARIANT_TAGGED:
+		return ubr_vlan_push_inline(skb);
+
+	default:
+		break;
 	}
 
+	return skb;
+}
+
+/* Returns false if the frame was consumed */
+static bool ubr_common_egress(struct sk_buff *skb)
+{
+	int depth;
+
 	if (!__vlan_get_protocol(skb, skb->protocol, &depth)) {
 		kfree_skb(skb);
-		return;
+		return false;
 	}
 
 	skb_set_network_header(skb, depth);
+	return true;
 }
 
 static void ubr_deliver_up(struct ubr *ubr, struct sk_buff *skb)
@@ -29,48 +123,129 @@ static void ubr_deliver_up(struct ubr *ubr, struct sk_buff *skb)
 	struct ethhdr *eth = eth_hdr(skb);
 
 	skb->dev = ubr->dev;
-	ubr_common_egress(ubr, skb, 0);
+	dev_sw_netstats_rx_add(ubr->dev, skb->len);
+	if (!ubr_common_egress(skb))
+		return;
 
 	if (ether_addr_equal(ubr->dev->dev_addr, eth->h_dest))
 		skb->pkt_type = PACKET_HOST;
 
-	netif_receive_skb(skb);
+	/* Not into the stack from within the port's rx_handler, but
+	 * from the bridge's per-CPU NAPI, which also aggregates TCP
+	 * streams ending on the host.
+	 */
+	gro_cells_receive(&ubr->gro_cells, skb);
 }
 
 static void ubr_deliver_down(struct ubr *ubr, struct sk_buff *skb, int pidx)
 {
+	struct ubr_port *p = &ubr->ports[pidx];
+
 	skb_push(skb, ETH_HLEN);
-	skb->dev = ubr->ports[pidx].dev;
-	ubr_common_egress(ubr, skb, pidx);
+	skb->dev = p->dev;
+
+	if (static_branch_unlikely(&ubr_vlan_xlate_used) &&
+	    rcu_access_pointer(p->xlate) &&
+	    !ubr_vlan_xlate_egress(ubr, skb, pidx))
+		return;
+
+	if (!ubr_common_egress(skb))
+		return;
+
+	if (unlikely(ubr_vec_test(&ubr->tunnels, pidx))) {
+		ubr_tunnel_xmit(ubr, skb);
+		return;
+	}
 
 	dev_queue_xmit(skb);
 }
 
-static void ubr_deliver(struct ubr *ubr, struct sk_buff *skb)
+static void ubr_deliver_one(struct ubr *ubr, struct sk_buff *skb, int pidx)
+{
+	if (pidx == 0)
+		ubr_deliver_up(ubr, skb);
+	else
+		ubr_deliver_down(ubr, skb, pidx);
+}
+
+/* Consumes skb, which must be headed for at least one port */
+static void ubr_replicate(struct ubr *ubr, struct sk_buff *skb,
+			  const struct ubr_vec *vec)
 {
-	struct ubr_cb *cb = ubr_cb(skb);
 	struct sk_buff *cskb;
 	int pidx, first;
 
-	first = find_first_bit(cb->vec.bitmap, UBR_MAX_PORTS);
-	if (first == UBR_MAX_PORTS)
-		goto drop;
+	first = find_first_bit(vec->bitmap, UBR_MAX_PORTS);
 
 	pidx = first + 1;
-	for_each_set_bit_from(pidx, cb->vec.bitmap, UBR_MAX_PORTS) {
+	for_each_set_bit_from(pidx, vec->bitmap, UBR_MAX_PORTS) {
 		cskb = skb_clone(skb, GFP_ATOMIC);
 		if (!cskb) {
-			/* TODO: bump counter */
-			goto drop;
+			ubr_port_stats_inc(&ubr->ports[ubr_cb(skb)->pidx],
+					   replication_drops);
+			kfree_skb(skb);
+			return;
 		}
 
-		ubr_deliver_down(ubr, cskb, pidx);
+		ubr_deliver_one(ubr, cskb, pidx);
 	}
 
-	if (first == 0)
-		ubr_deliver_up(ubr, skb);
-	else
-		ubr_deliver_down(ubr, skb, first);
+	ubr_deliver_one(ubr, skb, first);
+}
+
+static void ubr_deliver(struct ubr *ubr, struct sk_buff *skb)
+{
+	struct ubr_vec vecs[UBR_VARIANT_MAX];
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_lags *lags;
+	struct sk_buff *vskb;
+	int variant, last;
+
+	/* The overlay's metadata has served its purpose, see
+	 * ubr_fdb_learn()
+	 */
+	if (unlikely(cb->tunnel))
+		skb_dst_drop(skb);
+
+	lags = rcu_dereference(ubr->lags);
+	if (lags)
+		ubr_lag_egress(lags, skb);
+
+	/* After LAG selection, which already only picks active members */
+	ubr_vec_and(&cb->vec, &ubr->active);
+	ubr_switchdev_egress(ubr, skb);
+
+	ubr_variant_split(ubr, skb, vecs);
+
+	for (last = UBR_VARIANT_MAX - 1; last >= 0; last--)
+		if (!ubr_vec_empty(&vecs[last]))
+			break;
+
+	if (last < 0)
+		goto drop;
+
+	/* The original frame goes to the last variant, the others
+	 * start from a clone of it.
+	 */
+	for (variant = 0; variant <= last; variant++) {
+		if (ubr_vec_empty(&vecs[variant]))
+			continue;
+
+		if (variant == last) {
+			vskb = skb;
+		} else {
+			vskb = skb_clone(skb, GFP_ATOMIC);
+			if (!vskb) {
+				ubr_port_stats_inc(&ubr->ports[cb->pidx],
+						   replication_drops);
+				goto drop;
+			}
+		}
+
+		vskb = ubr_variant_prepare(vskb, variant);
+		if (vskb)
+			ubr_replicate(ubr, vskb, &vecs[variant]);
+	}
 
 	return;
 drop:
@@ -82,24 +257,61 @@ static bool ubr_ctrl_ingress(struct ubr *ubr, struct sk_buff *skb) { return true
 static bool ubr_stp_ingress(struct ubr *ubr, struct sk_buff *skb) { return true; };
 static bool ubr_fdb_ingress(struct ubr *ubr, struct sk_buff *skb) { return true; };
 
-bool ubr_forward(struct ubr *ubr, struct sk_buff *skb)
+/*
+ * The ingress pipeline, instantiated once per enum ubr_pipeline with
+ * constant arguments, so that each variant is built without the
+ * stages its ports do not use.
+ */
+static __always_inline struct sk_buff *
+__ubr_forward(struct ubr *ubr, struct sk_buff *skb, const bool vlan,
+	      const bool learn)
 {
 	struct ubr_cb *cb = ubr_cb(skb);
-	bool allow;
+	struct ubr_flow_ctx flow;
+	bool allow = true;
+
+	/* Known flows were decided before, see ubr-flow.c */
+	if (ubr_flow_hit(ubr, skb, &flow)) {
+		ubr_deliver(ubr, skb);
+		return NULL;
+	}
 
 	/* All subsequent stages rely on the frame's VID being known,
-	 * so this must run first.
+	 * so this must run first.  Frames from an overlay get theirs
+	 * from the VNI.
 	 */
-	allow = ubr_vlan_ingress(ubr, skb);
+	if (vlan) {
+		if (unlikely(cb->tunnel) && !ubr_tunnel_ingress(ubr, skb)) {
+			kfree_skb(skb);
+			return NULL;
+		}
+
+		skb = ubr_vlan_ingress(ubr, skb, &allow);
+		if (unlikely(!skb))
+			return NULL;
+
+		cb = ubr_cb(skb);
+	} else if (likely(cb->vlan)) {
+		ubr_vec_and(&cb->vec, &rcu_dereference(cb->vlan->ports)->members);
+	}
+
+	if (unlikely(!cb->vlan)) {
+		kfree_skb(skb);
+		return NULL;
+	}
 
 	/* Then run stages can potentially classify the frame as
 	 * control traffic to be trapped.
 	 */
-	allow &= !cb->ctrl && ubr_fdb_forward(&ubr->fdb, skb);
+	if (learn)
+		allow &= !cb->ctrl && ubr_fdb_forward(&ubr->fdb, skb);
+	else
+		allow &= !cb->ctrl && __ubr_fdb_forward(&ubr->fdb, skb);
+
 	allow &= !cb->ctrl && ubr_ctrl_ingress(ubr, skb);
 	if (cb->ctrl) {
 		skb->dev = ubr->dev;
-		return true;
+		return skb;
 	}
 
 	/* Now that forward/drop are the only remaining outcomes, we
@@ -107,10 +319,31 @@ bool ubr_forward(struct ubr *ubr, struct sk_buff *skb)
 	 */
 	if (allow &&
 	    ubr_stp_ingress(ubr, skb) &&
-	    ubr_fdb_ingress(ubr, skb))
+	    ubr_fdb_ingress(ubr, skb) &&
+	    ubr_neigh_ingress(ubr, skb)) {
+		ubr_flow_insert(ubr, skb, &flow);
 		ubr_deliver(ubr, skb);
-	else
+	} else
 		kfree_skb(skb);
 
-	return false;
+	return NULL;
+}
+
+/*
+ * Returns the frame if it is to be trapped to the host, which may not
+ * be the one passed in, otherwise NULL.  A direct branch per variant,
+ * rather than a call through a pointer.
+ */
+struct sk_buff *ubr_forward(struct ubr *ubr, struct sk_buff *skb)
+{
+	switch (ubr_cb(skb)->pipeline) {
+	case UBR_PIPELINE_HUB:
+		return __ubr_forward(ubr, skb, false, false);
+	case UBR_PIPELINE_LEARN:
+		return __ubr_forward(ubr, skb, false, true);
+	case UBR_PIPELINE_TRUNK:
+		return __ubr_forward(ubr, skb, true, false);
+	default:
+		return __ubr_forward(ubr, skb, true, true);
+	}
 }
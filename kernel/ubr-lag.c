@@ -0,0 +1,219 @@
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+
+#include "ubr-private.h"
+
+/*
+ * Link aggregation groups.  Member ports stay in all port vectors as
+ * usual, but their addresses are learned on the group's first member
+ * (cb->lpidx), and right before delivery each group present in the
+ * destination vector is reduced to the one member picked by the flow
+ * hash.  So a flood reaches a group once, a known destination on a
+ * group is sent on one link, and a flow always uses the same link.
+ */
+
+void ubr_lag_egress(const struct ubr_lags *lags, struct sk_buff *skb)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+	const struct ubr_lag *lag;
+
+	if (!ubr_vec_intersects(&cb->vec, &lags->ports))
+		return;
+
+	for (lag = lags->lag; lag < &lags->lag[lags->num]; lag++) {
+		if (!ubr_vec_intersects(&cb->vec, &lag->members))
+			continue;
+
+		ubr_vec_andnot(&cb->vec, &lag->members);
+
+		/* Never back out on the group the frame came in on */
+		if (!lag->num_tx || ubr_vec_test(&lag->members, cb->pidx))
+			continue;
+
+		ubr_vec_set(&cb->vec,
+			    lag->tx[reciprocal_scale(skb_get_hash(skb),
+						     lag->num_tx)]);
+	}
+}
+
+/*
+ * Build the groups from the ports' group IDs and ubr->active, NULL if
+ * there are none.
+ */
+static struct ubr_lags *ubr_lag_build(struct ubr *ubr)
+{
+	struct ubr_lags *lags;
+	struct ubr_lag *lag;
+	struct ubr_port *p;
+	unsigned pidx;
+	u32 id;
+
+	lockdep_assert_held(&ubr->cfg_lock);
+
+	lags = kzalloc(sizeof(*lags), GFP_KERNEL);
+	if (!lags)
+		return ERR_PTR(-ENOMEM);
+
+	for (id = 1; id <= UBR_MAX_LAGS; id++) {
+		lag = &lags->lag[lags->num];
+
+		ubr_vec_foreach(&ubr->busy, pidx) {
+			p = &ubr->ports[pidx];
+			if (p->lag != id)
+				continue;
+
+			ubr_vec_set(&lag->members, pidx);
+			if (ubr_vec_test(&ubr->active, pidx))
+				lag->tx[lag->num_tx++] = pidx;
+		}
+
+		if (ubr_vec_empty(&lag->members))
+			continue;
+
+		ubr_vec_or(&lags->ports, &lag->members);
+		lags->num++;
+	}
+
+	if (!lags->num) {
+		kfree(lags);
+		lags = NULL;
+	}
+
+	return lags;
+}
+
+/* Swap in the groups from ubr_lag_build() */
+static void ubr_lag_publish(struct ubr *ubr, struct ubr_lags *lags)
+{
+	struct ubr_lags *old;
+	unsigned pidx, first, i;
+
+	/* Members learn as the first port of their group */
+	ubr_vec_foreach(&ubr->busy, pidx) {
+		first = pidx;
+		for (i = 0; lags && i < lags->num; i++) {
+			if (ubr_vec_test(&lags->lag[i].members, pidx)) {
+				first = find_first_bit(lags->lag[i].members.bitmap,
+						       UBR_MAX_PORTS);
+				break;
+			}
+		}
+
+		ubr->ports[pidx].ingress_cb.lpidx = first;
+	}
+
+	old = rcu_dereference_protected(ubr->lags,
+					lockdep_is_held(&ubr->cfg_lock));
+	rcu_assign_pointer(ubr->lags, lags);
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
+/*
+ * Rebuild the groups and swap them in.  Should that fail, no groups at
+ * all are published, members then get flooded individually which is
+ * wasteful but safe.
+ */
+int ubr_lag_update(struct ubr *ubr)
+{
+	struct ubr_lags *lags;
+
+	lags = ubr_lag_build(ubr);
+	if (IS_ERR(lags)) {
+		ubr_lag_publish(ubr, NULL);
+		return PTR_ERR(lags);
+	}
+
+	ubr_lag_publish(ubr, lags);
+	return 0;
+}
+
+/*
+ * Add the ports that p, and the members of groups old and id, learn
+ * on.  Only these can change when p moves from group old to id.
+ */
+static void ubr_lag_lpidx_get(struct ubr *ubr, struct ubr_port *p,
+			      u32 old, u32 id, struct ubr_vec *lpidx)
+{
+	struct ubr_port *q;
+	unsigned pidx;
+
+	ubr_vec_set(lpidx, p->ingress_cb.lpidx);
+
+	ubr_vec_foreach(&ubr->busy, pidx) {
+		q = &ubr->ports[pidx];
+		if (q->lag && (q->lag == old || q->lag == id))
+			ubr_vec_set(lpidx, q->ingress_cb.lpidx);
+	}
+}
+
+/*
+ * Build the groups with p moved to group id, nothing is changed until
+ * ubr_lag_port_publish().  The caller makes sure id is not p's current
+ * group.
+ */
+struct ubr_lags *ubr_lag_port_build(struct ubr_port *p, u32 id)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	struct ubr_lags *lags;
+	unsigned pidx, n = 0;
+	u8 old = p->lag;
+
+	if (id > UBR_MAX_LAGS || p->dev == ubr->dev)
+		return ERR_PTR(-EINVAL);
+
+	ubr_vec_foreach(&ubr->busy, pidx)
+		n += id && ubr->ports[pidx].lag == id;
+	if (n >= UBR_LAG_MAX_PORTS)
+		return ERR_PTR(-EBUSY);
+
+	p->lag = id;
+	lags = ubr_lag_build(ubr);
+	p->lag = old;
+
+	return lags;
+}
+
+void ubr_lag_port_publish(struct ubr_port *p, u32 id, struct ubr_lags *lags)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	struct ubr_fdb_flush_op op = {
+		.per_port = true,
+		.per_proto = true,
+		.proto = UBR_FDB_DYNAMIC,
+	};
+	struct ubr_vec stale = {};
+	unsigned pidx;
+	u8 old = p->lag;
+
+	ubr_lag_lpidx_get(ubr, p, old, id, &stale);
+
+	p->lag = id;
+	ubr_lag_publish(ubr, lags);
+
+	/* Entries learned on the port, or its groups, are now stale.
+	 * A group's first member may have changed, so flush what they
+	 * learned on both before and after.
+	 */
+	ubr_lag_lpidx_get(ubr, p, old, id, &stale);
+
+	ubr_vec_foreach(&stale, pidx) {
+		op.pidx = pidx;
+		ubr_fdb_flush(&ubr->fdb, op);
+	}
+}
+
+int ubr_lag_port_set(struct ubr_port *p, u32 id)
+{
+	struct ubr_lags *lags;
+
+	if (id == p->lag)
+		return 0;
+
+	lags = ubr_lag_port_build(p, id);
+	if (IS_ERR(lags))
+		return PTR_ERR(lags);
+
+	ubr_lag_port_publish(p, id, lags);
+	return 0;
+}
@@ -0,0 +1,457 @@
+#include <linux/etherdevice.h>
+#include <linux/if_arp.h>
+#include <linux/ipv6.h>
+#include <linux/rhashtable.h>
+#include <linux/slab.h>
+
+#include <net/addrconf.h>
+#include <net/ipv6.h>
+#include <net/ndisc.h>
+
+#include "ubr-netlink.h"
+#include "ubr-private.h"
+
+/*
+ * ARP/ND suppression.  On VLANs with neigh_suppress on, ARP and
+ * neighbour advertisements are snooped into a per-bridge table of
+ * IP to MAC bindings, which the controller may also populate.  An
+ * ARP request or neighbour solicitation for a known target is then
+ * not flooded, but delivered only to the port(s) the target's MAC is
+ * learned on.  The target still answers itself, so no replies are
+ * crafted here and hosts see the exchange they expect; any lookup
+ * miss along the way leaves the frame to be flooded as before.
+ */
+
+/* Bound on snooped entries per bridge, controller entries are not
+ * counted.
+ */
+#define UBR_NEIGH_MAX	(1 << 14)
+
+static const struct rhashtable_params ubr_neigh_rht_params = {
+	.head_offset = offsetof(struct ubr_neigh_node, rhnode),
+	.key_offset = offsetof(struct ubr_neigh_node, key),
+	.key_len = sizeof(struct ubr_neigh_key),
+	.automatic_shrinking = true,
+};
+
+/* Snooped entries age with the FDB, so they never outlive the MAC */
+static inline bool ubr_neigh_node_is_old(struct ubr_neigh *neigh,
+					 struct ubr_neigh_node *node)
+{
+	return (node->proto == UBR_FDB_DYNAMIC) &&
+		time_is_before_jiffies(node->tstamp +
+				       ubr_from_neigh(neigh)->fdb.ageing_timeout);
+}
+
+static void ubr_neigh_learn(struct ubr_neigh *neigh,
+			    const struct ubr_neigh_key *key, const u8 *lladdr)
+{
+	struct ubr_neigh_node *node;
+
+	if (unlikely(!is_valid_ether_addr(lladdr)))
+		return;
+
+	node = rhashtable_lookup(&neigh->nodes, key, ubr_neigh_rht_params);
+	if (likely(node)) {
+		if (node->proto != UBR_FDB_DYNAMIC)
+			return;
+
+		/* Readers may see a torn address while a host moves,
+		 * which only costs them an FDB miss, i.e. a flood.
+		 */
+		if (unlikely(!ether_addr_equal(node->lladdr, lladdr)))
+			ether_addr_copy(node->lladdr, lladdr);
+
+		node->tstamp = jiffies;
+		return;
+	}
+
+	if (atomic_read(&neigh->count) >= UBR_NEIGH_MAX)
+		return;
+
+	node = kzalloc(sizeof(*node), GFP_ATOMIC);
+	if (unlikely(!node))
+		return;
+
+	node->key = *key;
+	ether_addr_copy(node->lladdr, lladdr);
+	node->proto = UBR_FDB_DYNAMIC;
+	node->tstamp = jiffies;
+
+	if (rhashtable_lookup_insert_fast(&neigh->nodes, &node->rhnode,
+					  ubr_neigh_rht_params)) {
+		kfree(node);
+		return;
+	}
+
+	atomic_inc(&neigh->count);
+}
+
+/* Narrow a flooded request down to the ports behind its target */
+static void ubr_neigh_direct(struct ubr *ubr, struct sk_buff *skb,
+			     const struct ubr_neigh_key *key)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_neigh_node *node;
+	const struct ubr_vec *vec;
+
+	node = rhashtable_lookup(&ubr->neigh.nodes, key, ubr_neigh_rht_params);
+	if (!node || ubr_neigh_node_is_old(&ubr->neigh, node))
+		return;
+
+	vec = ubr_fdb_lookup_mac(&ubr->fdb, READ_ONCE(cb->vlan->fid),
+				 node->lladdr);
+	if (!vec)
+		return;
+
+	/* A target behind the ingress port already saw the request */
+	ubr_vec_and(&cb->vec, vec);
+}
+
+static void ubr_neigh_arp(struct ubr *ubr, struct sk_buff *skb)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_neigh_key key = {
+		.vid = cb->vlan->vid,
+		.family = AF_INET,
+	};
+	const struct arphdr *arp;
+	const u8 *sha, *spa, *tpa;
+
+	if (!pskb_may_pull(skb, sizeof(*arp) + 2 * (ETH_ALEN + 4)))
+		return;
+
+	arp = (const struct arphdr *)skb->data;
+	if (arp->ar_hrd != htons(ARPHRD_ETHER) ||
+	    arp->ar_pro != htons(ETH_P_IP) ||
+	    arp->ar_hln != ETH_ALEN || arp->ar_pln != 4)
+		return;
+
+	sha = (const u8 *)(arp + 1);
+	spa = sha + ETH_ALEN;
+	tpa = spa + 4 + ETH_ALEN;
+
+	/* Probes (RFC 5227) have no sender address yet */
+	memcpy(&key.ip4, spa, 4);
+	if (key.ip4)
+		ubr_neigh_learn(&ubr->neigh, &key, sha);
+
+	if (arp->ar_op != htons(ARPOP_REQUEST) ||
+	    !is_broadcast_ether_addr(eth_hdr(skb)->h_dest))
+		return;
+
+	/* Gratuitous ARP is meant for everyone */
+	if (!memcmp(spa, tpa, 4))
+		return;
+
+	memcpy(&key.ip4, tpa, 4);
+	ubr_neigh_direct(ubr, skb, &key);
+}
+
+#if IS_ENABLED(CONFIG_IPV6)
+static void ubr_neigh_nd(struct ubr *ubr, struct sk_buff *skb)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_neigh_key key = {
+		.vid = cb->vlan->vid,
+		.family = AF_INET6,
+	};
+	const struct ipv6hdr *ip6;
+	const struct nd_msg *msg;
+
+	if (!pskb_may_pull(skb, sizeof(*ip6) + sizeof(*msg)))
+		return;
+
+	/* ND with extension headers is rare enough to just flood */
+	ip6 = (const struct ipv6hdr *)skb->data;
+	if (ip6->nexthdr != IPPROTO_ICMPV6)
+		return;
+
+	msg = (const struct nd_msg *)(ip6 + 1);
+	if (msg->icmph.icmp6_code)
+		return;
+
+	switch (msg->icmph.icmp6_type) {
+	case NDISC_NEIGHBOUR_ADVERTISEMENT:
+		key.ip6 = msg->target;
+		if (!ipv6_addr_is_multicast(&key.ip6))
+			ubr_neigh_learn(&ubr->neigh, &key,
+					eth_hdr(skb)->h_source);
+		break;
+
+	case NDISC_NEIGHBOUR_SOLICITATION:
+		/* Duplicate address detection is sent from :: */
+		if (!ipv6_addr_any(&ip6->saddr)) {
+			key.ip6 = ip6->saddr;
+			ubr_neigh_learn(&ubr->neigh, &key,
+					eth_hdr(skb)->h_source);
+		}
+
+		/* Unicast reachability probes are directed already */
+		if (!is_multicast_ether_addr(eth_hdr(skb)->h_dest))
+			break;
+
+		key.ip6 = msg->target;
+		ubr_neigh_direct(ubr, skb, &key);
+		break;
+	}
+}
+#endif
+
+/* Number of VLANs, in any bridge, with neigh_suppress on */
+DEFINE_STATIC_KEY_FALSE(ubr_neigh_suppress_used);
+UBR_EXPORT_FOR_TEST(ubr_neigh_suppress_used);
+
+/* Never drops, a frame is at most delivered to fewer ports */
+bool __ubr_neigh_ingress(struct ubr *ubr, struct sk_buff *skb)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+
+	if (likely(!cb->vlan->neigh_suppress))
+		return true;
+
+	switch (skb->protocol) {
+	case htons(ETH_P_ARP):
+		ubr_neigh_arp(ubr, skb);
+		break;
+#if IS_ENABLED(CONFIG_IPV6)
+	case htons(ETH_P_IPV6):
+		ubr_neigh_nd(ubr, skb);
+		break;
+#endif
+	}
+
+	return true;
+}
+UBR_EXPORT_FOR_TEST(__ubr_neigh_ingress);
+
+static void ubr_neigh_node_del(struct ubr_neigh *neigh,
+			       struct ubr_neigh_node *node)
+{
+	/* Whoever loses a race to remove the node leaves it be */
+	if (rhashtable_remove_fast(&neigh->nodes, &node->rhnode,
+				   ubr_neigh_rht_params))
+		return;
+
+	if (node->proto == UBR_FDB_DYNAMIC)
+		atomic_dec(&neigh->count);
+
+	kfree_rcu(node, rcu);
+}
+
+static void ubr_neigh_walk(struct ubr_neigh *neigh, struct ubr_vlan *vlan,
+			   bool old)
+{
+	struct ubr_neigh_node *node;
+	struct rhashtable_iter iter;
+
+	rhashtable_walk_enter(&neigh->nodes, &iter);
+	rhashtable_walk_start(&iter);
+
+	while ((node = rhashtable_walk_next(&iter))) {
+		if (IS_ERR(node))
+			continue;
+
+		if (vlan && node->key.vid != vlan->vid)
+			continue;
+
+		if (old && !ubr_neigh_node_is_old(neigh, node))
+			continue;
+
+		ubr_neigh_node_del(neigh, node);
+	}
+
+	rhashtable_walk_stop(&iter);
+	rhashtable_walk_exit(&iter);
+}
+
+/* Remove all entries of a VLAN, or of all VLANs if NULL */
+void ubr_neigh_flush(struct ubr_neigh *neigh, struct ubr_vlan *vlan)
+{
+	ubr_neigh_walk(neigh, vlan, false);
+}
+
+static void ubr_neigh_gc(struct work_struct *work)
+{
+	struct ubr_neigh *neigh = container_of(work, struct ubr_neigh,
+					       gc_work.work);
+	unsigned long timeout = ubr_from_neigh(neigh)->fdb.ageing_timeout;
+
+	ubr_neigh_walk(neigh, NULL, true);
+	queue_delayed_work(system_long_wq, &neigh->gc_work, timeout / 2);
+}
+
+int ubr_neigh_newlink(struct ubr_neigh *neigh)
+{
+	unsigned long timeout = ubr_from_neigh(neigh)->fdb.ageing_timeout;
+	int err;
+
+	atomic_set(&neigh->count, 0);
+
+	err = rhashtable_init(&neigh->nodes, &ubr_neigh_rht_params);
+	if (err)
+		return err;
+
+	INIT_DELAYED_WORK(&neigh->gc_work, ubr_neigh_gc);
+	queue_delayed_work(system_long_wq, &neigh->gc_work, timeout / 2);
+
+	return 0;
+}
+UBR_EXPORT_FOR_TEST(ubr_neigh_newlink);
+
+void ubr_neigh_dellink(struct ubr_neigh *neigh)
+{
+	cancel_delayed_work_sync(&neigh->gc_work);
+
+	ubr_neigh_flush(neigh, NULL);
+	rhashtable_destroy(&neigh->nodes);
+}
+UBR_EXPORT_FOR_TEST(ubr_neigh_dellink);
+
+static const struct nla_policy ubr_nl_neigh_policy[UBR_NLA_NEIGH_MAX + 1] = {
+	[UBR_NLA_NEIGH_UNSPEC] = { .type = NLA_UNSPEC },
+	[UBR_NLA_NEIGH_VID]    = { .type = NLA_U16 },
+	[UBR_NLA_NEIGH_IP4]    = { .type = NLA_U32 },
+	[UBR_NLA_NEIGH_IP6]    = { .len = sizeof(struct in6_addr) },
+	[UBR_NLA_NEIGH_LLADDR] = { .len = ETH_ALEN },
+};
+
+static int __get_key(struct genl_info *info, struct nlattr **attrs,
+		     struct ubr *ubr, struct ubr_neigh_key *key)
+{
+	int err;
+
+	if (!info->attrs || !info->attrs[UBR_NLA_NEIGH])
+		return -EINVAL;
+
+	err = nla_parse_nested(attrs, UBR_NLA_NEIGH_MAX,
+			       info->attrs[UBR_NLA_NEIGH],
+			       ubr_nl_neigh_policy, info->extack);
+	if (err)
+		return err;
+
+	if (!attrs[UBR_NLA_NEIGH_VID] ||
+	    !attrs[UBR_NLA_NEIGH_IP4] == !attrs[UBR_NLA_NEIGH_IP6])
+		return -EINVAL;
+
+	memset(key, 0, sizeof(*key));
+	key->vid = nla_get_u16(attrs[UBR_NLA_NEIGH_VID]);
+	if (!ubr_vlan_find(ubr, key->vid))
+		return -ENOENT;
+
+	if (attrs[UBR_NLA_NEIGH_IP4]) {
+		key->family = AF_INET;
+		key->ip4 = nla_get_in_addr(attrs[UBR_NLA_NEIGH_IP4]);
+		return 0;
+	}
+
+#if IS_ENABLED(CONFIG_IPV6)
+	key->family = AF_INET6;
+	key->ip6 = nla_get_in6_addr(attrs[UBR_NLA_NEIGH_IP6]);
+	return 0;
+#else
+	return -EAFNOSUPPORT;
+#endif
+}
+
+int ubr_neigh_nl_add_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *attrs[UBR_NLA_NEIGH_MAX + 1];
+	struct ubr_neigh_node *node;
+	struct ubr_neigh_key key;
+	struct net_device *dev;
+	struct ubr *ubr;
+	u8 *lladdr;
+	int err;
+
+	dev = ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+	err = __get_key(info, attrs, ubr, &key);
+	if (err)
+		goto out;
+
+	if (!attrs[UBR_NLA_NEIGH_LLADDR]) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	lladdr = nla_data(attrs[UBR_NLA_NEIGH_LLADDR]);
+	if (!is_valid_ether_addr(lladdr)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* Replaced rather than updated in place, so the data path
+	 * never sees a torn address.
+	 */
+	rcu_read_lock();
+	node = rhashtable_lookup(&ubr->neigh.nodes, &key,
+				 ubr_neigh_rht_params);
+	if (node)
+		ubr_neigh_node_del(&ubr->neigh, node);
+	rcu_read_unlock();
+
+	node = kzalloc(sizeof(*node), GFP_KERNEL);
+	if (!node) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	node->key = key;
+	ether_addr_copy(node->lladdr, lladdr);
+	node->proto = UBR_FDB_USER;
+	node->tstamp = jiffies;
+
+	err = rhashtable_lookup_insert_fast(&ubr->neigh.nodes, &node->rhnode,
+					    ubr_neigh_rht_params);
+	if (err) {
+		kfree(node);
+		goto out;
+	}
+
+	printk(KERN_NOTICE "Add neighbour %pM on %s VLAN %u\n",
+	       lladdr, dev->name, key.vid);
+out:
+	dev_put(dev);
+	return err;
+}
+
+int ubr_neigh_nl_del_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *attrs[UBR_NLA_NEIGH_MAX + 1];
+	struct ubr_neigh_node *node;
+	struct ubr_neigh_key key;
+	struct net_device *dev;
+	struct ubr *ubr;
+	int err;
+
+	dev = ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+	err = __get_key(info, attrs, ubr, &key);
+	if (err)
+		goto out;
+
+	/* The GC may race us to a snooped entry */
+	rcu_read_lock();
+	node = rhashtable_lookup(&ubr->neigh.nodes, &key,
+				 ubr_neigh_rht_params);
+	if (node)
+		ubr_neigh_node_del(&ubr->neigh, node);
+	rcu_read_unlock();
+
+	if (!node) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	printk(KERN_NOTICE "Del neighbour on %s VLAN %u\n", dev->name, key.vid);
+out:
+	dev_put(dev);
+	return err;
+}
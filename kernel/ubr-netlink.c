@@ -15,8 +15,16 @@ static const struct nla_policy ubr_nl_policy[UBR_NLA_MAX + 1] = {
 	[UBR_NLA_FDB]		= { .type = NLA_NESTED, },
 	[UBR_NLA_VLAN]		= { .type = NLA_NESTED, },
 	[UBR_NLA_PORT]		= { .type = NLA_NESTED, },
+	[UBR_NLA_BRIDGE]	= { .type = NLA_NESTED, },
+	[UBR_NLA_NEIGH]		= { .type = NLA_NESTED, },
+	[UBR_NLA_REMOTE]	= { .type = NLA_NESTED, },
 };
 
+/* Command may reach switchdev, whose drivers expect rtnl held, or
+ * reads port device state that rtnl protects
+ */
+#define UBR_NL_FLAG_RTNL	0x01
+
 static const struct genl_ops ubr_genl_ops[] = { {
 		.cmd    = UBR_NL_FDB_FLUSH,
 		.doit   = ubr_fdb_nl_flush_cmd,
@@ -26,26 +34,77 @@ static const struct genl_ops ubr_genl_ops[] = { {
 	}, {
 		.cmd    = UBR_NL_VLAN_DEL,
 		.doit   = ubr_vlan_nl_del_cmd,
+		.internal_flags = UBR_NL_FLAG_RTNL,
 	}, {
 		.cmd    = UBR_NL_VLAN_SET,
 		.doit   = ubr_vlan_nl_set_cmd,
 	}, {
 		.cmd    = UBR_NL_VLAN_ATTACH,
 		.doit   = ubr_vlan_nl_attach_cmd,
+		.internal_flags = UBR_NL_FLAG_RTNL,
 	}, {
 		.cmd    = UBR_NL_VLAN_DETACH,
 		.doit   = ubr_vlan_nl_detach_cmd,
+		.internal_flags = UBR_NL_FLAG_RTNL,
 	}, {
 		.cmd    = UBR_NL_PORT_SET,
 		.doit   = ubr_port_nl_set_cmd,
+		.internal_flags = UBR_NL_FLAG_RTNL,
+	}, {
+		.cmd    = UBR_NL_VLAN_BULK_ATTACH,
+		.doit   = ubr_vlan_nl_bulk_attach_cmd,
+		.internal_flags = UBR_NL_FLAG_RTNL,
+	}, {
+		.cmd    = UBR_NL_VLAN_BULK_DETACH,
+		.doit   = ubr_vlan_nl_bulk_detach_cmd,
+		.internal_flags = UBR_NL_FLAG_RTNL,
+	}, {
+		.cmd    = UBR_NL_PORT_GET,
+		.doit   = ubr_port_nl_get_cmd,
+	}, {
+		.cmd    = UBR_NL_FDB_SET,
+		.doit   = ubr_fdb_nl_set_cmd,
+	}, {
+		.cmd    = UBR_NL_BRIDGE_SET,
+		.doit   = ubr_dev_nl_set_cmd,
+		.internal_flags = UBR_NL_FLAG_RTNL,
+	}, {
+		.cmd    = UBR_NL_NEIGH_ADD,
+		.doit   = ubr_neigh_nl_add_cmd,
+	}, {
+		.cmd    = UBR_NL_NEIGH_DEL,
+		.doit   = ubr_neigh_nl_del_cmd,
+#if IS_ENABLED(CONFIG_VXLAN)
+	}, {
+		.cmd    = UBR_NL_REMOTE_ADD,
+		.doit   = ubr_tunnel_nl_add_cmd,
+	}, {
+		.cmd    = UBR_NL_REMOTE_DEL,
+		.doit   = ubr_tunnel_nl_del_cmd,
+#endif
 	},
 };
 
+static int ubr_netlink_pre_doit(const struct genl_ops *ops,
+				struct sk_buff *skb, struct genl_info *info);
+static void ubr_netlink_post_doit(const struct genl_ops *ops,
+				  struct sk_buff *skb, struct genl_info *info);
+
+/*
+ * Commands do not take the global genl mutex, instead each one holds
+ * the cfg_lock of the bridge it operates on, see pre/post_doit below.
+ * So different bridges are configured in parallel.  Commands flagged
+ * UBR_NL_FLAG_RTNL also take rtnl first, the same order as dellink,
+ * the netdev notifier and the switchdev work.
+ */
 static struct genl_family family = {
 	.name     = "ubr",
 	.version  = 1,
 	.maxattr  = 10,		/* XXX */
 	.netnsok  = false,
+	.parallel_ops = true,
+	.pre_doit  = ubr_netlink_pre_doit,
+	.post_doit = ubr_netlink_post_doit,
 	.module   = THIS_MODULE,
 	.ops      = ubr_genl_ops,
 	.n_ops    = ARRAY_SIZE(ubr_genl_ops),
@@ -53,7 +112,7 @@ static struct genl_family family = {
 
 static const struct net_device_ops *devops = NULL;
 
-struct net_device *ubr_netlink_dev(struct genl_info *info)
+static struct net_device *__ubr_netlink_dev(struct genl_info *info)
 {
 	struct net_device *dev;
 	int ifindex;
@@ -73,6 +132,66 @@ struct net_device *ubr_netlink_dev(struct genl_info *info)
 	return dev;
 }
 
+static int ubr_netlink_pre_doit(const struct genl_ops *ops,
+				struct sk_buff *skb, struct genl_info *info)
+{
+	struct net_device *dev;
+	struct ubr *ubr;
+
+	dev = __ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+	if (ops->internal_flags & UBR_NL_FLAG_RTNL)
+		rtnl_lock();
+
+	mutex_lock(&ubr->cfg_lock);
+	if (ubr->dead) {
+		mutex_unlock(&ubr->cfg_lock);
+		if (ops->internal_flags & UBR_NL_FLAG_RTNL)
+			rtnl_unlock();
+
+		dev_put(dev);
+		return -ENODEV;
+	}
+
+	info->user_ptr[0] = dev;
+	return 0;
+}
+
+static void ubr_netlink_post_doit(const struct genl_ops *ops,
+				  struct sk_buff *skb, struct genl_info *info)
+{
+	struct net_device *dev = info->user_ptr[0];
+	struct ubr *ubr = netdev_priv(dev);
+
+	/* Whatever the command changed is published by now */
+	ubr_flow_flush(ubr);
+
+	mutex_unlock(&ubr->cfg_lock);
+	if (ops->internal_flags & UBR_NL_FLAG_RTNL)
+		rtnl_unlock();
+
+	dev_put(dev);
+}
+
+/* The bridge of the current command, locked.  Release with dev_put() */
+struct net_device *ubr_netlink_dev(struct genl_info *info)
+{
+	struct net_device *dev = info->user_ptr[0];
+
+	if (dev)
+		dev_hold(dev);
+
+	return dev;
+}
+
+void *ubr_netlink_put_reply(struct sk_buff *msg, struct genl_info *info)
+{
+	return genlmsg_put_reply(msg, info, &family, 0, info->genlhdr->cmd);
+}
+
 int ubr_netlink_init(const struct net_device_ops *ops)
 {
 	int err;
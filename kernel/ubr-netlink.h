@@ -15,6 +15,21 @@ enum {
 
 	UBR_NL_PORT_SET,
 
+	UBR_NL_VLAN_BULK_ATTACH,
+	UBR_NL_VLAN_BULK_DETACH,
+
+	UBR_NL_PORT_GET,
+
+	UBR_NL_FDB_SET,
+
+	UBR_NL_BRIDGE_SET,
+
+	UBR_NL_NEIGH_ADD,
+	UBR_NL_NEIGH_DEL,
+
+	UBR_NL_REMOTE_ADD,
+	UBR_NL_REMOTE_DEL,
+
 	__UBR_NL_CMD_MAX,
 	UBR_NL_CMD_MAX = __UBR_NL_CMD_MAX - 1
 };
@@ -25,17 +40,76 @@ enum {
 	UBR_NLA_FDB,
 	UBR_NLA_VLAN,
 	UBR_NLA_PORT,
+	UBR_NLA_BRIDGE,
+	UBR_NLA_NEIGH,
+	UBR_NLA_REMOTE,
 
 	__UBR_NLA_MAX,
 	UBR_NLA_MAX = __UBR_NLA_MAX - 1
 };
 
+enum {
+	UBR_NLA_BRIDGE_UNSPEC,
+	UBR_NLA_BRIDGE_VLAN_PROTO,	/* u16, ETH_P_8021Q or ETH_P_8021AD */
+	UBR_NLA_BRIDGE_FLOW_CACHE,	/* u32, entries per CPU, 0 for off */
+
+	__UBR_NLA_BRIDGE_MAX,
+	UBR_NLA_BRIDGE_MAX = __UBR_NLA_BRIDGE_MAX - 1
+};
+
+/* Controller managed neighbour entry, exactly one of IP4 and IP6 */
+enum {
+	UBR_NLA_NEIGH_UNSPEC,
+	UBR_NLA_NEIGH_VID,		/* u16 */
+	UBR_NLA_NEIGH_IP4,		/* u32, network byte order */
+	UBR_NLA_NEIGH_IP6,		/* 16 bytes */
+	UBR_NLA_NEIGH_LLADDR,		/* 6 bytes, only for add */
+
+	__UBR_NLA_NEIGH_MAX,
+	UBR_NLA_NEIGH_MAX = __UBR_NLA_NEIGH_MAX - 1
+};
+
+/* Tunnel endpoint in a VLAN's overlay, exactly one of IP4 and IP6.
+ * Without LLADDR it is a head end replication target for floods,
+ * with it a static FDB entry for LLADDR behind the endpoint.
+ */
+enum {
+	UBR_NLA_REMOTE_UNSPEC,
+	UBR_NLA_REMOTE_VID,		/* u16 */
+	UBR_NLA_REMOTE_IP4,		/* u32, network byte order */
+	UBR_NLA_REMOTE_IP6,		/* 16 bytes */
+	UBR_NLA_REMOTE_LLADDR,		/* 6 bytes */
+
+	__UBR_NLA_REMOTE_MAX,
+	UBR_NLA_REMOTE_MAX = __UBR_NLA_REMOTE_MAX - 1
+};
+
+enum {
+	UBR_NLA_FDB_UNSPEC,
+	UBR_NLA_FDB_POOL_SIZE,		/* u32, free nodes kept per CPU */
+
+	__UBR_NLA_FDB_MAX,
+	UBR_NLA_FDB_MAX = __UBR_NLA_FDB_MAX - 1
+};
+
 enum {
 	UBR_NLA_VLAN_UNSPEC,
 	UBR_NLA_VLAN_VID,
 	UBR_NLA_VLAN_PORT,
 	UBR_NLA_VLAN_TAGGED,
 	UBR_NLA_VLAN_LEARNING,
+	UBR_NLA_VLAN_VID_END,
+	UBR_NLA_VLAN_PORTS,
+	UBR_NLA_VLAN_TAGGED_PORTS,
+	UBR_NLA_VLAN_FLOOD_UNICAST,
+	UBR_NLA_VLAN_FLOOD_MULTICAST,
+	UBR_NLA_VLAN_FLOOD_BROADCAST,
+	UBR_NLA_VLAN_LEARN_LIMIT,
+	UBR_NLA_VLAN_LEARN_RATE,
+	UBR_NLA_VLAN_LEARN_ACTION,
+	UBR_NLA_VLAN_FID,		/* u16, defaults to the VID */
+	UBR_NLA_VLAN_NEIGH_SUPPRESS,
+	UBR_NLA_VLAN_VNI,		/* u32, 0 for none */
 
 	__UBR_NLA_VLAN_MAX,
 	UBR_NLA_VLAN_MAX = __UBR_NLA_VLAN_MAX - 1
@@ -45,9 +119,70 @@ enum {
 	UBR_NLA_PORT_UNSPEC,
 	UBR_NLA_PORT_IFINDEX,
 	UBR_NLA_PORT_PVID,
+	UBR_NLA_PORT_LEARNING,
+	UBR_NLA_PORT_FLOOD_UNICAST,
+	UBR_NLA_PORT_FLOOD_MULTICAST,
+	UBR_NLA_PORT_FLOOD_BROADCAST,
+	UBR_NLA_PORT_STORM_UNICAST,
+	UBR_NLA_PORT_STORM_MULTICAST,
+	UBR_NLA_PORT_STORM_BROADCAST,
+	UBR_NLA_PORT_STATS,
+	UBR_NLA_PORT_LEARN_LIMIT,
+	UBR_NLA_PORT_LEARN_RATE,
+	UBR_NLA_PORT_LEARN_ACTION,
+	UBR_NLA_PORT_LAG,		/* u32, group ID 1-32, 0 for none */
+	UBR_NLA_PORT_OFFLOAD,		/* u32, read-only, in a switchdev domain */
+	UBR_NLA_PORT_VID_XLATE,		/* nested, set only */
 
 	__UBR_NLA_PORT_MAX,
 	UBR_NLA_PORT_MAX = __UBR_NLA_PORT_MAX - 1
 };
 
+/* VID translation, port VID to bridge VID and back, BVID 0 removes */
+enum {
+	UBR_NLA_VID_XLATE_UNSPEC,
+	UBR_NLA_VID_XLATE_VID,		/* u16 */
+	UBR_NLA_VID_XLATE_BVID,		/* u16 */
+
+	__UBR_NLA_VID_XLATE_MAX,
+	UBR_NLA_VID_XLATE_MAX = __UBR_NLA_VID_XLATE_MAX - 1
+};
+
+/* Storm control policer, rate is in bits/s unless PPS is set */
+enum {
+	UBR_NLA_STORM_UNSPEC,
+	UBR_NLA_STORM_RATE,
+	UBR_NLA_STORM_PPS,
+
+	__UBR_NLA_STORM_MAX,
+	UBR_NLA_STORM_MAX = __UBR_NLA_STORM_MAX - 1
+};
+
+enum {
+	UBR_NLA_PORT_STATS_UNSPEC,
+	UBR_NLA_PORT_STATS_PAD,
+	UBR_NLA_PORT_STATS_STORM_UC_DROPS,
+	UBR_NLA_PORT_STATS_STORM_MC_DROPS,
+	UBR_NLA_PORT_STATS_STORM_BC_DROPS,
+	UBR_NLA_PORT_STATS_LEARNED,
+	UBR_NLA_PORT_STATS_LEARN_OVERFLOWS,
+	UBR_NLA_PORT_STATS_LEARN_POOL_EMPTY,
+	UBR_NLA_PORT_STATS_REPLICATION_DROPS,
+
+	__UBR_NLA_PORT_STATS_MAX,
+	UBR_NLA_PORT_STATS_MAX = __UBR_NLA_PORT_STATS_MAX - 1
+};
+
+/* What to do with a frame from a new address when a learning limit
+ * (count or rate) is exceeded.
+ */
+enum {
+	UBR_LEARN_LIMIT_FORWARD,	/* Forward without learning */
+	UBR_LEARN_LIMIT_DROP,		/* Drop the frame */
+	UBR_LEARN_LIMIT_DISABLE,	/* Forward, stop learning until reset */
+
+	__UBR_LEARN_LIMIT_MAX,
+	UBR_LEARN_LIMIT_MAX = __UBR_LEARN_LIMIT_MAX - 1
+};
+
 #endif /* UBR_NETLINK_H_ */
@@ -0,0 +1,118 @@
+#include <linux/if_ether.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/skbuff.h>
+
+#include "ubr-private.h"
+
+/* Allow bursts of 100ms worth of traffic, or at least one frame */
+#define UBR_POLICE_BURST_NS (NSEC_PER_SEC / 10)
+
+/*
+ * Each CPU runs its own bucket so the fast path never has to
+ * synchronize with other CPUs.  Consequently the rate applies per
+ * CPU, which also bounds the softirq time spent on policed traffic
+ * on every CPU.
+ */
+bool ubr_police_allow(struct ubr_police *pol, unsigned int len)
+{
+	struct ubr_police_pcpu *pc = this_cpu_ptr(pol->pcpu);
+	u64 now = ktime_get_ns();
+	s64 toks;
+
+	toks = min_t(s64, now - pc->stamp, pol->burst) + pc->tokens;
+	if (toks > pol->burst)
+		toks = pol->burst;
+
+	if (pol->pps)
+		toks -= (s64)psched_pkt2t_ns(&pol->pps_cfg, 1);
+	else
+		toks -= (s64)psched_l2t_ns(&pol->bps_cfg, len);
+
+	if (toks < 0)
+		return false;
+
+	pc->tokens = toks;
+	pc->stamp = now;
+	return true;
+}
+
+struct ubr_police *ubr_police_new(u64 rate, bool pps)
+{
+	struct tc_ratespec spec = { .linklayer = TC_LINKLAYER_ETHERNET };
+	struct ubr_police *pol;
+	u64 now = ktime_get_ns();
+	int cpu;
+
+	pol = kzalloc(sizeof(*pol), GFP_KERNEL);
+	if (!pol)
+		return NULL;
+
+	pol->pcpu = alloc_percpu(struct ubr_police_pcpu);
+	if (!pol->pcpu) {
+		kfree(pol);
+		return NULL;
+	}
+
+	pol->pps = pps;
+	pol->rate = rate;
+	if (pps) {
+		psched_ppscfg_precompute(&pol->pps_cfg, rate);
+		pol->burst = max_t(s64, UBR_POLICE_BURST_NS,
+				   psched_pkt2t_ns(&pol->pps_cfg, 1));
+	} else {
+		psched_ratecfg_precompute(&pol->bps_cfg, &spec, rate);
+		pol->burst = max_t(s64, UBR_POLICE_BURST_NS,
+				   psched_l2t_ns(&pol->bps_cfg, ETH_FRAME_LEN));
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct ubr_police_pcpu *pc = per_cpu_ptr(pol->pcpu, cpu);
+
+		pc->tokens = pol->burst;
+		pc->stamp = now;
+	}
+
+	return pol;
+}
+
+static void ubr_police_free_rcu(struct rcu_head *head)
+{
+	struct ubr_police *pol = container_of(head, struct ubr_police, rcu);
+
+	free_percpu(pol->pcpu);
+	kfree(pol);
+}
+
+void ubr_police_free(struct ubr_police *pol)
+{
+	if (pol)
+		call_rcu(&pol->rcu, ubr_police_free_rcu);
+}
+
+bool ubr_storm_allow(struct ubr_port *p, struct sk_buff *skb,
+		     enum ubr_storm_class class)
+{
+	struct ubr_police *pol = rcu_dereference(p->storm[class]);
+
+	if (likely(!pol))
+		return true;
+
+	if (likely(ubr_police_allow(pol, skb->len + ETH_HLEN)))
+		return true;
+
+	ubr_port_stats_inc(p, storm_drops[class]);
+	return false;
+}
+
+/* Swap in a policer from ubr_police_new(), NULL disables. */
+void ubr_storm_publish(struct ubr_port *p, enum ubr_storm_class class,
+		       struct ubr_police *pol)
+{
+	struct ubr_police *old;
+
+	/* Serialised by the bridge's cfg_lock */
+	old = rcu_dereference_protected(p->storm[class], 1);
+	rcu_assign_pointer(p->storm[class], pol);
+	ubr_police_free(old);
+}
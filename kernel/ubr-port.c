@@ -12,6 +12,30 @@ const struct nla_policy ubr_nl_port_policy[UBR_NLA_PORT_MAX + 1] = {
 	[UBR_NLA_PORT_UNSPEC]   = { .type = NLA_UNSPEC },
 	[UBR_NLA_PORT_IFINDEX]  = { .type = NLA_U32    },
 	[UBR_NLA_PORT_PVID]     = { .type = NLA_U16    },
+	[UBR_NLA_PORT_LEARNING] = { .type = NLA_U32    }, /* XXX: bool */
+	[UBR_NLA_PORT_FLOOD_UNICAST]   = { .type = NLA_U32 }, /* XXX: bool */
+	[UBR_NLA_PORT_FLOOD_MULTICAST] = { .type = NLA_U32 }, /* XXX: bool */
+	[UBR_NLA_PORT_FLOOD_BROADCAST] = { .type = NLA_U32 }, /* XXX: bool */
+	[UBR_NLA_PORT_STORM_UNICAST]   = { .type = NLA_NESTED },
+	[UBR_NLA_PORT_STORM_MULTICAST] = { .type = NLA_NESTED },
+	[UBR_NLA_PORT_STORM_BROADCAST] = { .type = NLA_NESTED },
+	[UBR_NLA_PORT_LEARN_LIMIT]     = { .type = NLA_U32 },
+	[UBR_NLA_PORT_LEARN_RATE]      = { .type = NLA_U32 },
+	[UBR_NLA_PORT_LEARN_ACTION]    = { .type = NLA_U32 },
+	[UBR_NLA_PORT_LAG]             = { .type = NLA_U32 },
+	[UBR_NLA_PORT_VID_XLATE]       = { .type = NLA_NESTED },
+};
+
+const struct nla_policy ubr_nl_vid_xlate_policy[UBR_NLA_VID_XLATE_MAX + 1] = {
+	[UBR_NLA_VID_XLATE_UNSPEC] = { .type = NLA_UNSPEC },
+	[UBR_NLA_VID_XLATE_VID]    = { .type = NLA_U16    },
+	[UBR_NLA_VID_XLATE_BVID]   = { .type = NLA_U16    },
+};
+
+const struct nla_policy ubr_nl_storm_policy[UBR_NLA_STORM_MAX + 1] = {
+	[UBR_NLA_STORM_UNSPEC]  = { .type = NLA_UNSPEC },
+	[UBR_NLA_STORM_RATE]    = { .type = NLA_U64    },
+	[UBR_NLA_STORM_PPS]     = { .type = NLA_U32    }, /* XXX: bool */
 };
 
 static rx_handler_result_t ubr_port_rx_handler(struct sk_buff **pskb)
@@ -22,16 +46,31 @@ static rx_handler_result_t ubr_port_rx_handler(struct sk_buff **pskb)
 
 	memcpy(cb, &p->ingress_cb, sizeof(*cb));
 
-	return ubr_forward(ubr_from_port(p), skb) ?
-		RX_HANDLER_ANOTHER :
-		RX_HANDLER_CONSUMED;
+	skb = ubr_forward(ubr_from_port(p), skb);
+	if (!skb)
+		return RX_HANDLER_CONSUMED;
+
+	*pskb = skb;
+	return RX_HANDLER_ANOTHER;
 }
 
 static void __ubr_port_cleanup(struct rcu_head *head)
 {
 	struct ubr_port *p = container_of(head, struct ubr_port, rcu);
+	struct ubr *ubr = ubr_from_port(p);
+	unsigned pidx = p->ingress_cb.pidx;
+	int class;
+
+	for (class = 0; class < UBR_STORM_MAX; class++)
+		ubr_police_free(rcu_dereference_protected(p->storm[class], 1));
 
+	ubr_learn_limit_destroy(&p->learn);
+	kfree(rcu_dereference_protected(p->xlate, 1));
+	free_percpu(p->stats);
 	memset(p, 0, sizeof(*p));
+
+	/* Only now may __ubr_port_add() hand out the slot again */
+	ubr_vec_clear(&ubr->dying, pidx);
 }
 
 void ubr_port_cleanup(struct ubr_port *p)
@@ -40,17 +79,101 @@ void ubr_port_cleanup(struct ubr_port *p)
 	unsigned pidx = p->ingress_cb.pidx;
 
 	printk(KERN_NOTICE "Clearing pidx %d from bridge %s\n", pidx, ubr->dev->name);
+	ubr_switchdev_port_fini(p);
+	ubr_vec_set(&ubr->dying, pidx);
 	ubr_vec_clear(&ubr->busy, pidx);
+	ubr_vec_clear(&ubr->active, pidx);
+	ubr_vec_clear(&ubr->tunnels, pidx);
+	if (rcu_access_pointer(p->xlate))
+		static_branch_dec(&ubr_vlan_xlate_used);
+
 	call_rcu(&p->rcu, __ubr_port_cleanup);
 }
+UBR_EXPORT_FOR_TEST(ubr_port_cleanup);
+
+/*
+ * Frames delivered to the host are handed to the stack, which always
+ * accepts the tag as metadata.  Other ports need the VLAN TX offload
+ * matching the bridge's protocol, otherwise ubr_common_egress() puts
+ * the tag in the frame itself.  Called with rtnl and cfg_lock held,
+ * the device features and ubr->sw_tagging are updated under them.
+ */
+void ubr_port_update_offloads(struct ubr_port *p)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	netdev_features_t feature;
+
+	feature = ubr->vlan_proto == ETH_P_8021AD ?
+		NETIF_F_HW_VLAN_STAG_TX : NETIF_F_HW_VLAN_CTAG_TX;
+
+	if (p->dev == ubr->dev || (p->dev->features & feature))
+		ubr_vec_clear(&ubr->sw_tagging, p->ingress_cb.pidx);
+	else
+		ubr_vec_set(&ubr->sw_tagging, p->ingress_cb.pidx);
+}
+
+/*
+ * Track the port's link in ubr->active, delivery only considers those
+ * ports.  Addresses behind a lost link are flushed, unless another link
+ * of the same LAG is still up.  Called with cfg_lock held.
+ */
+void ubr_port_link_update(struct ubr_port *p)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	struct ubr_fdb_flush_op op = {
+		.per_port = true,
+		.pidx = p->ingress_cb.lpidx,
+		.per_proto = true,
+		.proto = UBR_FDB_DYNAMIC,
+	};
+	unsigned pidx = p->ingress_cb.pidx, i;
+	bool up;
+
+	lockdep_assert_held(&ubr->cfg_lock);
+
+	up = netif_running(p->dev) && netif_oper_up(p->dev);
+	if (up == ubr_vec_test(&ubr->active, pidx))
+		return;
+
+	if (up)
+		ubr_vec_set(&ubr->active, pidx);
+	else
+		ubr_vec_clear(&ubr->active, pidx);
+
+	if (p->lag)
+		ubr_lag_update(ubr);
+
+	if (up)
+		return;
+
+	ubr_vec_foreach(&ubr->busy, i) {
+		if (p->lag && ubr->ports[i].lag == p->lag &&
+		    ubr_vec_test(&ubr->active, i))
+			return;
+	}
+
+	ubr_fdb_flush(&ubr->fdb, op);
+}
 
 struct ubr_port *ubr_port_init(struct ubr *ubr, unsigned pidx, struct net_device *dev)
 {
 	struct ubr_port *p = &ubr->ports[pidx];
 	struct ubr_cb *cb = &p->ingress_cb;
+	int err;
 
 	p->dev = dev;
 	cb->pidx = pidx;
+	cb->lpidx = pidx;
+	ubr_port_update_offloads(p);
+	ubr_tunnel_port_init(p);
+
+	p->stats = netdev_alloc_pcpu_stats(struct ubr_port_stats);
+	if (!p->stats)
+		return ERR_PTR(-ENOMEM);
+
+	err = ubr_learn_limit_init(&p->learn);
+	if (err)
+		goto err_free_stats;
 
 	/* TODO: false, i.e. "hub" mode is probably the right default
 	 * here if we are to stay true to the "userspace does _all_
@@ -58,6 +181,7 @@ struct ubr_port *ubr_port_init(struct ubr *ubr, unsigned pidx, struct net_device
 	 * this.
 	 */
 	cb->sa_learning = 1;
+	ubr_pipeline_update(cb);
 
 	/* Allow egress on all ports execpt this one. */
 	ubr_vec_fill(&cb->vec);
@@ -65,17 +189,28 @@ struct ubr_port *ubr_port_init(struct ubr *ubr, unsigned pidx, struct net_device
 
 	/* Put all ports in VLAN 0. */
 	cb->vlan = ubr_vlan_find(ubr, 0);
-	ubr_vlan_port_add(cb->vlan, pidx, 0);
+	err = ubr_vlan_port_add(cb->vlan, pidx, 0);
+	if (err)
+		goto err_learn_destroy;
 
-	/* err = ubr_switchdev_port_init(p); */
-	/* if (err) */
-	/* 	return err; */
+	err = ubr_switchdev_port_init(p);
+	if (err)
+		goto err_vlan_del;
 
 	smp_wmb();
 	ubr_vec_set(&ubr->busy, pidx);
 
 	return p;
+
+err_vlan_del:
+	ubr_vlan_port_del(cb->vlan, pidx);
+err_learn_destroy:
+	ubr_learn_limit_destroy(&p->learn);
+err_free_stats:
+	free_percpu(p->stats);
+	return ERR_PTR(err);
 }
+UBR_EXPORT_FOR_TEST(ubr_port_init);
 
 static int __ubr_port_add_allowed(struct net_device *dev,
 				  struct netlink_ext_ack *extack)
@@ -110,10 +245,27 @@ static int __ubr_port_add_allowed(struct net_device *dev,
 	return 0;
 }
 
-int ubr_port_add(struct ubr *ubr, struct net_device *dev,
-		 struct netlink_ext_ack *extack)
+/* Undo ubr_port_init() for a port that never received a frame */
+static void ubr_port_uninit(struct ubr_port *p)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	unsigned pidx = p->ingress_cb.pidx;
+
+	ubr_vec_clear(&ubr->busy, pidx);
+	ubr_vec_clear(&ubr->tunnels, pidx);
+	ubr_switchdev_port_fini(p);
+	ubr_vlan_port_del(ubr_vlan_find(ubr, 0), pidx);
+
+	/* Floods in VLAN 0 may still be looking at the port */
+	synchronize_net();
+	__ubr_port_cleanup(&p->rcu);
+}
+
+static int __ubr_port_add(struct ubr *ubr, struct net_device *dev,
+			  struct netlink_ext_ack *extack)
 {
 	struct ubr_port *p;
+	struct ubr_vec used;
 	int err, pidx;
 
 	printk(KERN_NOTICE "Adding port %s to bridge %s ...\n", dev->name, ubr->dev->name);
@@ -121,7 +273,9 @@ int ubr_port_add(struct ubr *ubr, struct net_device *dev,
 	if (err)
 		return err;
 
-	pidx = find_first_zero_bit(ubr->busy.bitmap, UBR_MAX_PORTS);
+	used = ubr->busy;
+	ubr_vec_or(&used, &ubr->dying);
+	pidx = find_first_zero_bit(used.bitmap, UBR_MAX_PORTS);
 	if (pidx == UBR_MAX_PORTS) {
 		NL_SET_ERR_MSG(extack, "Maximum number of ports reached");
 		return -EBUSY;
@@ -132,7 +286,7 @@ int ubr_port_add(struct ubr *ubr, struct net_device *dev,
 		return PTR_ERR(p);
 
 	ubr_update_headroom(ubr, dev);
-	netdev_update_features(ubr->dev);
+	ubr_update_features(ubr);
 	call_netdevice_notifiers(NETDEV_JOIN, dev);
 
 	err = netdev_master_upper_dev_link(dev, ubr->dev, NULL, NULL, extack);
@@ -152,6 +306,7 @@ int ubr_port_add(struct ubr *ubr, struct net_device *dev,
 		goto err_clear_allmulti;
 
 	dev->priv_flags |= IFF_UBR_PORT;
+	ubr_port_link_update(p);
 
 	return 0;
 
@@ -162,8 +317,22 @@ err_clear_promisc:
 err_unlink:
 	netdev_upper_dev_unlink(dev, ubr->dev);
 err_uninit:
-	ubr_vec_clear(&ubr->busy, pidx);
-	__ubr_port_cleanup(&p->rcu);
+	ubr_port_uninit(p);
+	ubr_update_features(ubr);
+
+	return err;
+}
+
+int ubr_port_add(struct ubr *ubr, struct net_device *dev,
+		 struct netlink_ext_ack *extack)
+{
+	int err;
+
+	mutex_lock(&ubr->cfg_lock);
+	err = __ubr_port_add(ubr, dev, extack);
+	if (!err)
+		ubr_flow_flush(ubr);
+	mutex_unlock(&ubr->cfg_lock);
 
 	return err;
 }
@@ -172,13 +341,26 @@ int ubr_port_del(struct ubr *ubr, struct net_device *dev)
 {
 	struct ubr_port *p = ubr_port_get_rtnl(dev);
 
+	mutex_lock(&ubr->cfg_lock);
+
 	printk(KERN_NOTICE "Removing port %s from bridge %s ...\n", dev->name, ubr->dev->name);
 	dev->priv_flags &= ~IFF_UBR_PORT;
 	netdev_rx_handler_unregister(dev);
 	dev_set_allmulti(dev, -1);
 	dev_set_promiscuity(dev, -1);
 	netdev_upper_dev_unlink(dev, ubr->dev);
+
+	/* The port can no longer learn, drop everything it has. */
+	ubr_fdb_flush(&ubr->fdb, (struct ubr_fdb_flush_op) {
+			.per_port = true,
+			.pidx = p->ingress_cb.pidx,
+		});
 	ubr_port_cleanup(p);
+	if (p->lag)
+		ubr_lag_update(ubr);
+	ubr_update_features(ubr);
+	ubr_flow_flush(ubr);
+	mutex_unlock(&ubr->cfg_lock);
 
 	return 0;
 }
@@ -198,6 +380,30 @@ int ubr_port_find(struct ubr *ubr, struct net_device *dev)
 	return -ENOENT;
 }
 
+/*
+ * Resolve an ifindex to a port index without walking the busy vector,
+ * the port's rx_handler_data already points to its slot in the bridge.
+ */
+int ubr_port_find_by_ifindex(struct ubr *ubr, struct net *net, u32 ifindex)
+{
+	struct net_device *dev;
+	struct ubr_port *p;
+	int pidx = -ENODEV;
+
+	rcu_read_lock();
+	dev = dev_get_by_index_rcu(net, ifindex);
+	if (dev == ubr->dev) {
+		pidx = 0;
+	} else if (dev && netif_is_ubr_port(dev)) {
+		p = ubr_port_get_rcu(dev);
+		if (ubr_from_port(p) == ubr)
+			pidx = p->ingress_cb.pidx;
+	}
+	rcu_read_unlock();
+
+	return pidx;
+}
+
 static int __get_port(struct genl_info *info, struct nlattr **attrs,
 		      u32 *port)
 {
@@ -220,49 +426,358 @@ static int __get_port(struct genl_info *info, struct nlattr **attrs,
 	return 0;
 }
 
+static bool __set_flood(struct nlattr **attrs, int type,
+			struct ubr_vec *flood, unsigned pidx)
+{
+	if (!attrs[type])
+		return false;
+
+	if (nla_get_u32(attrs[type]))
+		ubr_vec_set(flood, pidx);
+	else
+		ubr_vec_clear(flood, pidx);
+
+	return true;
+}
+
+static int __get_storm(struct genl_info *info, struct nlattr **attrs,
+		       int type, struct ubr_police **pol)
+{
+	struct nlattr *storm[UBR_NLA_STORM_MAX + 1];
+	bool pps = false;
+	u64 rate = 0;
+	int err;
+
+	if (!attrs[type])
+		return 0;
+
+	err = nla_parse_nested(storm, UBR_NLA_STORM_MAX, attrs[type],
+			       ubr_nl_storm_policy, info->extack);
+	if (err)
+		return err;
+
+	if (storm[UBR_NLA_STORM_RATE])
+		rate = nla_get_u64(storm[UBR_NLA_STORM_RATE]);
+	if (storm[UBR_NLA_STORM_PPS])
+		pps = !!nla_get_u32(storm[UBR_NLA_STORM_PPS]);
+
+	/* Userspace speaks bits, policers bytes, per second. */
+	if (!pps)
+		rate = div_u64(rate, 8);
+
+	/* Zero disables */
+	if (!rate)
+		return 0;
+
+	*pol = ubr_police_new(rate, pps);
+	return *pol ? 0 : -ENOMEM;
+}
+
+static struct ubr_vid_xlate *__get_vid_xlate(struct genl_info *info,
+					     struct nlattr **attrs,
+					     struct ubr_port *p)
+{
+	struct nlattr *xlate[UBR_NLA_VID_XLATE_MAX + 1];
+	int err;
+
+	err = nla_parse_nested(xlate, UBR_NLA_VID_XLATE_MAX,
+			       attrs[UBR_NLA_PORT_VID_XLATE],
+			       ubr_nl_vid_xlate_policy, info->extack);
+	if (err)
+		return ERR_PTR(err);
+
+	if (!xlate[UBR_NLA_VID_XLATE_VID] || !xlate[UBR_NLA_VID_XLATE_BVID])
+		return ERR_PTR(-EINVAL);
+
+	return ubr_vlan_xlate_build(p, nla_get_u16(xlate[UBR_NLA_VID_XLATE_VID]),
+				    nla_get_u16(xlate[UBR_NLA_VID_XLATE_BVID]));
+}
+
+static const int ubr_storm_attrs[UBR_STORM_MAX] = {
+	[UBR_STORM_UC] = UBR_NLA_PORT_STORM_UNICAST,
+	[UBR_STORM_MC] = UBR_NLA_PORT_STORM_MULTICAST,
+	[UBR_STORM_BC] = UBR_NLA_PORT_STORM_BROADCAST,
+};
+
+/*
+ * Everything that can fail is validated and allocated before anything
+ * is changed, so a failing command leaves the port as it was.
+ */
 int ubr_port_nl_set_cmd(struct sk_buff *skb, struct genl_info *info)
 {
+	struct ubr_police *storm[UBR_STORM_MAX] = {};
 	struct nlattr *attrs[UBR_NLA_PORT_MAX + 1];
-	struct net_device *dev, *port;
+	struct ubr_vec ucflood, mcflood, bcflood;
+	struct ubr_vid_xlate *xlate = NULL;
+	struct ubr_learn_limit_cfg learn;
+	struct ubr_lags *lags = NULL;
+	struct net_device *dev;
 	struct ubr_port *p;
 	struct ubr_cb *cb;
 	struct ubr *ubr;
-	int ifindex;
-	int pidx;
-	u16 pvid = 0;
+	bool flood = false, learning;
+	u16 old_pvid;
+	u32 ifindex, lag;
+	int pidx, class;
 	int err;
 
 	err = __get_port(info, attrs, &ifindex);
 	if (err)
 		return err;
-	port = dev_get_by_index(genl_info_net(info), ifindex);
-
-	if (attrs[UBR_NLA_PORT_PVID])
-		pvid = nla_get_u16(attrs[UBR_NLA_PORT_PVID]);
 
 	dev = ubr_netlink_dev(info);
 	if (!dev)
 		return -EINVAL;
 
 	ubr = netdev_priv(dev);
-	if (!ubr)
-		goto err;
 
-	pidx = ubr_port_find(ubr, port);
-	if (pidx < 0 || pidx >= UBR_MAX_PORTS)
-		goto err;
+	pidx = ubr_port_find_by_ifindex(ubr, genl_info_net(info), ifindex);
+	if (pidx < 0) {
+		err = pidx;
+		goto out;
+	}
+
+	p = &ubr->ports[pidx];
+	cb = &p->ingress_cb;
+
+	lag = attrs[UBR_NLA_PORT_LAG] ?
+		nla_get_u32(attrs[UBR_NLA_PORT_LAG]) : p->lag;
+	if (lag != p->lag) {
+		lags = ubr_lag_port_build(p, lag);
+		if (IS_ERR(lags)) {
+			err = PTR_ERR(lags);
+			goto out;
+		}
+	}
+
+	if (attrs[UBR_NLA_PORT_VID_XLATE]) {
+		xlate = __get_vid_xlate(info, attrs, p);
+		if (IS_ERR(xlate)) {
+			err = PTR_ERR(xlate);
+			goto err_lags;
+		}
+	}
+
+	err = ubr_learn_limit_nl_build(&p->learn,
+				       attrs[UBR_NLA_PORT_LEARN_LIMIT],
+				       attrs[UBR_NLA_PORT_LEARN_RATE],
+				       attrs[UBR_NLA_PORT_LEARN_ACTION],
+				       &learn);
+	if (err)
+		goto err_xlate;
+
+	for (class = 0; class < UBR_STORM_MAX; class++) {
+		err = __get_storm(info, attrs, ubr_storm_attrs[class],
+				  &storm[class]);
+		if (err)
+			goto err_police;
+	}
+
+	learning = cb->sa_learning;
+	if (attrs[UBR_NLA_PORT_LEARNING])
+		learning = !!nla_get_u32(attrs[UBR_NLA_PORT_LEARNING]);
+
+	/* Hardware may refuse the flags, ask before the data path sees
+	 * them.  It only sees the flood vectors by way of the VLANs, see
+	 * ubr_vlan_flood_update(), so they are restored if refused.
+	 */
+	ucflood = ubr->ucflood;
+	mcflood = ubr->mcflood;
+	bcflood = ubr->bcflood;
+	flood |= __set_flood(attrs, UBR_NLA_PORT_FLOOD_UNICAST,
+			     &ubr->ucflood, pidx);
+	flood |= __set_flood(attrs, UBR_NLA_PORT_FLOOD_MULTICAST,
+			     &ubr->mcflood, pidx);
+	flood |= __set_flood(attrs, UBR_NLA_PORT_FLOOD_BROADCAST,
+			     &ubr->bcflood, pidx);
+
+	if (attrs[UBR_NLA_PORT_LEARNING] || flood) {
+		err = ubr_switchdev_port_flags(p, learning);
+		if (err) {
+			ubr->ucflood = ucflood;
+			ubr->mcflood = mcflood;
+			ubr->bcflood = bcflood;
+			goto err_police;
+		}
+	}
+
+	if (attrs[UBR_NLA_PORT_PVID]) {
+		old_pvid = p->pvid;
+		p->pvid = nla_get_u16(attrs[UBR_NLA_PORT_PVID]);
+		WRITE_ONCE(cb->vlan, ubr_vlan_find(ubr, p->pvid));
+		cb->vlan_filtering = !!p->pvid;
+		ubr_switchdev_port_pvid(p, old_pvid);
+	}
+
+	cb->sa_learning = learning;
+	ubr_pipeline_update(cb);
+
+	if (lag != p->lag)
+		ubr_lag_port_publish(p, lag, lags);
+
+	if (attrs[UBR_NLA_PORT_VID_XLATE])
+		ubr_vlan_xlate_publish(p, xlate);
+
+	if (flood)
+		ubr_vlan_flood_update(ubr);
+
+	ubr_learn_limit_publish(&p->learn, &learn);
+
+	for (class = 0; class < UBR_STORM_MAX; class++) {
+		if (attrs[ubr_storm_attrs[class]])
+			ubr_storm_publish(p, class, storm[class]);
+	}
 
 	dev_put(dev);
+	return 0;
 
-	p = &ubr->ports[pidx];
-	p->pvid = pvid;
+err_police:
+	for (class = 0; class < UBR_STORM_MAX; class++)
+		ubr_police_free(storm[class]);
+	ubr_police_free(learn.rate);
+err_xlate:
+	if (attrs[UBR_NLA_PORT_VID_XLATE])
+		ubr_vlan_xlate_free(p, xlate);
+err_lags:
+	kfree(lags);
+out:
+	dev_put(dev);
+	return err;
+}
 
-	cb = &p->ingress_cb;
-	cb->vlan = ubr_vlan_find(ubr, pvid);
+static void __port_stats_read(struct ubr_port *p, struct ubr_port_stats *sum)
+{
+	unsigned int start;
+	int cpu, i;
+
+	memset(sum, 0, sizeof(*sum));
+
+	for_each_possible_cpu(cpu) {
+		struct ubr_port_stats *stats = per_cpu_ptr(p->stats, cpu);
+		u64 storm_drops[UBR_STORM_MAX];
+		u64 learn_overflows, learn_pool_empty, replication_drops;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			for (i = 0; i < UBR_STORM_MAX; i++)
+				storm_drops[i] = u64_stats_read(&stats->storm_drops[i]);
+			learn_overflows = u64_stats_read(&stats->learn_overflows);
+			learn_pool_empty = u64_stats_read(&stats->learn_pool_empty);
+			replication_drops = u64_stats_read(&stats->replication_drops);
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		for (i = 0; i < UBR_STORM_MAX; i++)
+			u64_stats_add(&sum->storm_drops[i], storm_drops[i]);
+		u64_stats_add(&sum->learn_overflows, learn_overflows);
+		u64_stats_add(&sum->learn_pool_empty, learn_pool_empty);
+		u64_stats_add(&sum->replication_drops, replication_drops);
+	}
+}
 
-	cb->vlan_filtering = !!pvid;
+static int __put_port_stats(struct sk_buff *msg, struct ubr_port *p)
+{
+	struct ubr_port_stats sum;
+	struct nlattr *stats;
+
+	__port_stats_read(p, &sum);
+
+	stats = nla_nest_start(msg, UBR_NLA_PORT_STATS);
+	if (!stats)
+		return -EMSGSIZE;
+
+	if (nla_put_u64_64bit(msg, UBR_NLA_PORT_STATS_STORM_UC_DROPS,
+			      u64_stats_read(&sum.storm_drops[UBR_STORM_UC]),
+			      UBR_NLA_PORT_STATS_PAD) ||
+	    nla_put_u64_64bit(msg, UBR_NLA_PORT_STATS_STORM_MC_DROPS,
+			      u64_stats_read(&sum.storm_drops[UBR_STORM_MC]),
+			      UBR_NLA_PORT_STATS_PAD) ||
+	    nla_put_u64_64bit(msg, UBR_NLA_PORT_STATS_STORM_BC_DROPS,
+			      u64_stats_read(&sum.storm_drops[UBR_STORM_BC]),
+			      UBR_NLA_PORT_STATS_PAD) ||
+	    nla_put_u64_64bit(msg, UBR_NLA_PORT_STATS_LEARNED,
+			      percpu_counter_sum_positive(&p->learn.count),
+			      UBR_NLA_PORT_STATS_PAD) ||
+	    nla_put_u64_64bit(msg, UBR_NLA_PORT_STATS_LEARN_OVERFLOWS,
+			      u64_stats_read(&sum.learn_overflows),
+			      UBR_NLA_PORT_STATS_PAD) ||
+	    nla_put_u64_64bit(msg, UBR_NLA_PORT_STATS_LEARN_POOL_EMPTY,
+			      u64_stats_read(&sum.learn_pool_empty),
+			      UBR_NLA_PORT_STATS_PAD) ||
+	    nla_put_u64_64bit(msg, UBR_NLA_PORT_STATS_REPLICATION_DROPS,
+			      u64_stats_read(&sum.replication_drops),
+			      UBR_NLA_PORT_STATS_PAD))
+		return -EMSGSIZE;
+
+	nla_nest_end(msg, stats);
 	return 0;
-err:
+}
+
+int ubr_port_nl_get_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *attrs[UBR_NLA_PORT_MAX + 1];
+	struct net_device *dev;
+	struct nlattr *nest;
+	struct sk_buff *msg;
+	struct ubr_port *p;
+	struct ubr *ubr;
+	void *hdr;
+	u32 ifindex;
+	int pidx;
+	int err;
+
+	err = __get_port(info, attrs, &ifindex);
+	if (err)
+		return err;
+
+	dev = ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+
+	pidx = ubr_port_find_by_ifindex(ubr, genl_info_net(info), ifindex);
+	if (pidx < 0) {
+		err = pidx;
+		goto out;
+	}
+
+	p = &ubr->ports[pidx];
+
+	msg = nlmsg_new(NLMSG_DEFAULT_SIZE, GFP_KERNEL);
+	if (!msg) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	err = -EMSGSIZE;
+	hdr = ubr_netlink_put_reply(msg, info);
+	if (!hdr)
+		goto err_free;
+
+	nest = nla_nest_start(msg, UBR_NLA_PORT);
+	if (!nest)
+		goto err_free;
+
+	if (nla_put_u32(msg, UBR_NLA_PORT_IFINDEX, ifindex) ||
+	    nla_put_u16(msg, UBR_NLA_PORT_PVID, p->pvid) ||
+	    nla_put_u32(msg, UBR_NLA_PORT_LEARNING, p->ingress_cb.sa_learning) ||
+	    nla_put_u32(msg, UBR_NLA_PORT_LAG, p->lag) ||
+	    nla_put_u32(msg, UBR_NLA_PORT_OFFLOAD, ubr_port_offloaded(p)))
+		goto err_free;
+
+	err = __put_port_stats(msg, p);
+	if (err)
+		goto err_free;
+
+	nla_nest_end(msg, nest);
+	genlmsg_end(msg, hdr);
+
+	dev_put(dev);
+	return genlmsg_reply(msg, info);
+
+err_free:
+	nlmsg_free(msg);
+out:
 	dev_put(dev);
-	return -EINVAL;
+	return err;
 }
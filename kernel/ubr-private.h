@@ -2,10 +2,24 @@
 #define __UBR_PRIVATE_H
 
 #include <linux/bitmap.h>
+#include <linux/if_vlan.h>
+#include <linux/jump_label.h>
+#include <linux/llist.h>
+#include <linux/mutex.h>
+#include <linux/percpu_counter.h>
 #include <linux/slab.h>
+#include <linux/u64_stats_sync.h>
 
 #include <net/rtnetlink.h>
 #include <net/genetlink.h>
+#include <net/sch_generic.h>
+#include <net/gro_cells.h>
+
+#if IS_ENABLED(CONFIG_VXLAN)
+#include <net/dst_metadata.h>
+
+struct ubr_tunnel_remotes;
+#endif
 
 /* TODO move to linux/netdevice.h */
 #define IFF_UBR_PORT (1 << 31)
@@ -31,6 +45,15 @@ struct ubr_vec {
 #define ubr_vec_or(_vd, _vs) \
 	__ubr_vec_bitmap_op(or, (_vd)->bitmap, (_vd)->bitmap, (_vs)->bitmap)
 
+#define ubr_vec_andnot(_vd, _vs) \
+	__ubr_vec_bitmap_op(andnot, (_vd)->bitmap, (_vd)->bitmap, (_vs)->bitmap)
+
+#define ubr_vec_intersects(_va, _vb) \
+	__ubr_vec_bitmap_op(intersects, (_va)->bitmap, (_vb)->bitmap)
+
+#define ubr_vec_empty(_v) \
+	__ubr_vec_bitmap_op(empty, (_v)->bitmap)
+
 #define ubr_vec_zero(_v) \
 	__ubr_vec_bitmap_op(zero, (_v)->bitmap)
 
@@ -56,12 +79,47 @@ struct ubr_cb {
 
 	u32 ctrl:1;
 
+	/* VLAN tag is still in the payload, see ubr_vlan_ingress() */
+	u32 vlan_inline:1;
+
+	/* Received from an overlay, see ubr-tunnel.c */
+	u32 tunnel:1;
+
+	/* Variant of ubr_forward() run for the port */
+	u32 pipeline:2;
+
+	/* Port that learned addresses are put on, differs from pidx
+	 * only for LAG members, see ubr-lag.c
+	 */
+	u32 lpidx:UBR_MAX_PORTS_SHIFT;
+
 	struct ubr_vlan *vlan;
 
 	struct ubr_vec vec;
 };
 #define ubr_cb(_skb) ((struct ubr_cb *)(_skb)->cb)
 
+/* Ingress pipelines, each built without the stages it does not need */
+enum ubr_pipeline {
+	UBR_PIPELINE_HUB,	/* No VLAN filtering, no learning */
+	UBR_PIPELINE_LEARN,	/* Learning, no VLAN filtering */
+	UBR_PIPELINE_TRUNK,	/* VLAN filtering, no learning */
+	UBR_PIPELINE_VLAN,	/* VLAN filtering and learning */
+};
+
+/* Called whenever the stages of a port's ingress_cb change.  Frames
+ * from an overlay are always classified, by VNI.
+ */
+static inline void ubr_pipeline_update(struct ubr_cb *cb)
+{
+	bool vlan = cb->vlan_filtering || cb->tunnel;
+
+	if (cb->sa_learning)
+		cb->pipeline = vlan ? UBR_PIPELINE_VLAN : UBR_PIPELINE_LEARN;
+	else
+		cb->pipeline = vlan ? UBR_PIPELINE_TRUNK : UBR_PIPELINE_HUB;
+}
+
 /* enum ubr_stp_state { */
 /* 	UBR_STP_BLOCKING, */
 /* #define	UBR_STP_LISTENING UBR_STP_BLOCKING */
@@ -99,9 +157,12 @@ enum ubr_addr_type {
 	UBR_ADDR_IP6,
 };
 
+/* Addresses are kept per filtering database (FID), which is shared
+ * by all VLANs mapped to it.  FIDs have the same range as VIDs.
+ */
 struct ubr_fdb_addr {
 	u32 type:3;
-	u32 vid:16;
+	u32 fid:12;
 
 	union {
 		u8 mac[ETH_ALEN];
@@ -126,29 +187,206 @@ struct ubr_fdb_node {
 
 	u32 proto:8;
 	u32 offloaded:1;
+	/* VLAN the entry was learned or added on, for accounting */
+	u32 vid:12;
 
 	/* TODO on separate cache line like bridge? */
 	unsigned long tstamp;
 
-	struct rcu_head rcu;
+#if IS_ENABLED(CONFIG_VXLAN)
+	/* Tunnel endpoint of an entry behind a tunnel port */
+	struct metadata_dst __rcu *remote;
+#endif
+
+	union {
+		struct rcu_head rcu;
+		/* Linkage while in the pool, or in a recycle batch */
+		struct llist_node free;
+	};
+};
+
+/*
+ * Per-CPU cache of free FDB nodes, lets learning in softirq run
+ * without calling into the slab allocator.  Only the owning CPU
+ * takes nodes off the list, anyone may put them back.
+ */
+struct ubr_fdb_pool_pcpu {
+	struct llist_head free;
+	atomic_t avail;
+};
+
+struct ubr_fdb_pool {
+	unsigned int size;	/* Per-CPU capacity */
+	struct ubr_fdb_pool_pcpu __percpu *pcpu;
+	struct work_struct refill_work;
 };
 
 struct ubr_fdb {
 	struct rhashtable nodes;
 	unsigned long ageing_timeout;
 	struct delayed_work age_work;
+
+	struct ubr_fdb_pool pool;
 };
 
+static inline bool ubr_fdb_node_is_old(struct ubr_fdb *fdb,
+				       struct ubr_fdb_node *node)
+{
+	return (node->proto == UBR_FDB_DYNAMIC) &&
+		time_is_before_jiffies(node->tstamp + fdb->ageing_timeout);
+}
+
+/*
+ * IP to MAC binding within a VLAN, snooped from ARP and ND or added
+ * by the controller, see ubr-neigh.c.  Proto is UBR_FDB_DYNAMIC for
+ * snooped entries and UBR_FDB_USER for the rest.
+ */
+struct ubr_neigh_key {
+	u16 vid;
+	u16 family;
+
+	union {
+		__be32 ip4;
+#if IS_ENABLED(CONFIG_IPV6)
+		struct in6_addr ip6;
+#endif
+	};
+};
+
+struct ubr_neigh_node {
+	struct rhash_head rhnode;
+
+	struct ubr_neigh_key key;
+	u8 lladdr[ETH_ALEN];
+	u8 proto;
+
+	unsigned long tstamp;
+	struct rcu_head rcu;
+};
+
+struct ubr_neigh {
+	struct rhashtable nodes;
+	/* Snooped entries, bounded by UBR_NEIGH_MAX */
+	atomic_t count;
+	struct delayed_work gc_work;
+};
+
+/*
+ * Bounds the number of dynamically learned FDB entries, and the rate
+ * at which new ones are learned, for a port or a VLAN.  Action is one
+ * of the UBR_LEARN_LIMIT_* values from ubr-netlink.h.
+ */
+struct ubr_learn_limit {
+	u32 max;
+	u32 action;
+	u32 disabled;
+	struct ubr_police __rcu *rate;
+
+	struct percpu_counter count;
+};
+
+/* A validated and allocated change of a learning limit, applied by
+ * ubr_learn_limit_publish() if set.
+ */
+struct ubr_learn_limit_cfg {
+	bool set;
+	u32 max;
+	u32 action;
+	struct ubr_police *rate;
+};
+
+/*
+ * VLAN port membership.  Never modified in place, updates are done by
+ * publishing a new copy, so the data path always sees members and
+ * tagged from the same configuration.
+ */
+struct ubr_vlan_ports {
+	struct ubr_vec members;
+	struct ubr_vec tagged;
+
+	struct rcu_head rcu;
+};
+
+struct ubr_vid_pair {
+	u16 from;
+	u16 to;
+};
+
+/*
+ * Per-port VID translation, num pairs mapping port VIDs to bridge
+ * VIDs sorted by port VID, followed by the same num pairs reversed,
+ * sorted by bridge VID.  Like the VLAN membership it is replaced,
+ * never modified in place.
+ */
+struct ubr_vid_xlate {
+	struct rcu_head rcu;
+	unsigned int num;
+
+	struct ubr_vid_pair pairs[];
+};
+
+/* Returns what from maps to, 0 if it is not translated */
+static inline u16 ubr_vid_pairs_find(const struct ubr_vid_pair *pairs,
+				     unsigned int num, u16 from)
+{
+	unsigned int lo = 0, hi = num, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (pairs[mid].from == from)
+			return pairs[mid].to;
+
+		if (pairs[mid].from < from)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return 0;
+}
+
+/* Port VID to bridge VID */
+static inline u16 ubr_vid_xlate_ingress(const struct ubr_vid_xlate *xlate,
+					u16 vid)
+{
+	return ubr_vid_pairs_find(xlate->pairs, xlate->num, vid);
+}
+
+/* Bridge VID to port VID */
+static inline u16 ubr_vid_xlate_egress(const struct ubr_vid_xlate *xlate,
+				       u16 bvid)
+{
+	return ubr_vid_pairs_find(xlate->pairs + xlate->num, xlate->num, bvid);
+}
+
 struct ubr_vlan {
 	struct ubr *ubr;
 	struct hlist_node node;
 	u16 vid;
+	/* Filtering database, read locklessly by the data path */
+	u16 fid;
 
 	unsigned sa_learning:1;
+	unsigned ucflood_on:1;
+	unsigned mcflood_on:1;
+	unsigned bcflood_on:1;
+	/* Answer ARP/ND for known targets by directed delivery */
+	unsigned neigh_suppress:1;
+
+#if IS_ENABLED(CONFIG_VXLAN)
+	/* Overlay segment, 0 if none, see ubr-tunnel.c */
+	u32 vni;
+	struct hlist_node vni_node;
+	struct ubr_tunnel_remotes __rcu *remotes;
+#endif
 
-	struct ubr_vec members;
-	struct ubr_vec tagged;
+	struct ubr_vlan_ports __rcu *ports;
 
+	struct ubr_learn_limit learn;
+
+	/* Effective flood vectors, i.e. ubr->*flood when the VLAN
+	 * floods the class in question, otherwise empty.
+	 */
 	struct ubr_vec mcflood;
 	struct ubr_vec bcflood;
 	struct ubr_vec ucflood;
@@ -158,17 +396,96 @@ struct ubr_vlan {
 	struct rcu_head rcu;
 };
 
+/* Per-CPU token bucket, rate is either in bytes or packets per second */
+struct ubr_police_pcpu {
+	s64 tokens;
+	u64 stamp;
+};
+
+struct ubr_police {
+	u32 pps:1;
+	u64 rate;
+
+	struct psched_ratecfg bps_cfg;
+	struct psched_pktrate pps_cfg;
+	s64 burst;
+
+	struct ubr_police_pcpu __percpu *pcpu;
+	struct rcu_head rcu;
+};
+
+enum ubr_storm_class {
+	UBR_STORM_UC,
+	UBR_STORM_MC,
+	UBR_STORM_BC,
+
+	UBR_STORM_MAX
+};
+
+struct ubr_port_stats {
+	u64_stats_t storm_drops[UBR_STORM_MAX];
+	u64_stats_t learn_overflows;
+	u64_stats_t learn_pool_empty;
+	/* Frames from the port not sent everywhere, a copy failed */
+	u64_stats_t replication_drops;
+
+	struct u64_stats_sync syncp;
+};
+
 /*
  * Note: While PVID is a VLAN which does not (yet) exist in the bridge,
  *       the ingress.cb->vlan is NULL.  This is a poor mans filtering
  *       for VLAN trunk ports.  When the VLAN is added, or removed, all
  *       ports with a PVID matching that VLAN must be updated.
  */
+#define UBR_MAX_LAGS      32
+#define UBR_LAG_MAX_PORTS 16
+
+struct ubr_lag {
+	struct ubr_vec members;
+
+	/* Members with link up, egress picks one by flow hash */
+	u8 num_tx;
+	u8 tx[UBR_LAG_MAX_PORTS];
+};
+
+/* Immutable once published, replaced as a whole on any change */
+struct ubr_lags {
+	/* Members of all groups */
+	struct ubr_vec ports;
+
+	unsigned num;
+	struct ubr_lag lag[UBR_MAX_LAGS];
+
+	struct rcu_head rcu;
+};
+
 struct ubr_port {
 	struct net_device *dev;
 	struct ubr_cb ingress_cb;
 	u16 pvid;
 
+	/* Link aggregation group, 0 if none */
+	u8 lag;
+
+	/* VID translation, NULL if none */
+	struct ubr_vid_xlate __rcu *xlate;
+
+#if IS_ENABLED(CONFIG_NET_SWITCHDEV)
+	/* Parent switch ID, and the ports below that same switch,
+	 * including this one.  Empty when not offloaded.
+	 */
+	struct netdev_phys_item_id ppid;
+	struct ubr_vec hwdom;
+#endif
+
+	/* Flood policers, applied on ingress */
+	struct ubr_police __rcu *storm[UBR_STORM_MAX];
+
+	struct ubr_learn_limit learn;
+
+	struct ubr_port_stats __percpu *stats;
+
 	struct rcu_head rcu;
 };
 
@@ -185,26 +502,106 @@ static inline struct ubr_port *ubr_port_get_rtnl(const struct net_device *dev)
 struct ubr {
 	struct net_device *dev;
 
+	/* Serialises configuration of this bridge, the data path only
+	 * sees state published with RCU.  Ports are added and removed
+	 * holding both rtnl and cfg_lock, so either protects them.
+	 */
+	struct mutex cfg_lock;
+	bool dead;
+
+	/* Ports with link, the only ones egress is attempted on */
 	struct ubr_vec active;
+
+	/* Ports that cannot keep a tag in hwaccel metadata on tagged
+	 * egress, cached from the device features by
+	 * ubr_port_update_offloads().
+	 */
+	struct ubr_vec sw_tagging;
 	u16 vlan_proto;
 
+	/* Ports leading into an overlay, see ubr-tunnel.c */
+	struct ubr_vec tunnels;
+
+	/* Ports that accept flooded unknown unicast/multicast/broadcast */
+	struct ubr_vec ucflood;
+	struct ubr_vec mcflood;
+	struct ubr_vec bcflood;
+
 	DECLARE_HASHTABLE(vlans, 8);
 	DECLARE_HASHTABLE(stps, 8);
+#if IS_ENABLED(CONFIG_VXLAN)
+	DECLARE_HASHTABLE(vnis, 8);
+#endif
 
 	struct ubr_fdb fdb;
+	struct ubr_neigh neigh;
+
+	struct ubr_lags __rcu *lags;
+
+	/* Host-bound frames, received via GRO, see ubr_deliver_up() */
+	struct gro_cells gro_cells;
+
+	/* Per-CPU flow cache, NULL if disabled, see ubr-flow.c.  Only
+	 * entries of the current generation are valid.  64 bits, so the
+	 * generation of a stale entry never comes around again.
+	 */
+	struct ubr_flow_cache __rcu *flows;
+	atomic64_t flow_gen;
 
 	struct ubr_vec  busy;
+	/* Removed ports whose slot is freed after a grace period, and
+	 * must not be reused until then, see ubr_port_cleanup().
+	 */
+	struct ubr_vec  dying;
 	struct ubr_port ports[UBR_MAX_PORTS];
 };
 #define ubr_from_port(_port) \
 	container_of((_port), struct ubr, ports[(_port)->ingress_cb.pidx])
+#define ubr_from_fdb(_fdb) \
+	container_of((_fdb), struct ubr, fdb)
+#define ubr_from_neigh(_neigh) \
+	container_of((_neigh), struct ubr, neigh)
+
+/* Symbols used by the KUnit suite in ubr-test.ko */
+#if IS_ENABLED(CONFIG_KUNIT)
+#define UBR_EXPORT_FOR_TEST(_sym) EXPORT_SYMBOL_GPL(_sym)
+#else
+#define UBR_EXPORT_FOR_TEST(_sym)
+#endif
+
+#define ubr_port_stats_inc(_p, _field) do {				\
+	struct ubr_port_stats *__stats = this_cpu_ptr((_p)->stats);	\
+									\
+	u64_stats_update_begin(&__stats->syncp);			\
+	u64_stats_inc(&__stats->_field);				\
+	u64_stats_update_end(&__stats->syncp);				\
+} while (0)
 
 
 /* ubr-dev.c */
 void ubr_update_headroom(struct ubr *ubr, struct net_device *new_dev);
+void ubr_update_features(struct ubr *ubr);
+
+int ubr_dev_nl_set_cmd(struct sk_buff *skb, struct genl_info *info);
 
 /* ubr-fdb.c */
+DECLARE_STATIC_KEY_FALSE(ubr_fdb_mc_groups);
+
+bool __ubr_fdb_forward(struct ubr_fdb *fdb, struct sk_buff *skb);
 bool ubr_fdb_forward(struct ubr_fdb *fdb, struct sk_buff *skb);
+const struct ubr_vec *ubr_fdb_lookup_mac(struct ubr_fdb *fdb, u16 fid,
+					 const u8 *mac);
+
+int  ubr_fdb_flush(struct ubr_fdb *fdb, struct ubr_fdb_flush_op op);
+int  ubr_fdb_pool_resize(struct ubr_fdb *fdb, unsigned int size);
+
+int  ubr_learn_limit_init(struct ubr_learn_limit *ll);
+void ubr_learn_limit_destroy(struct ubr_learn_limit *ll);
+int  ubr_learn_limit_nl_build(struct ubr_learn_limit *ll, struct nlattr *max,
+			      struct nlattr *rate, struct nlattr *action,
+			      struct ubr_learn_limit_cfg *cfg);
+void ubr_learn_limit_publish(struct ubr_learn_limit *ll,
+			     struct ubr_learn_limit_cfg *cfg);
 
 int  ubr_fdb_newlink(struct ubr_fdb *fdb);
 void ubr_fdb_dellink(struct ubr_fdb *fdb);
@@ -212,33 +609,267 @@ void ubr_fdb_dellink(struct ubr_fdb *fdb);
 int __init ubr_fdb_cache_init(void);
 void       ubr_fdb_cache_fini(void);
 
+int  ubr_fdb_external_add(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+			  const u8 *mac, unsigned pidx);
+void ubr_fdb_external_del(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+			  const u8 *mac);
+void ubr_fdb_offloaded_set(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+			   const u8 *mac);
+
+#if IS_ENABLED(CONFIG_VXLAN)
+int  ubr_fdb_remote_add(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+			const u8 *mac, unsigned pidx, struct metadata_dst *md);
+int  ubr_fdb_remote_del(struct ubr_fdb *fdb, struct ubr_vlan *vlan,
+			const u8 *mac);
+#endif
+
+bool ubr_fdb_flow_nodes(struct ubr_fdb *fdb, struct sk_buff *skb,
+			struct ubr_fdb_node **sa, struct ubr_fdb_node **da);
+
 int ubr_fdb_nl_flush_cmd(struct sk_buff *skb, struct genl_info *info);
+int ubr_fdb_nl_set_cmd(struct sk_buff *skb, struct genl_info *info);
+
+/* ubr-flow.c */
+#define UBR_FLOW_CACHE_MAX 65536
+
+DECLARE_STATIC_KEY_FALSE(ubr_flow_used);
+
+struct ubr_flow_key {
+	union {
+		struct {
+			u8  addr[2 * ETH_ALEN];	/* DA, SA */
+			u16 vid;		/* As received, 0 if untagged */
+			u16 pidx;
+		};
+		u64 w[2];
+	};
+};
+
+/* Carried from the lookup to the insertion of a frame that missed */
+struct ubr_flow_ctx {
+	struct ubr_flow_cache *cache;	/* NULL if not cacheable */
+	struct ubr_flow_key key;
+	u64 gen;
+};
+
+int  ubr_flow_cache_set(struct ubr *ubr, u32 size);
+bool __ubr_flow_hit(struct ubr *ubr, struct sk_buff *skb,
+		    struct ubr_flow_ctx *ctx);
+void __ubr_flow_insert(struct ubr *ubr, struct sk_buff *skb,
+		       struct ubr_flow_ctx *ctx);
+
+/* Invalidate all cached decisions, after any change that may affect
+ * forwarding has been published.
+ */
+static inline void ubr_flow_flush(struct ubr *ubr)
+{
+	if (rcu_access_pointer(ubr->flows))
+		atomic64_inc(&ubr->flow_gen);
+}
+
+/* Returns true if skb is ready for ubr_deliver() */
+static inline bool ubr_flow_hit(struct ubr *ubr, struct sk_buff *skb,
+				struct ubr_flow_ctx *ctx)
+{
+	if (!static_branch_unlikely(&ubr_flow_used)) {
+		ctx->cache = NULL;
+		return false;
+	}
+
+	ctx->cache = rcu_dereference(ubr->flows);
+	if (likely(!ctx->cache))
+		return false;
+
+	return __ubr_flow_hit(ubr, skb, ctx);
+}
+
+static inline void ubr_flow_insert(struct ubr *ubr, struct sk_buff *skb,
+				   struct ubr_flow_ctx *ctx)
+{
+	if (unlikely(ctx->cache))
+		__ubr_flow_insert(ubr, skb, ctx);
+}
 
 /* ubr-forward.c */
-bool ubr_forward(struct ubr *ubr, struct sk_buff *skb);
+struct sk_buff *ubr_forward(struct ubr *ubr, struct sk_buff *skb);
+
+/* ubr-lag.c */
+void ubr_lag_egress(const struct ubr_lags *lags, struct sk_buff *skb);
+int  ubr_lag_update(struct ubr *ubr);
+struct ubr_lags *ubr_lag_port_build(struct ubr_port *p, u32 id);
+void ubr_lag_port_publish(struct ubr_port *p, u32 id, struct ubr_lags *lags);
+int  ubr_lag_port_set(struct ubr_port *p, u32 id);
+
+/* ubr-neigh.c */
+DECLARE_STATIC_KEY_FALSE(ubr_neigh_suppress_used);
+
+bool __ubr_neigh_ingress(struct ubr *ubr, struct sk_buff *skb);
+
+static inline bool ubr_neigh_ingress(struct ubr *ubr, struct sk_buff *skb)
+{
+	if (!static_branch_unlikely(&ubr_neigh_suppress_used))
+		return true;
+
+	return __ubr_neigh_ingress(ubr, skb);
+}
+
+void ubr_neigh_flush(struct ubr_neigh *neigh, struct ubr_vlan *vlan);
+
+int  ubr_neigh_newlink(struct ubr_neigh *neigh);
+void ubr_neigh_dellink(struct ubr_neigh *neigh);
+
+int ubr_neigh_nl_add_cmd(struct sk_buff *skb, struct genl_info *info);
+int ubr_neigh_nl_del_cmd(struct sk_buff *skb, struct genl_info *info);
 
 /* ubr-netlink.c */
 int ubr_netlink_init(const struct net_device_ops *ops);
 int ubr_netlink_exit(void);
 
 struct net_device *ubr_netlink_dev(struct genl_info *info);
+void *ubr_netlink_put_reply(struct sk_buff *msg, struct genl_info *info);
+
+/* ubr-police.c */
+struct ubr_police *ubr_police_new(u64 rate, bool pps);
+void ubr_police_free(struct ubr_police *pol);
+bool ubr_police_allow(struct ubr_police *pol, unsigned int len);
+
+bool ubr_storm_allow(struct ubr_port *p, struct sk_buff *skb,
+		     enum ubr_storm_class class);
+void ubr_storm_publish(struct ubr_port *p, enum ubr_storm_class class,
+		       struct ubr_police *pol);
 
 /* ubr-port.c */
 struct ubr_port *ubr_port_init(struct ubr *ubr, unsigned idx, struct net_device *dev);
+void ubr_port_cleanup(struct ubr_port *p);
+void ubr_port_update_offloads(struct ubr_port *p);
+void ubr_port_link_update(struct ubr_port *p);
 
 int ubr_port_add(struct ubr *ubr, struct net_device *dev,
 		 struct netlink_ext_ack *extack);
 int ubr_port_del(struct ubr *ubr, struct net_device *dev);
 
 int ubr_port_find(struct ubr *ubr, struct net_device *dev);
+int ubr_port_find_by_ifindex(struct ubr *ubr, struct net *net, u32 ifindex);
 
 int ubr_port_nl_set_cmd(struct sk_buff *skb, struct genl_info *info);
+int ubr_port_nl_get_cmd(struct sk_buff *skb, struct genl_info *info);
+
+/* ubr-switchdev.c */
+#if IS_ENABLED(CONFIG_NET_SWITCHDEV)
+static inline bool ubr_port_offloaded(const struct ubr_port *p)
+{
+	return p->ppid.id_len;
+}
+
+/* Hardware already forwarded the frame within the ingress port's domain */
+static inline void ubr_switchdev_egress(struct ubr *ubr, struct sk_buff *skb)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+
+	if (skb->offload_fwd_mark)
+		ubr_vec_andnot(&cb->vec, &ubr->ports[cb->pidx].hwdom);
+}
+
+int  ubr_switchdev_port_init(struct ubr_port *p);
+void ubr_switchdev_port_fini(struct ubr_port *p);
+int  ubr_switchdev_port_flags(struct ubr_port *p, bool learning);
+void ubr_switchdev_port_pvid(struct ubr_port *p, u16 old);
+
+void ubr_switchdev_vlan(struct ubr *ubr, u16 vid,
+			const struct ubr_vec *untagged,
+			const struct ubr_vec *tagged, bool add);
+void ubr_switchdev_fdb_notify(struct ubr *ubr, const struct ubr_fdb_node *node,
+			      bool add);
+
+int __init ubr_switchdev_init(void);
+void       ubr_switchdev_fini(void);
+#else
+static inline bool ubr_port_offloaded(const struct ubr_port *p) { return false; }
+static inline void ubr_switchdev_egress(struct ubr *ubr, struct sk_buff *skb) {}
+
+static inline int  ubr_switchdev_port_init(struct ubr_port *p) { return 0; }
+static inline void ubr_switchdev_port_fini(struct ubr_port *p) {}
+static inline int  ubr_switchdev_port_flags(struct ubr_port *p, bool learning) { return 0; }
+static inline void ubr_switchdev_port_pvid(struct ubr_port *p, u16 old) {}
+
+static inline void ubr_switchdev_vlan(struct ubr *ubr, u16 vid,
+				      const struct ubr_vec *untagged,
+				      const struct ubr_vec *tagged, bool add) {}
+static inline void ubr_switchdev_fdb_notify(struct ubr *ubr,
+					    const struct ubr_fdb_node *node,
+					    bool add) {}
+
+static inline int  ubr_switchdev_init(void) { return 0; }
+static inline void ubr_switchdev_fini(void) {}
+#endif
+
+/* ubr-tunnel.c */
+#if IS_ENABLED(CONFIG_VXLAN)
+static inline bool ubr_fdb_node_is_remote(const struct ubr_fdb_node *node)
+{
+	return rcu_access_pointer(node->remote);
+}
+
+/* Only once no one can see the node anymore */
+static inline void ubr_fdb_node_remote_put(struct ubr_fdb_node *node)
+{
+	struct metadata_dst *md = rcu_dereference_protected(node->remote, 1);
+
+	if (md)
+		dst_release(&md->dst);
+}
+
+struct ubr_vlan *ubr_tunnel_vlan_find(struct ubr *ubr, u32 vni);
+bool ubr_tunnel_ingress(struct ubr *ubr, struct sk_buff *skb);
+void ubr_tunnel_learn(struct ubr_fdb_node *node, struct sk_buff *skb);
+void ubr_tunnel_fdb_forward(struct sk_buff *skb,
+			    const struct ubr_fdb_node *node);
+void ubr_tunnel_xmit(struct ubr *ubr, struct sk_buff *skb);
+
+int  ubr_tunnel_vni_set(struct ubr_vlan *vlan, u32 vni);
+void ubr_tunnel_vlan_fini(struct ubr_vlan *vlan);
+void ubr_tunnel_port_init(struct ubr_port *p);
+
+int ubr_tunnel_nl_add_cmd(struct sk_buff *skb, struct genl_info *info);
+int ubr_tunnel_nl_del_cmd(struct sk_buff *skb, struct genl_info *info);
+#else
+static inline bool ubr_fdb_node_is_remote(const struct ubr_fdb_node *node) { return false; }
+static inline void ubr_fdb_node_remote_put(struct ubr_fdb_node *node) {}
+
+static inline bool ubr_tunnel_ingress(struct ubr *ubr, struct sk_buff *skb) { return false; }
+static inline void ubr_tunnel_learn(struct ubr_fdb_node *node, struct sk_buff *skb) {}
+static inline void ubr_tunnel_fdb_forward(struct sk_buff *skb,
+					  const struct ubr_fdb_node *node) {}
+static inline void ubr_tunnel_xmit(struct ubr *ubr, struct sk_buff *skb) { kfree_skb(skb); }
+
+static inline int  ubr_tunnel_vni_set(struct ubr_vlan *vlan, u32 vni) { return -EOPNOTSUPP; }
+static inline void ubr_tunnel_vlan_fini(struct ubr_vlan *vlan) {}
+static inline void ubr_tunnel_port_init(struct ubr_port *p) {}
+#endif
 
 /* ubr-vlan.c */
-bool ubr_vlan_ingress(struct ubr *ubr, struct sk_buff *skb);
+DECLARE_STATIC_KEY_FALSE(ubr_vlan_xlate_used);
+
+struct sk_buff *ubr_vlan_ingress(struct ubr *ubr, struct sk_buff *skb,
+				 bool *allow);
+int  ubr_vlan_proto_set(struct ubr *ubr, u16 proto);
+int  ubr_vlan_fid_set(struct ubr_vlan *vlan, u16 fid);
+void ubr_vlan_neigh_suppress_set(struct ubr_vlan *vlan, bool on);
+
+bool ubr_vlan_xlate_egress(struct ubr *ubr, struct sk_buff *skb, unsigned pidx);
+struct ubr_vid_xlate *ubr_vlan_xlate_build(struct ubr_port *p, u16 vid,
+					   u16 bvid);
+void ubr_vlan_xlate_free(struct ubr_port *p, struct ubr_vid_xlate *new);
+void ubr_vlan_xlate_publish(struct ubr_port *p, struct ubr_vid_xlate *new);
+int  ubr_vlan_xlate_set(struct ubr_port *p, u16 vid, u16 bvid);
 
 int ubr_vlan_port_add(struct ubr_vlan *vlan, unsigned idx, bool tagged);
 int ubr_vlan_port_del(struct ubr_vlan *vlan, unsigned idx);
+int ubr_vlan_ports_update(struct ubr *ubr, u16 vid, u16 vid_end,
+			  const struct ubr_vec *untagged,
+			  const struct ubr_vec *tagged, bool add);
+
+void ubr_vlan_flood_update(struct ubr *ubr);
 
 struct ubr_vlan *ubr_vlan_find(struct ubr *ubr, u16 vid);
 int              ubr_vlan_del (struct ubr_vlan *vlan);
@@ -254,4 +885,7 @@ int ubr_vlan_nl_set_cmd(struct sk_buff *skb, struct genl_info *info);
 int ubr_vlan_nl_attach_cmd(struct sk_buff *skb, struct genl_info *info);
 int ubr_vlan_nl_detach_cmd(struct sk_buff *skb, struct genl_info *info);
 
+int ubr_vlan_nl_bulk_attach_cmd(struct sk_buff *skb, struct genl_info *info);
+int ubr_vlan_nl_bulk_detach_cmd(struct sk_buff *skb, struct genl_info *info);
+
 #endif	/* __UBR_PRIVATE_H */
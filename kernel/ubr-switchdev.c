@@ -0,0 +1,389 @@
+#include <linux/if_bridge.h>
+#include <linux/netdevice.h>
+#include <linux/workqueue.h>
+
+#include <net/switchdev.h>
+
+#include "ubr-private.h"
+
+/*
+ * Switchdev offload.  Ports with the same parent ID, i.e. below the
+ * same switch ASIC, form a hardware domain.  Their VLAN membership,
+ * flooding and learning settings, and the FDB, are mirrored to the
+ * hardware, which then forwards between them on its own.  Frames it
+ * already forwarded carry skb->offload_fwd_mark, software does not
+ * send those again to ports in the ingress port's domain.  Addresses
+ * learned by the hardware are added as UBR_FDB_EXTERNAL entries.
+ *
+ * A port driver without switchdev support returns -EOPNOTSUPP, which
+ * is not an error, everything then stays in software.
+ */
+
+#define UBR_SWITCHDEV_FLAGS \
+	(BR_LEARNING | BR_FLOOD | BR_MCAST_FLOOD | BR_BCAST_FLOOD)
+
+/* Ordered, so an address's events are applied in the order sent */
+static struct workqueue_struct *ubr_switchdev_wq;
+
+/* Hardware learned addresses, handled in process context */
+struct ubr_switchdev_work {
+	struct work_struct work;
+	struct net_device *dev;
+	unsigned long event;
+
+	u8 addr[ETH_ALEN];
+	u16 vid;
+};
+
+static int ubr_switchdev_err(int err)
+{
+	return err == -EOPNOTSUPP ? 0 : err;
+}
+
+static int ubr_switchdev_stp_state(struct ubr_port *p, u8 state)
+{
+	struct switchdev_attr attr = {
+		.orig_dev = p->dev,
+		.id = SWITCHDEV_ATTR_ID_PORT_STP_STATE,
+		.u.stp_state = state,
+	};
+
+	return ubr_switchdev_err(switchdev_port_attr_set(p->dev, &attr, NULL));
+}
+
+/*
+ * Mirror the port's flooding settings, and learning as given, under
+ * rtnl.  Passing learning lets a change be checked with the hardware
+ * before the data path sees it.
+ */
+int ubr_switchdev_port_flags(struct ubr_port *p, bool learning)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	unsigned pidx = p->ingress_cb.pidx;
+	struct switchdev_attr attr = {
+		.orig_dev = p->dev,
+		.id = SWITCHDEV_ATTR_ID_PORT_PRE_BRIDGE_FLAGS,
+		.u.brport_flags.mask = UBR_SWITCHDEV_FLAGS,
+	};
+	unsigned long val = 0;
+	int err;
+
+	ASSERT_RTNL();
+
+	if (!ubr_port_offloaded(p))
+		return 0;
+
+	if (learning)
+		val |= BR_LEARNING;
+	if (ubr_vec_test(&ubr->ucflood, pidx))
+		val |= BR_FLOOD;
+	if (ubr_vec_test(&ubr->mcflood, pidx))
+		val |= BR_MCAST_FLOOD;
+	if (ubr_vec_test(&ubr->bcflood, pidx))
+		val |= BR_BCAST_FLOOD;
+
+	attr.u.brport_flags.val = val;
+
+	/* Checks that the hardware supports all of them */
+	err = switchdev_port_attr_set(p->dev, &attr, NULL);
+	if (err)
+		return ubr_switchdev_err(err);
+
+	attr.id = SWITCHDEV_ATTR_ID_PORT_BRIDGE_FLAGS;
+	return ubr_switchdev_err(switchdev_port_attr_set(p->dev, &attr, NULL));
+}
+
+static int ubr_switchdev_port_vlan(struct ubr_port *p, u16 vid, bool tagged,
+				   bool add)
+{
+	struct switchdev_obj_port_vlan v = {
+		.obj.orig_dev = p->dev,
+		.obj.id = SWITCHDEV_OBJ_ID_PORT_VLAN,
+		.vid = vid,
+	};
+	int err;
+
+	if (!tagged)
+		v.flags |= BRIDGE_VLAN_INFO_UNTAGGED;
+	if (p->pvid == vid)
+		v.flags |= BRIDGE_VLAN_INFO_PVID;
+
+	if (add)
+		err = switchdev_port_obj_add(p->dev, &v.obj, NULL);
+	else
+		err = switchdev_port_obj_del(p->dev, &v.obj);
+
+	return ubr_switchdev_err(err);
+}
+
+/*
+ * Mirror a membership change applied by ubr_vlan_ports_update(), or
+ * the removal of a VLAN by ubr_vlan_del().  A port whose hardware
+ * refuses the VLAN simply leaves forwarding of it to software.  Called
+ * with rtnl held.
+ */
+void ubr_switchdev_vlan(struct ubr *ubr, u16 vid,
+			const struct ubr_vec *untagged,
+			const struct ubr_vec *tagged, bool add)
+{
+	struct ubr_port *p;
+	unsigned pidx;
+	int err;
+
+	/* VLAN 0 is the VLAN unaware domain, hardware needs no entry */
+	if (!vid)
+		return;
+
+	ASSERT_RTNL();
+
+	ubr_vec_foreach(untagged, pidx) {
+		p = &ubr->ports[pidx];
+		if (!ubr_port_offloaded(p))
+			continue;
+
+		err = ubr_switchdev_port_vlan(p, vid, false, add);
+		if (err)
+			netdev_warn(p->dev, "ubr: VLAN %u offload failed: %d\n",
+				    vid, err);
+	}
+
+	ubr_vec_foreach(tagged, pidx) {
+		p = &ubr->ports[pidx];
+		if (!ubr_port_offloaded(p))
+			continue;
+
+		err = ubr_switchdev_port_vlan(p, vid, true, add);
+		if (err)
+			netdev_warn(p->dev, "ubr: VLAN %u offload failed: %d\n",
+				    vid, err);
+	}
+}
+
+/* The PVID flag moves from the old PVID's VLAN to the new one, under
+ * rtnl.
+ */
+void ubr_switchdev_port_pvid(struct ubr_port *p, u16 old)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	struct ubr_vlan_ports *ports;
+	unsigned pidx = p->ingress_cb.pidx;
+	struct ubr_vlan *vlan;
+	u16 vids[2] = { old, p->pvid };
+	int i;
+
+	ASSERT_RTNL();
+
+	if (!ubr_port_offloaded(p) || old == p->pvid)
+		return;
+
+	for (i = 0; i < 2; i++) {
+		vlan = vids[i] ? ubr_vlan_find(ubr, vids[i]) : NULL;
+		if (!vlan)
+			continue;
+
+		ports = rcu_dereference_protected(vlan->ports,
+						  lockdep_is_held(&ubr->cfg_lock));
+		if (!ubr_vec_test(&ports->members, pidx))
+			continue;
+
+		ubr_switchdev_port_vlan(p, vids[i],
+					ubr_vec_test(&ports->tagged, pidx), true);
+	}
+}
+
+/*
+ * Tell the hardware about an address added to, or removed from, the
+ * software FDB.  May be called from the data path.
+ */
+void ubr_switchdev_fdb_notify(struct ubr *ubr, const struct ubr_fdb_node *node,
+			      bool add)
+{
+	struct switchdev_notifier_fdb_info info = {};
+	struct ubr_port *p;
+	unsigned pidx;
+
+	/* The hardware already knows what it learned itself */
+	if (node->addr.type != UBR_ADDR_MAC || node->proto == UBR_FDB_EXTERNAL)
+		return;
+
+	pidx = find_first_bit(node->vec.bitmap, UBR_MAX_PORTS);
+	if (pidx >= UBR_MAX_PORTS)
+		return;
+
+	p = &ubr->ports[pidx];
+	if (!ubr_port_offloaded(p))
+		return;
+
+	info.addr = node->addr.mac;
+	info.vid = node->vid;
+	info.added_by_user = node->proto == UBR_FDB_USER;
+
+	call_switchdev_notifiers(add ? SWITCHDEV_FDB_ADD_TO_DEVICE :
+				 SWITCHDEV_FDB_DEL_TO_DEVICE,
+				 p->dev, &info.info, NULL);
+}
+
+/*
+ * Join the port to the hardware domain of its parent ID, if any, and
+ * start it out forwarding, ubr has no STP of its own yet.  Called with
+ * cfg_lock held, before the port is marked busy.
+ */
+int ubr_switchdev_port_init(struct ubr_port *p)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	unsigned pidx = p->ingress_cb.pidx;
+	struct netdev_phys_item_id ppid;
+	struct ubr_port *peer;
+	unsigned peer_pidx;
+	int err;
+
+	ubr_vec_zero(&p->hwdom);
+	memset(&p->ppid, 0, sizeof(p->ppid));
+
+	if (p->dev == ubr->dev)
+		return 0;
+
+	err = dev_get_port_parent_id(p->dev, &ppid, true);
+	if (err)
+		return ubr_switchdev_err(err);
+
+	p->ppid = ppid;
+	ubr_vec_set(&p->hwdom, pidx);
+	ubr_vec_foreach(&ubr->busy, peer_pidx) {
+		peer = &ubr->ports[peer_pidx];
+		if (!ubr_port_offloaded(peer) ||
+		    !netdev_phys_item_id_same(&peer->ppid, &ppid))
+			continue;
+
+		ubr_vec_set(&peer->hwdom, pidx);
+		ubr_vec_set(&p->hwdom, peer_pidx);
+	}
+
+	err = ubr_switchdev_stp_state(p, BR_STATE_FORWARDING);
+	if (!err)
+		err = ubr_switchdev_port_flags(p, p->ingress_cb.sa_learning);
+	if (err)
+		ubr_switchdev_port_fini(p);
+
+	return err;
+}
+
+void ubr_switchdev_port_fini(struct ubr_port *p)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	unsigned pidx = p->ingress_cb.pidx;
+	unsigned peer_pidx;
+
+	if (!ubr_port_offloaded(p))
+		return;
+
+	ubr_vec_foreach(&p->hwdom, peer_pidx)
+		ubr_vec_clear(&ubr->ports[peer_pidx].hwdom, pidx);
+
+	ubr_switchdev_stp_state(p, BR_STATE_DISABLED);
+	memset(&p->ppid, 0, sizeof(p->ppid));
+}
+
+static void ubr_switchdev_event_work(struct work_struct *work)
+{
+	struct ubr_switchdev_work *w =
+		container_of(work, struct ubr_switchdev_work, work);
+	struct ubr_vlan *vlan;
+	struct ubr_port *p;
+	struct ubr *ubr;
+
+	rtnl_lock();
+	if (!netif_is_ubr_port(w->dev))
+		goto out;
+
+	p = ubr_port_get_rtnl(w->dev);
+	ubr = ubr_from_port(p);
+
+	mutex_lock(&ubr->cfg_lock);
+	vlan = ubr_vlan_find(ubr, w->vid);
+	if (ubr->dead || !vlan)
+		goto unlock;
+
+	switch (w->event) {
+	case SWITCHDEV_FDB_ADD_TO_BRIDGE:
+		ubr_fdb_external_add(&ubr->fdb, vlan, w->addr,
+				     p->ingress_cb.lpidx);
+		break;
+	case SWITCHDEV_FDB_DEL_TO_BRIDGE:
+		ubr_fdb_external_del(&ubr->fdb, vlan, w->addr);
+		break;
+	case SWITCHDEV_FDB_OFFLOADED:
+		ubr_fdb_offloaded_set(&ubr->fdb, vlan, w->addr);
+		break;
+	}
+unlock:
+	mutex_unlock(&ubr->cfg_lock);
+out:
+	rtnl_unlock();
+	dev_put(w->dev);
+	kfree(w);
+}
+
+/* Called in atomic context, the work is deferred */
+static int ubr_switchdev_event(struct notifier_block *unused,
+			       unsigned long event, void *ptr)
+{
+	struct net_device *dev = switchdev_notifier_info_to_dev(ptr);
+	struct switchdev_notifier_fdb_info *info;
+	struct ubr_switchdev_work *w;
+
+	switch (event) {
+	case SWITCHDEV_FDB_ADD_TO_BRIDGE:
+	case SWITCHDEV_FDB_DEL_TO_BRIDGE:
+	case SWITCHDEV_FDB_OFFLOADED:
+		break;
+	default:
+		return NOTIFY_DONE;
+	}
+
+	if (!netif_is_ubr_port(dev))
+		return NOTIFY_DONE;
+
+	info = container_of(ptr, struct switchdev_notifier_fdb_info, info);
+
+	w = kzalloc(sizeof(*w), GFP_ATOMIC);
+	if (!w)
+		return notifier_from_errno(-ENOMEM);
+
+	INIT_WORK(&w->work, ubr_switchdev_event_work);
+	w->dev = dev;
+	w->event = event;
+	ether_addr_copy(w->addr, info->addr);
+	w->vid = info->vid;
+
+	dev_hold(dev);
+	queue_work(ubr_switchdev_wq, &w->work);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ubr_switchdev_notifier = {
+	.notifier_call = ubr_switchdev_event,
+};
+
+int __init ubr_switchdev_init(void)
+{
+	int err;
+
+	ubr_switchdev_wq = alloc_ordered_workqueue("ubr_switchdev", 0);
+	if (!ubr_switchdev_wq)
+		return -ENOMEM;
+
+	err = register_switchdev_notifier(&ubr_switchdev_notifier);
+	if (err)
+		destroy_workqueue(ubr_switchdev_wq);
+
+	return err;
+}
+
+void ubr_switchdev_fini(void)
+{
+	unregister_switchdev_notifier(&ubr_switchdev_notifier);
+
+	/* Runs what is still queued */
+	destroy_workqueue(ubr_switchdev_wq);
+}
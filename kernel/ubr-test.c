@@ -0,0 +1,628 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests and microbenchmarks for the FDB, VLAN, neighbour and
+ * port vector primitives.  Frames are synthetic skbs fed straight to
+ * ubr_fdb_forward(), no devices are involved.
+ *
+ * Benchmarks report ns/op with kunit_info(), each op includes
+ * rewriting the Ethernet addresses and control buffer of the skb,
+ * like the rx_handler does, so compare numbers only between runs.
+ */
+#include <kunit/test.h>
+#include <linux/etherdevice.h>
+#include <linux/if_arp.h>
+#include <linux/ktime.h>
+#include <linux/skbuff.h>
+#include <linux/vmalloc.h>
+#include <asm/unaligned.h>
+
+#include "ubr-private.h"
+
+/* Ingress ports used by the tests, 0 is the bridge itself */
+#define UBR_TEST_PORTS 4
+
+/* Addresses learned in benchmarks are 02:00:<index>, the ones used
+ * for learn-new live above this offset. */
+#define UBR_TEST_NEW 0x01000000
+
+/* Ops per measurement, and per BH disabled section.  The node pool
+ * is refilled between sections, so learning never misses. */
+#define UBR_TEST_OPS   (1 << 18)
+#define UBR_TEST_BATCH 1024
+#define UBR_TEST_POOL  (2 * UBR_TEST_BATCH)
+
+struct ubr_test_ctx {
+	struct ubr *ubr;
+	struct sk_buff *skb;
+};
+
+static void ubr_test_mac(u8 *mac, u32 idx)
+{
+	mac[0] = 0x02;
+	mac[1] = 0x00;
+	put_unaligned_be32(idx, &mac[2]);
+}
+
+/* Must be called with BHs disabled and within an RCU read section */
+static bool ubr_test_forward(struct ubr_test_ctx *ctx, unsigned int pidx,
+			     u32 sa, u32 da, bool learn)
+{
+	struct sk_buff *skb = ctx->skb;
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ethhdr *eth = eth_hdr(skb);
+
+	ubr_test_mac(eth->h_source, sa);
+	ubr_test_mac(eth->h_dest, da);
+
+	memcpy(cb, &ctx->ubr->ports[pidx].ingress_cb, sizeof(*cb));
+	cb->sa_learning = learn;
+
+	return ubr_fdb_forward(&ctx->ubr->fdb, skb);
+}
+
+static unsigned int ubr_test_learned(struct ubr_test_ctx *ctx,
+				     unsigned int pidx)
+{
+	return percpu_counter_sum(&ctx->ubr->ports[pidx].learn.count);
+}
+
+/*
+ * Run _op for _i in [0, _n), batched in BH disabled sections, and
+ * evaluate to the average ns/op.
+ */
+#define ubr_test_bench(_ctx, _n, _i, _op) ({				\
+	u64 __t0, __ns = 0;						\
+	u32 _i;								\
+									\
+	for (_i = 0; _i < (_n);) {					\
+		u32 __end = min_t(u32, (_n), _i + UBR_TEST_BATCH);	\
+									\
+		local_bh_disable();					\
+		rcu_read_lock();					\
+		__t0 = ktime_get_ns();					\
+		for (; _i < __end; _i++)				\
+			_op;						\
+		__ns += ktime_get_ns() - __t0;				\
+		rcu_read_unlock();					\
+		local_bh_enable();					\
+									\
+		ubr_fdb_pool_resize(&(_ctx)->ubr->fdb, UBR_TEST_POOL);	\
+		cond_resched();						\
+	}								\
+									\
+	(_n) ? div_u64(__ns, (_n)) : 0;					\
+})
+
+/* Learn addresses [0, n) on port pidx */
+static void ubr_test_fill(struct ubr_test_ctx *ctx, unsigned int pidx, u32 n)
+{
+	(void)ubr_test_bench(ctx, n, i, ubr_test_forward(ctx, pidx, i, i, true));
+}
+
+static int ubr_test_init(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx;
+	struct ubr_port *p;
+	struct ubr *ubr;
+	unsigned int pidx;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx);
+
+	ubr = vzalloc(sizeof(*ubr));
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ubr);
+	ctx->ubr = ubr;
+
+	/* Tests act as the configuration path throughout */
+	mutex_init(&ubr->cfg_lock);
+	mutex_lock(&ubr->cfg_lock);
+
+	ubr->vlan_proto = ETH_P_8021Q;
+	hash_init(ubr->vlans);
+	hash_init(ubr->stps);
+#if IS_ENABLED(CONFIG_VXLAN)
+	hash_init(ubr->vnis);
+#endif
+	ubr_vec_fill(&ubr->ucflood);
+	ubr_vec_fill(&ubr->mcflood);
+	ubr_vec_fill(&ubr->bcflood);
+
+	KUNIT_ASSERT_EQ(test, ubr_fdb_newlink(&ubr->fdb), 0);
+	KUNIT_ASSERT_EQ(test, ubr_fdb_pool_resize(&ubr->fdb, UBR_TEST_POOL), 0);
+	KUNIT_ASSERT_EQ(test, ubr_neigh_newlink(&ubr->neigh), 0);
+	KUNIT_ASSERT_EQ(test, ubr_vlan_newlink(ubr), 0);
+
+	for (pidx = 0; pidx < UBR_TEST_PORTS; pidx++) {
+		p = ubr_port_init(ubr, pidx, NULL);
+		KUNIT_ASSERT_NOT_ERR_OR_NULL(test, p);
+	}
+
+	ctx->skb = alloc_skb(ETH_ZLEN, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->skb);
+
+	skb_reset_mac_header(ctx->skb);
+	skb_put_zero(ctx->skb, ETH_ZLEN);
+	eth_hdr(ctx->skb)->h_proto = htons(ETH_P_LLDP);
+	ctx->skb->protocol = htons(ETH_P_LLDP);
+	skb_pull(ctx->skb, ETH_HLEN);
+
+	test->priv = ctx;
+	return 0;
+}
+
+static void ubr_test_exit(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	struct ubr *ubr = ctx->ubr;
+	unsigned int pidx;
+
+	kfree_skb(ctx->skb);
+
+	ubr_vlan_dellink(ubr);
+	ubr_neigh_dellink(&ubr->neigh);
+	ubr_fdb_dellink(&ubr->fdb);
+	for (pidx = 0; pidx < UBR_TEST_PORTS; pidx++)
+		ubr_port_cleanup(&ubr->ports[pidx]);
+
+	mutex_unlock(&ubr->cfg_lock);
+
+	/* Ports are released from RCU callbacks */
+	rcu_barrier();
+	vfree(ubr);
+}
+
+static void ubr_test_vec(struct kunit *test)
+{
+	struct ubr_vec a, b;
+	unsigned int bit, n = 0;
+
+	ubr_vec_zero(&a);
+	KUNIT_EXPECT_TRUE(test, bitmap_empty(a.bitmap, UBR_MAX_PORTS));
+
+	ubr_vec_fill(&b);
+	KUNIT_EXPECT_TRUE(test, bitmap_full(b.bitmap, UBR_MAX_PORTS));
+
+	ubr_vec_set(&a, 1);
+	ubr_vec_set(&a, UBR_MAX_PORTS - 1);
+	ubr_vec_clear(&b, 1);
+	ubr_vec_and(&b, &a);
+	KUNIT_EXPECT_FALSE(test, ubr_vec_test(&b, 1));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&b, UBR_MAX_PORTS - 1));
+
+	ubr_vec_foreach(&b, bit)
+		n++;
+	KUNIT_EXPECT_EQ(test, n, 1U);
+
+	ubr_vec_or(&b, &a);
+	KUNIT_EXPECT_TRUE(test, bitmap_equal(a.bitmap, b.bitmap, UBR_MAX_PORTS));
+
+	ubr_vec_andnot(&b, &a);
+	KUNIT_EXPECT_TRUE(test, bitmap_empty(b.bitmap, UBR_MAX_PORTS));
+}
+
+static void ubr_test_vlan_find(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	struct ubr_vlan *vlan;
+
+	vlan = ubr_vlan_new(ctx->ubr, 10, 10, 0);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, vlan);
+
+	KUNIT_EXPECT_PTR_EQ(test, ubr_vlan_find(ctx->ubr, 10), vlan);
+	KUNIT_EXPECT_NOT_ERR_OR_NULL(test, ubr_vlan_find(ctx->ubr, 0));
+	KUNIT_EXPECT_PTR_EQ(test, ubr_vlan_find(ctx->ubr, 11), NULL);
+
+	KUNIT_EXPECT_TRUE(test, IS_ERR(ubr_vlan_new(ctx->ubr, 10, 10, 0)));
+}
+
+static void ubr_test_fdb_learn(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+
+	local_bh_disable();
+	rcu_read_lock();
+
+	/* New address */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 2, true));
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 1), 1U);
+
+	/* Refresh, no new entry */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 2, true));
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 1), 1U);
+
+	/* Station move, the entry follows */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 2, 1, 2, true));
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 1), 0U);
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 2), 1U);
+
+	/* Learning disabled */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 3, 3, 2, false));
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 3), 0U);
+
+	rcu_read_unlock();
+	local_bh_enable();
+}
+
+static void ubr_test_fdb_forward(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	struct ubr_cb *cb = ubr_cb(ctx->skb);
+	struct ubr_vec expect;
+
+	local_bh_disable();
+	rcu_read_lock();
+
+	/* Unknown destination, flood to everyone but the ingress port */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 2, true));
+	KUNIT_EXPECT_FALSE(test, ubr_vec_test(&cb->vec, 1));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 0));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 2));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 3));
+
+	/* Known destination, only its port */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 2, 2, 1, true));
+	ubr_vec_zero(&expect);
+	ubr_vec_set(&expect, 1);
+	KUNIT_EXPECT_TRUE(test, bitmap_equal(cb->vec.bitmap, expect.bitmap,
+					     UBR_MAX_PORTS));
+
+	/* Destination on the ingress port, nowhere */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 1, true));
+	KUNIT_EXPECT_TRUE(test, bitmap_empty(cb->vec.bitmap, UBR_MAX_PORTS));
+
+	rcu_read_unlock();
+	local_bh_enable();
+}
+
+static void ubr_test_fdb_shared(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	struct ubr_cb *cb = ubr_cb(ctx->skb);
+	struct ubr_vlan *v10, *v20;
+
+	/* Both VLANs in FID 10 */
+	v10 = ubr_vlan_new(ctx->ubr, 10, 10, 0);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, v10);
+	v20 = ubr_vlan_new(ctx->ubr, 20, 10, 0);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, v20);
+
+	ctx->ubr->ports[1].ingress_cb.vlan = v10;
+	ctx->ubr->ports[2].ingress_cb.vlan = v20;
+
+	local_bh_disable();
+	rcu_read_lock();
+
+	/* Learned in VLAN 10, known in VLAN 20 */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 2, true));
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 2, 2, 1, false));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 1));
+	KUNIT_EXPECT_FALSE(test, ubr_vec_test(&cb->vec, 3));
+
+	rcu_read_unlock();
+	local_bh_enable();
+
+	/* Moved to a FID of its own, VLAN 20 no longer knows it */
+	KUNIT_EXPECT_EQ(test, ubr_vlan_fid_set(v20, 20), 0);
+
+	local_bh_disable();
+	rcu_read_lock();
+
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 2, 2, 1, false));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 3));
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 1), 1U);
+
+	rcu_read_unlock();
+	local_bh_enable();
+}
+
+static void ubr_test_fdb_external(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	struct ubr_cb *cb = ubr_cb(ctx->skb);
+	struct ubr_vlan *vlan = ctx->ubr->ports[1].ingress_cb.vlan;
+	u8 mac[ETH_ALEN];
+
+	ubr_test_mac(mac, 1);
+
+	local_bh_disable();
+	rcu_read_lock();
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 2, true));
+	rcu_read_unlock();
+	local_bh_enable();
+
+	/* Hardware learned it elsewhere, takes over the dynamic entry */
+	KUNIT_EXPECT_EQ(test, ubr_fdb_external_add(&ctx->ubr->fdb, vlan,
+						   mac, 2), 0);
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 1), 0U);
+
+	local_bh_disable();
+	rcu_read_lock();
+
+	/* Software learning does not move it back */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 2, true));
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 3, 3, 1, false));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 2));
+	KUNIT_EXPECT_FALSE(test, ubr_vec_test(&cb->vec, 1));
+
+	rcu_read_unlock();
+	local_bh_enable();
+
+	/* Removed by the hardware, unknown again */
+	ubr_fdb_external_del(&ctx->ubr->fdb, vlan, mac);
+
+	local_bh_disable();
+	rcu_read_lock();
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 3, 3, 1, false));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 1));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 2));
+	rcu_read_unlock();
+	local_bh_enable();
+}
+
+static void ubr_test_vid_xlate(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	struct ubr_port *p = &ctx->ubr->ports[1];
+	const struct ubr_vid_xlate *xlate;
+
+	KUNIT_EXPECT_EQ(test, ubr_vlan_xlate_set(p, 100, 10), 0);
+	KUNIT_EXPECT_EQ(test, ubr_vlan_xlate_set(p, 200, 20), 0);
+
+	/* Egress must know which port VID to use */
+	KUNIT_EXPECT_EQ(test, ubr_vlan_xlate_set(p, 300, 10), -EEXIST);
+
+	xlate = rcu_dereference_protected(p->xlate, 1);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, xlate);
+	KUNIT_EXPECT_EQ(test, xlate->num, 2);
+	KUNIT_EXPECT_EQ(test, ubr_vid_xlate_ingress(xlate, 100), 10);
+	KUNIT_EXPECT_EQ(test, ubr_vid_xlate_ingress(xlate, 200), 20);
+	KUNIT_EXPECT_EQ(test, ubr_vid_xlate_egress(xlate, 10), 100);
+	KUNIT_EXPECT_EQ(test, ubr_vid_xlate_ingress(xlate, 300), 0);
+
+	/* Remapping releases the old bridge VID */
+	KUNIT_EXPECT_EQ(test, ubr_vlan_xlate_set(p, 100, 30), 0);
+	xlate = rcu_dereference_protected(p->xlate, 1);
+	KUNIT_EXPECT_EQ(test, xlate->num, 2);
+	KUNIT_EXPECT_EQ(test, ubr_vid_xlate_egress(xlate, 10), 0);
+	KUNIT_EXPECT_EQ(test, ubr_vid_xlate_egress(xlate, 30), 100);
+	KUNIT_EXPECT_EQ(test, ubr_vid_xlate_egress(xlate, 20), 200);
+
+	KUNIT_EXPECT_EQ(test, ubr_vlan_xlate_set(p, 100, 0), 0);
+	KUNIT_EXPECT_EQ(test, ubr_vlan_xlate_set(p, 100, 0), -ENOENT);
+	KUNIT_EXPECT_EQ(test, ubr_vlan_xlate_set(p, 200, 0), 0);
+
+	/* Nothing left to translate, back to the fast path */
+	KUNIT_EXPECT_PTR_EQ(test, rcu_access_pointer(p->xlate), NULL);
+}
+
+#if IS_ENABLED(CONFIG_VXLAN)
+static void ubr_test_tunnel(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	struct ubr_cb *cb = ubr_cb(ctx->skb);
+	const struct ip_tunnel_info *info;
+	struct metadata_dst *md;
+	struct ubr_vlan *vlan;
+
+	vlan = ubr_vlan_new(ctx->ubr, 30, 30, 0);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, vlan);
+	KUNIT_ASSERT_EQ(test, ubr_tunnel_vni_set(vlan, 3000), 0);
+	KUNIT_EXPECT_PTR_EQ(test, ubr_tunnel_vlan_find(ctx->ubr, 3000), vlan);
+
+	/* Port 3 leads into the overlay */
+	ctx->ubr->ports[1].ingress_cb.vlan = vlan;
+	ctx->ubr->ports[3].ingress_cb.vlan = vlan;
+	ctx->ubr->ports[3].ingress_cb.tunnel = 1;
+	ubr_vec_set(&ctx->ubr->tunnels, 3);
+
+	/* As received by the vxlan device from 192.0.2.3 */
+	md = __ip_tun_set_dst(htonl(0xc0000203), htonl(0xc0000201), 0, 0, 0,
+			      TUNNEL_KEY, key32_to_tunnel_id(htonl(3000)), 0);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, md);
+	skb_dst_set(ctx->skb, &md->dst);
+
+	local_bh_disable();
+	rcu_read_lock();
+
+	/* Learned behind the endpoint it came from */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 3, 3, 1, true));
+	skb_dst_drop(ctx->skb);
+
+	/* One lookup yields both the port and the endpoint */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 3, true));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 3));
+	KUNIT_EXPECT_FALSE(test, ubr_vec_test(&cb->vec, 2));
+
+	info = skb_tunnel_info(ctx->skb);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, info);
+	KUNIT_EXPECT_EQ(test, info->key.u.ipv4.dst, htonl(0xc0000203));
+	KUNIT_EXPECT_EQ(test, info->key.tun_id, key32_to_tunnel_id(htonl(3000)));
+	skb_dst_drop(ctx->skb);
+
+	/* Moved to a local port, no endpoint anymore */
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 2, 3, 1, true));
+	KUNIT_EXPECT_TRUE(test, ubr_test_forward(ctx, 1, 1, 3, true));
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 2));
+	KUNIT_EXPECT_PTR_EQ(test, skb_tunnel_info(ctx->skb), NULL);
+
+	rcu_read_unlock();
+	local_bh_enable();
+}
+#endif
+
+/* ARP from host sa on port pidx, through the FDB and neighbour stages */
+static void ubr_test_arp(struct ubr_test_ctx *ctx, struct sk_buff *skb,
+			 unsigned int pidx, u32 sa, u16 op, u32 sip, u32 tip)
+{
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ethhdr *eth = eth_hdr(skb);
+	struct arphdr *arp = (struct arphdr *)skb->data;
+	u8 *sha = (u8 *)(arp + 1);
+
+	ubr_test_mac(eth->h_source, sa);
+	if (op == ARPOP_REQUEST)
+		eth_broadcast_addr(eth->h_dest);
+	else
+		ubr_test_mac(eth->h_dest, 1);
+
+	arp->ar_hrd = htons(ARPHRD_ETHER);
+	arp->ar_pro = htons(ETH_P_IP);
+	arp->ar_hln = ETH_ALEN;
+	arp->ar_pln = 4;
+	arp->ar_op = htons(op);
+	ubr_test_mac(sha, sa);
+	put_unaligned_be32(sip, sha + ETH_ALEN);
+	put_unaligned_be32(tip, sha + 2 * ETH_ALEN + 4);
+
+	memcpy(cb, &ctx->ubr->ports[pidx].ingress_cb, sizeof(*cb));
+
+	ubr_fdb_forward(&ctx->ubr->fdb, skb);
+	ubr_neigh_ingress(ctx->ubr, skb);
+}
+
+static void ubr_test_neigh_suppress(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	struct sk_buff *skb;
+	struct ubr_cb *cb;
+	struct ubr_vec expect;
+
+	skb = alloc_skb(ETH_ZLEN, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, skb);
+
+	skb_reset_mac_header(skb);
+	skb_put_zero(skb, ETH_ZLEN);
+	eth_hdr(skb)->h_proto = htons(ETH_P_ARP);
+	skb->protocol = htons(ETH_P_ARP);
+	skb_pull(skb, ETH_HLEN);
+	cb = ubr_cb(skb);
+
+	ubr_vlan_neigh_suppress_set(ctx->ubr->ports[1].ingress_cb.vlan, true);
+
+	local_bh_disable();
+	rcu_read_lock();
+
+	/* 10.0.0.2 is host 2 on port 2, from its reply */
+	ubr_test_arp(ctx, skb, 2, 2, ARPOP_REPLY, 0x0a000002, 0x0a000001);
+
+	/* Requests for it only go to port 2 */
+	ubr_test_arp(ctx, skb, 3, 3, ARPOP_REQUEST, 0x0a000003, 0x0a000002);
+	ubr_vec_zero(&expect);
+	ubr_vec_set(&expect, 2);
+	KUNIT_EXPECT_TRUE(test, bitmap_equal(cb->vec.bitmap, expect.bitmap,
+					     UBR_MAX_PORTS));
+
+	/* Unknown targets, and announcements, are flooded */
+	ubr_test_arp(ctx, skb, 3, 3, ARPOP_REQUEST, 0x0a000003, 0x0a000009);
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 1));
+	ubr_test_arp(ctx, skb, 3, 3, ARPOP_REQUEST, 0x0a000003, 0x0a000003);
+	KUNIT_EXPECT_TRUE(test, ubr_vec_test(&cb->vec, 1));
+
+	rcu_read_unlock();
+	local_bh_enable();
+
+	kfree_skb(skb);
+}
+
+static const u32 ubr_test_fdb_sizes[] = { 1024, 16384, 65536 };
+
+static void ubr_test_fdb_size_desc(const u32 *size, char *desc)
+{
+	snprintf(desc, KUNIT_PARAM_DESC_SIZE, "%u entries", *size);
+}
+
+KUNIT_ARRAY_PARAM(ubr_test_fdb_size, ubr_test_fdb_sizes,
+		  ubr_test_fdb_size_desc);
+
+static void ubr_test_fdb_bench(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	u32 n = *(const u32 *)test->param_value;
+	u64 ns;
+
+	ubr_test_fill(ctx, 1, n);
+	KUNIT_ASSERT_EQ(test, ubr_test_learned(ctx, 1), n);
+
+	/* Known destination, no learning */
+	ns = ubr_test_bench(ctx, UBR_TEST_OPS, i,
+			    ubr_test_forward(ctx, 2, n, i % n, false));
+	kunit_info(test, "lookup:     %llu ns/op\n", ns);
+
+	/* Known source and destination, the common case */
+	ns = ubr_test_bench(ctx, UBR_TEST_OPS, i,
+			    ubr_test_forward(ctx, 1, i % n, (i + 1) % n, true));
+	kunit_info(test, "hit:        %llu ns/op\n", ns);
+
+	/* Unknown destination, flooded */
+	ns = ubr_test_bench(ctx, UBR_TEST_OPS, i,
+			    ubr_test_forward(ctx, 2, n, UBR_TEST_NEW - 1 - i, false));
+	kunit_info(test, "miss:       %llu ns/op\n", ns);
+
+	/* Every source is new */
+	ns = ubr_test_bench(ctx, n, i,
+			    ubr_test_forward(ctx, 2, UBR_TEST_NEW + i, 0, true));
+	kunit_info(test, "learn-new:  %llu ns/op\n", ns);
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 2), n);
+
+	/* Every source moves from port 1 to port 3 */
+	ns = ubr_test_bench(ctx, n, i,
+			    ubr_test_forward(ctx, 3, i, 0, true));
+	kunit_info(test, "learn-move: %llu ns/op\n", ns);
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 1), 0U);
+	KUNIT_EXPECT_EQ(test, ubr_test_learned(ctx, 3), n);
+}
+
+static const u32 ubr_test_vlan_counts[] = { 1, 64, 4094 };
+
+static void ubr_test_vlan_count_desc(const u32 *count, char *desc)
+{
+	snprintf(desc, KUNIT_PARAM_DESC_SIZE, "%u VLANs", *count);
+}
+
+KUNIT_ARRAY_PARAM(ubr_test_vlan_count, ubr_test_vlan_counts,
+		  ubr_test_vlan_count_desc);
+
+static void ubr_test_vlan_bench(struct kunit *test)
+{
+	struct ubr_test_ctx *ctx = test->priv;
+	u32 n = *(const u32 *)test->param_value;
+	u32 vid;
+	u64 ns;
+
+	for (vid = 1; vid <= n; vid++)
+		KUNIT_ASSERT_NOT_ERR_OR_NULL(test,
+					     ubr_vlan_new(ctx->ubr, vid, vid, 0));
+
+	ns = ubr_test_bench(ctx, UBR_TEST_OPS, i,
+			    ubr_vlan_find(ctx->ubr, 1 + i % n));
+	kunit_info(test, "vlan-find:  %llu ns/op\n", ns);
+}
+
+static struct kunit_case ubr_test_cases[] = {
+	KUNIT_CASE(ubr_test_vec),
+	KUNIT_CASE(ubr_test_vlan_find),
+	KUNIT_CASE(ubr_test_fdb_learn),
+	KUNIT_CASE(ubr_test_fdb_forward),
+	KUNIT_CASE(ubr_test_fdb_shared),
+	KUNIT_CASE(ubr_test_fdb_external),
+	KUNIT_CASE(ubr_test_vid_xlate),
+#if IS_ENABLED(CONFIG_VXLAN)
+	KUNIT_CASE(ubr_test_tunnel),
+#endif
+	KUNIT_CASE(ubr_test_neigh_suppress),
+	KUNIT_CASE_PARAM(ubr_test_fdb_bench, ubr_test_fdb_size_gen_params),
+	KUNIT_CASE_PARAM(ubr_test_vlan_bench, ubr_test_vlan_count_gen_params),
+	{}
+};
+
+static struct kunit_suite ubr_test_suite = {
+	.name = "ubr",
+	.init = ubr_test_init,
+	.exit = ubr_test_exit,
+	.test_cases = ubr_test_cases,
+};
+
+kunit_test_suite(ubr_test_suite);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("The Unassuming Bridge, KUnit tests");
@@ -0,0 +1,583 @@
+#include <linux/etherdevice.h>
+#include <linux/if_vlan.h>
+
+#include <net/dst_metadata.h>
+#include <net/vxlan.h>
+
+#include "ubr-netlink.h"
+#include "ubr-private.h"
+
+/*
+ * VXLAN overlays.  A vxlan device in external (collect_md) mode is
+ * attached as a tunnel port, and VLANs are mapped to VNIs.  The
+ * tunnel endpoint of a destination is then part of its FDB entry, so
+ * the single FDB lookup resolves local and remote destinations alike,
+ * and the vxlan device only encapsulates towards the endpoint it is
+ * handed in the frame's metadata dst.
+ *
+ * Flooded frames are replicated to each endpoint in the VLAN's head
+ * end replication list.  Frames from the overlay are never sent back
+ * into it, endpoints are expected to be fully meshed.
+ */
+
+#define UBR_TUNNEL_REMOTES_MAX 256
+
+struct ubr_tunnel_addr {
+	u16 family;
+
+	union {
+		__be32 ip4;
+#if IS_ENABLED(CONFIG_IPV6)
+		struct in6_addr ip6;
+#endif
+	};
+};
+
+struct ubr_tunnel_remote {
+	struct ubr_tunnel_addr addr;
+	/* Prepared for the VLAN's VNI, shared by all replicas */
+	struct metadata_dst *md;
+};
+
+struct ubr_tunnel_remotes {
+	struct rcu_head rcu;
+	unsigned int num;
+	struct ubr_tunnel_remote remote[];
+};
+
+static struct metadata_dst *ubr_tunnel_dst_new(const struct ubr_tunnel_addr *addr,
+					       u32 vni)
+{
+	__be64 id = key32_to_tunnel_id(cpu_to_be32(vni));
+
+	switch (addr->family) {
+	case AF_INET:
+		return __ip_tun_set_dst(0, addr->ip4, 0, 0, 0, TUNNEL_KEY, id, 0);
+#if IS_ENABLED(CONFIG_IPV6)
+	case AF_INET6:
+		return __ipv6_tun_set_dst(&in6addr_any, &addr->ip6, 0, 0, 0, 0,
+					  TUNNEL_KEY, id, 0);
+#endif
+	}
+
+	return NULL;
+}
+
+static bool ubr_tunnel_addr_equal(const struct ubr_tunnel_addr *a,
+				  const struct ubr_tunnel_addr *b)
+{
+	if (a->family != b->family)
+		return false;
+
+#if IS_ENABLED(CONFIG_IPV6)
+	if (a->family == AF_INET6)
+		return ipv6_addr_equal(&a->ip6, &b->ip6);
+#endif
+	return a->ip4 == b->ip4;
+}
+
+/* Endpoint a received frame came from */
+static void ubr_tunnel_info_src(const struct ip_tunnel_info *info,
+				struct ubr_tunnel_addr *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->family = ip_tunnel_info_af(info);
+
+#if IS_ENABLED(CONFIG_IPV6)
+	if (addr->family == AF_INET6) {
+		addr->ip6 = info->key.u.ipv6.src;
+		return;
+	}
+#endif
+	addr->ip4 = info->key.u.ipv4.src;
+}
+
+/* Endpoint a prepared dst sends to */
+static void ubr_tunnel_info_dst(const struct ip_tunnel_info *info,
+				struct ubr_tunnel_addr *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->family = ip_tunnel_info_af(info);
+
+#if IS_ENABLED(CONFIG_IPV6)
+	if (addr->family == AF_INET6) {
+		addr->ip6 = info->key.u.ipv6.dst;
+		return;
+	}
+#endif
+	addr->ip4 = info->key.u.ipv4.dst;
+}
+
+struct ubr_vlan *ubr_tunnel_vlan_find(struct ubr *ubr, u32 vni)
+{
+	struct ubr_vlan *vlan;
+
+	hash_for_each_possible_rcu(ubr->vnis, vlan, vni_node, vni,
+				   lockdep_is_held(&ubr->cfg_lock)) {
+		if (vlan->vni == vni)
+			return vlan;
+	}
+
+	return NULL;
+}
+UBR_EXPORT_FOR_TEST(ubr_tunnel_vlan_find);
+
+/*
+ * Classify a frame from a tunnel port by its VNI, the frame is then
+ * untagged in that VLAN.  Returns false if the frame should be
+ * dropped.
+ */
+bool ubr_tunnel_ingress(struct ubr *ubr, struct sk_buff *skb)
+{
+	const struct ip_tunnel_info *info = skb_tunnel_info(skb);
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_vlan *vlan;
+
+	if (unlikely(!info))
+		return false;
+
+	vlan = ubr_tunnel_vlan_find(ubr,
+				    be32_to_cpu(tunnel_id_to_key32(info->key.tun_id)));
+	if (unlikely(!vlan))
+		return false;
+
+	cb->vlan = vlan;
+	cb->vlan_filtering = 1;
+
+	/* Split horizon */
+	ubr_vec_andnot(&cb->vec, &ubr->tunnels);
+	return true;
+}
+
+/*
+ * Point a dynamic entry at the endpoint a frame from a tunnel port
+ * came from, or, for a frame from a local port, clear the endpoint of
+ * an entry that moved off the overlay.  Called from ubr_fdb_learn().
+ */
+void ubr_tunnel_learn(struct ubr_fdb_node *node, struct sk_buff *skb)
+{
+	struct metadata_dst *md = NULL, *old;
+	const struct ip_tunnel_info *info;
+	struct ubr_tunnel_addr src, cur;
+	u32 vni;
+
+	if (ubr_cb(skb)->tunnel) {
+		info = skb_tunnel_info(skb);
+		ubr_tunnel_info_src(info, &src);
+		vni = be32_to_cpu(tunnel_id_to_key32(info->key.tun_id));
+
+		old = rcu_dereference(node->remote);
+		if (old) {
+			ubr_tunnel_info_dst(&old->u.tun_info, &cur);
+			if (old->u.tun_info.key.tun_id == info->key.tun_id &&
+			    ubr_tunnel_addr_equal(&cur, &src))
+				return;
+		}
+
+		md = ubr_tunnel_dst_new(&src, vni);
+		if (unlikely(!md))
+			return;
+	} else if (!rcu_access_pointer(node->remote)) {
+		return;
+	}
+
+	/* Learning may run on several CPUs at once */
+	old = unrcu_pointer(xchg(&node->remote, RCU_INITIALIZER(md)));
+	if (old)
+		dst_release(&old->dst);
+}
+
+/* Known destination behind a tunnel port, hand its endpoint along */
+void ubr_tunnel_fdb_forward(struct sk_buff *skb,
+			    const struct ubr_fdb_node *node)
+{
+	struct metadata_dst *md = rcu_dereference(node->remote);
+
+	/* Lost a race with relearning, replicated like a flood */
+	if (unlikely(!md || !dst_hold_safe(&md->dst)))
+		return;
+
+	skb_dst_drop(skb);
+	skb_dst_set(skb, &md->dst);
+}
+
+static void ubr_tunnel_dst_set(struct sk_buff *skb, struct metadata_dst *md)
+{
+	skb_dst_drop(skb);
+	skb_dst_set(skb, dst_clone(&md->dst));
+}
+
+/* Consumes skb, which is headed for a tunnel port */
+void ubr_tunnel_xmit(struct ubr *ubr, struct sk_buff *skb)
+{
+	const struct ubr_tunnel_remotes *rems;
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct sk_buff *cskb;
+	unsigned int i;
+
+	if (skb_tunnel_info(skb)) {
+		dev_queue_xmit(skb);
+		return;
+	}
+
+	/* Head end replication */
+	rems = rcu_dereference(cb->vlan->remotes);
+	if (!rems || !rems->num)
+		goto drop;
+
+	for (i = 0; i < rems->num - 1; i++) {
+		cskb = skb_clone(skb, GFP_ATOMIC);
+		if (!cskb) {
+			ubr_port_stats_inc(&ubr->ports[cb->pidx],
+					   replication_drops);
+			goto drop;
+		}
+
+		ubr_tunnel_dst_set(cskb, rems->remote[i].md);
+		dev_queue_xmit(cskb);
+	}
+
+	ubr_tunnel_dst_set(skb, rems->remote[i].md);
+	dev_queue_xmit(skb);
+	return;
+drop:
+	kfree_skb(skb);
+}
+
+static void ubr_tunnel_remotes_free_rcu(struct rcu_head *head)
+{
+	struct ubr_tunnel_remotes *rems =
+		container_of(head, struct ubr_tunnel_remotes, rcu);
+	unsigned int i;
+
+	for (i = 0; i < rems->num; i++)
+		dst_release(&rems->remote[i].md->dst);
+
+	kfree(rems);
+}
+
+static void ubr_tunnel_remotes_publish(struct ubr_vlan *vlan,
+				       struct ubr_tunnel_remotes *rems)
+{
+	struct ubr_tunnel_remotes *old;
+
+	old = rcu_dereference_protected(vlan->remotes,
+					lockdep_is_held(&vlan->ubr->cfg_lock));
+	rcu_assign_pointer(vlan->remotes, rems);
+	if (old)
+		call_rcu(&old->rcu, ubr_tunnel_remotes_free_rcu);
+}
+
+/*
+ * Build a new replication list for the VLAN's current VNI from the old
+ * one, with add appended and del left out, either may be NULL.
+ */
+static struct ubr_tunnel_remotes *
+ubr_tunnel_remotes_build(struct ubr_vlan *vlan,
+			 const struct ubr_tunnel_addr *add,
+			 const struct ubr_tunnel_addr *del)
+{
+	const struct ubr_tunnel_remotes *old;
+	struct ubr_tunnel_remotes *rems;
+	unsigned int i, num = 0;
+
+	old = rcu_dereference_protected(vlan->remotes,
+					lockdep_is_held(&vlan->ubr->cfg_lock));
+
+	rems = kzalloc(struct_size(rems, remote, (old ? old->num : 0) + 1),
+		       GFP_KERNEL);
+	if (!rems)
+		return ERR_PTR(-ENOMEM);
+
+	for (i = 0; old && i < old->num; i++) {
+		if (del && ubr_tunnel_addr_equal(&old->remote[i].addr, del))
+			continue;
+
+		rems->remote[num++].addr = old->remote[i].addr;
+	}
+
+	if (add)
+		rems->remote[num++].addr = *add;
+
+	for (i = 0; i < num; i++) {
+		rems->remote[i].md = ubr_tunnel_dst_new(&rems->remote[i].addr,
+							vlan->vni);
+		if (!rems->remote[i].md) {
+			rems->num = i;
+			ubr_tunnel_remotes_free_rcu(&rems->rcu);
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+
+	rems->num = num;
+	return rems;
+}
+
+static bool ubr_tunnel_remotes_has(struct ubr_vlan *vlan,
+				   const struct ubr_tunnel_addr *addr)
+{
+	const struct ubr_tunnel_remotes *rems;
+	unsigned int i;
+
+	rems = rcu_dereference_protected(vlan->remotes,
+					 lockdep_is_held(&vlan->ubr->cfg_lock));
+	for (i = 0; rems && i < rems->num; i++) {
+		if (ubr_tunnel_addr_equal(&rems->remote[i].addr, addr))
+			return true;
+	}
+
+	return false;
+}
+
+static int ubr_tunnel_remotes_update(struct ubr_vlan *vlan,
+				     const struct ubr_tunnel_addr *addr,
+				     bool add)
+{
+	const struct ubr_tunnel_remotes *old;
+	struct ubr_tunnel_remotes *rems;
+
+	old = rcu_dereference_protected(vlan->remotes,
+					lockdep_is_held(&vlan->ubr->cfg_lock));
+
+	if (add) {
+		if (ubr_tunnel_remotes_has(vlan, addr))
+			return -EEXIST;
+		if (old && old->num >= UBR_TUNNEL_REMOTES_MAX)
+			return -ENOSPC;
+	} else if (!ubr_tunnel_remotes_has(vlan, addr)) {
+		return -ENOENT;
+	}
+
+	rems = ubr_tunnel_remotes_build(vlan, add ? addr : NULL,
+					add ? NULL : addr);
+	if (IS_ERR(rems))
+		return PTR_ERR(rems);
+
+	ubr_tunnel_remotes_publish(vlan, rems);
+	return 0;
+}
+
+/*
+ * Map the VLAN to a VNI, 0 for none.  The replication list is rebuilt
+ * for the new VNI, while addresses behind tunnel ports are flushed
+ * since their endpoints were prepared for the old one.
+ */
+int ubr_tunnel_vni_set(struct ubr_vlan *vlan, u32 vni)
+{
+	struct ubr *ubr = vlan->ubr;
+	struct ubr_fdb_flush_op op = {
+		.per_port = true,
+		.per_vlan = true,
+		.vid = vlan->vid,
+	};
+	struct ubr_tunnel_remotes *rems = NULL;
+	u32 old = vlan->vni;
+	unsigned pidx;
+
+	if (vni >= VXLAN_N_VID)
+		return -EINVAL;
+
+	if (vni == old)
+		return 0;
+
+	if (vni && ubr_tunnel_vlan_find(ubr, vni))
+		return -EEXIST;
+
+	WRITE_ONCE(vlan->vni, vni);
+	if (rcu_access_pointer(vlan->remotes)) {
+		rems = ubr_tunnel_remotes_build(vlan, NULL, NULL);
+		if (IS_ERR(rems)) {
+			WRITE_ONCE(vlan->vni, old);
+			return PTR_ERR(rems);
+		}
+	}
+
+	if (old)
+		hash_del_rcu(&vlan->vni_node);
+	if (vni)
+		hash_add_rcu(ubr->vnis, &vlan->vni_node, vni);
+
+	if (rems)
+		ubr_tunnel_remotes_publish(vlan, rems);
+
+	ubr_vec_foreach(&ubr->tunnels, pidx) {
+		op.pidx = pidx;
+		ubr_fdb_flush(&ubr->fdb, op);
+	}
+
+	return 0;
+}
+UBR_EXPORT_FOR_TEST(ubr_tunnel_vni_set);
+
+/* Called when the VLAN is deleted */
+void ubr_tunnel_vlan_fini(struct ubr_vlan *vlan)
+{
+	if (vlan->vni)
+		hash_del_rcu(&vlan->vni_node);
+
+	ubr_tunnel_remotes_publish(vlan, NULL);
+}
+
+/* Ports backed by a vxlan device in external mode are tunnel ports */
+void ubr_tunnel_port_init(struct ubr_port *p)
+{
+	struct ubr *ubr = ubr_from_port(p);
+	struct vxlan_dev *vxlan;
+
+	if (p->dev == ubr->dev || !netif_is_vxlan(p->dev))
+		return;
+
+	vxlan = netdev_priv(p->dev);
+	if (!(vxlan->cfg.flags & VXLAN_F_COLLECT_METADATA))
+		return;
+
+	p->ingress_cb.tunnel = 1;
+	ubr_vec_set(&ubr->tunnels, p->ingress_cb.pidx);
+}
+
+/* Tunnel port that static entries in the VLAN are put on */
+static int ubr_tunnel_vlan_port(struct ubr_vlan *vlan)
+{
+	struct ubr_vlan_ports *ports;
+	unsigned pidx;
+
+	ports = rcu_dereference_protected(vlan->ports,
+					  lockdep_is_held(&vlan->ubr->cfg_lock));
+	ubr_vec_foreach(&vlan->ubr->tunnels, pidx) {
+		if (ubr_vec_test(&ports->members, pidx))
+			return pidx;
+	}
+
+	return -ENOENT;
+}
+
+static const struct nla_policy ubr_nl_remote_policy[UBR_NLA_REMOTE_MAX + 1] = {
+	[UBR_NLA_REMOTE_UNSPEC] = { .type = NLA_UNSPEC },
+	[UBR_NLA_REMOTE_VID]    = { .type = NLA_U16 },
+	[UBR_NLA_REMOTE_IP4]    = { .type = NLA_U32 },
+	[UBR_NLA_REMOTE_IP6]    = { .len = sizeof(struct in6_addr) },
+	[UBR_NLA_REMOTE_LLADDR] = { .len = ETH_ALEN },
+};
+
+static int __get_remote(struct genl_info *info, struct nlattr **attrs,
+			struct ubr *ubr, struct ubr_vlan **vlan,
+			struct ubr_tunnel_addr *addr)
+{
+	int err;
+
+	if (!info->attrs || !info->attrs[UBR_NLA_REMOTE])
+		return -EINVAL;
+
+	err = nla_parse_nested(attrs, UBR_NLA_REMOTE_MAX,
+			       info->attrs[UBR_NLA_REMOTE],
+			       ubr_nl_remote_policy, info->extack);
+	if (err)
+		return err;
+
+	if (!attrs[UBR_NLA_REMOTE_VID] ||
+	    !attrs[UBR_NLA_REMOTE_IP4] == !attrs[UBR_NLA_REMOTE_IP6])
+		return -EINVAL;
+
+	*vlan = ubr_vlan_find(ubr, nla_get_u16(attrs[UBR_NLA_REMOTE_VID]));
+	if (!*vlan)
+		return -ENOENT;
+
+	memset(addr, 0, sizeof(*addr));
+	if (attrs[UBR_NLA_REMOTE_IP4]) {
+		addr->family = AF_INET;
+		addr->ip4 = nla_get_in_addr(attrs[UBR_NLA_REMOTE_IP4]);
+		return 0;
+	}
+
+#if IS_ENABLED(CONFIG_IPV6)
+	addr->family = AF_INET6;
+	addr->ip6 = nla_get_in6_addr(attrs[UBR_NLA_REMOTE_IP6]);
+	return 0;
+#else
+	return -EAFNOSUPPORT;
+#endif
+}
+
+/*
+ * Without LLADDR the endpoint is added to the VLAN's replication list,
+ * with it, a static FDB entry for LLADDR behind the endpoint is added.
+ */
+int ubr_tunnel_nl_add_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *attrs[UBR_NLA_REMOTE_MAX + 1];
+	struct ubr_tunnel_addr addr;
+	struct metadata_dst *md;
+	struct net_device *dev;
+	struct ubr_vlan *vlan;
+	struct ubr *ubr;
+	u8 *lladdr;
+	int err, pidx;
+
+	dev = ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+	err = __get_remote(info, attrs, ubr, &vlan, &addr);
+	if (err)
+		goto out;
+
+	if (!attrs[UBR_NLA_REMOTE_LLADDR]) {
+		err = ubr_tunnel_remotes_update(vlan, &addr, true);
+		goto out;
+	}
+
+	lladdr = nla_data(attrs[UBR_NLA_REMOTE_LLADDR]);
+	if (!is_valid_ether_addr(lladdr) || !vlan->vni) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	pidx = ubr_tunnel_vlan_port(vlan);
+	if (pidx < 0) {
+		err = pidx;
+		goto out;
+	}
+
+	md = ubr_tunnel_dst_new(&addr, vlan->vni);
+	if (!md) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	err = ubr_fdb_remote_add(&ubr->fdb, vlan, lladdr, pidx, md);
+	if (!err)
+		printk(KERN_NOTICE "Add remote %pM on %s VLAN %u VNI %u\n",
+		       lladdr, dev->name, vlan->vid, vlan->vni);
+out:
+	dev_put(dev);
+	return err;
+}
+
+int ubr_tunnel_nl_del_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *attrs[UBR_NLA_REMOTE_MAX + 1];
+	struct ubr_tunnel_addr addr;
+	struct net_device *dev;
+	struct ubr_vlan *vlan;
+	struct ubr *ubr;
+	int err;
+
+	dev = ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+	err = __get_remote(info, attrs, ubr, &vlan, &addr);
+	if (err)
+		goto out;
+
+	if (attrs[UBR_NLA_REMOTE_LLADDR])
+		err = ubr_fdb_remote_del(&ubr->fdb, vlan,
+					 nla_data(attrs[UBR_NLA_REMOTE_LLADDR]));
+	else
+		err = ubr_tunnel_remotes_update(vlan, &addr, false);
+out:
+	dev_put(dev);
+	return err;
+}
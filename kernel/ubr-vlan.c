@@ -9,48 +9,162 @@ const struct nla_policy ubr_nl_vlan_policy[UBR_NLA_VLAN_MAX + 1] = {
 	[UBR_NLA_VLAN_PORT]     = { .type = NLA_U32    },
 	[UBR_NLA_VLAN_TAGGED]   = { .type = NLA_U32    }, /* XXX: bool */
 	[UBR_NLA_VLAN_LEARNING] = { .type = NLA_U32    }, /* XXX: bool */
+	[UBR_NLA_VLAN_VID_END]  = { .type = NLA_U16    },
+	[UBR_NLA_VLAN_PORTS]    = { .type = NLA_NESTED },
+	[UBR_NLA_VLAN_TAGGED_PORTS] = { .type = NLA_NESTED },
+	[UBR_NLA_VLAN_FLOOD_UNICAST]   = { .type = NLA_U32 }, /* XXX: bool */
+	[UBR_NLA_VLAN_FLOOD_MULTICAST] = { .type = NLA_U32 }, /* XXX: bool */
+	[UBR_NLA_VLAN_FLOOD_BROADCAST] = { .type = NLA_U32 }, /* XXX: bool */
+	[UBR_NLA_VLAN_LEARN_LIMIT]     = { .type = NLA_U32 },
+	[UBR_NLA_VLAN_LEARN_RATE]      = { .type = NLA_U32 },
+	[UBR_NLA_VLAN_LEARN_ACTION]    = { .type = NLA_U32 },
+	[UBR_NLA_VLAN_FID]             = { .type = NLA_U16 },
+	[UBR_NLA_VLAN_NEIGH_SUPPRESS]  = { .type = NLA_U32 }, /* XXX: bool */
+	[UBR_NLA_VLAN_VNI]             = { .type = NLA_U32 },
 };
 
-bool ubr_vlan_ingress(struct ubr *ubr, struct sk_buff *skb)
+/* Number of ports, in any bridge, with VID translation */
+DEFINE_STATIC_KEY_FALSE(ubr_vlan_xlate_used);
+
+/*
+ * Map a port VID to the bridge VID, rewriting the tag in the metadata
+ * where the core put it.  Tags are only left in the payload for frames
+ * from the host, whose port never translates.
+ */
+static u16 ubr_vlan_xlate_ingress(struct ubr *ubr, struct sk_buff *skb,
+				  u16 vid)
+{
+	const struct ubr_vid_xlate *xlate;
+	struct ubr_cb *cb = ubr_cb(skb);
+	u16 bvid;
+
+	if (!static_branch_unlikely(&ubr_vlan_xlate_used))
+		return vid;
+
+	xlate = rcu_dereference(ubr->ports[cb->pidx].xlate);
+	if (likely(!xlate))
+		return vid;
+
+	bvid = ubr_vid_xlate_ingress(xlate, vid);
+	if (!bvid)
+		return vid;
+
+	skb->vlan_tci = (skb->vlan_tci & ~VLAN_VID_MASK) | bvid;
+	return bvid;
+}
+
+/*
+ * Map the bridge VID back to the port VID on tagged egress.  The tag
+ * is in the metadata, unless ubr_variant_prepare() moved it into the
+ * payload, data then points to the MAC header.  Returns false if the
+ * frame was consumed.
+ */
+bool ubr_vlan_xlate_egress(struct ubr *ubr, struct sk_buff *skb, unsigned pidx)
+{
+	const struct ubr_vid_xlate *xlate;
+	struct ubr_cb *cb = ubr_cb(skb);
+	struct vlan_ethhdr *veth;
+	u16 vid;
+
+	xlate = rcu_dereference(ubr->ports[pidx].xlate);
+	if (!xlate || !cb->vlan_filtering ||
+	    !ubr_vec_test(&rcu_dereference(cb->vlan->ports)->tagged, pidx))
+		return true;
+
+	vid = ubr_vid_xlate_egress(xlate, cb->vlan->vid);
+	if (!vid)
+		return true;
+
+	if (skb_vlan_tag_present(skb)) {
+		skb->vlan_tci = (skb->vlan_tci & ~VLAN_VID_MASK) | vid;
+		return true;
+	}
+
+	/* Clones share the data with the other ports */
+	if (unlikely(skb_ensure_writable(skb, VLAN_ETH_HLEN))) {
+		kfree_skb(skb);
+		return false;
+	}
+
+	veth = (struct vlan_ethhdr *)skb->data;
+	veth->h_vlan_TCI = htons((ntohs(veth->h_vlan_TCI) & ~VLAN_VID_MASK) |
+				 vid);
+	return true;
+}
+
+/*
+ * Classify the frame of a VLAN filtering port, or from an overlay.
+ * Ports without filtering keep all frames in the VLAN of PVID 0, see
+ * ubr_forward().  Returns the frame, which may have been reallocated,
+ * or NULL if it was consumed.  *allow is cleared if the frame may not
+ * be forwarded, cb->vlan is NULL if it has no VLAN at all.
+ */
+struct sk_buff *ubr_vlan_ingress(struct ubr *ubr, struct sk_buff *skb,
+				 bool *allow)
 {
 	struct ubr_cb *cb = ubr_cb(skb);
+	struct ubr_vlan_ports *ports;
 	bool tagged = false;
 	u16 vid = 0;
 
-	if (!cb->vlan_filtering)
-		goto out;
-
 	/*
 	 * This looks weird, but skb_vlan_tag_present() looks for any
 	 * already offloaded VLAN information, not for 0x8100 in the
-	 * payload after the source address.  So, if there is no VLAN
-	 * info extracted already from the frame we do that here.
+	 * payload after the source address.  Frames from ports are
+	 * untagged by the core already, so this is only for frames from
+	 * the host, e.g. a packet socket on the bridge.  A tag with a
+	 * VID is left in place, tagged egress then forwards the frame
+	 * without touching the header.
 	 */
 	if (unlikely(!skb_vlan_tag_present(skb) &&
-		     skb->protocol == ubr->vlan_proto)) {
-		skb = skb_vlan_untag(skb);
-		if (unlikely(!skb))
-			return false;
+		     skb->protocol == htons(ubr->vlan_proto))) {
+		if (unlikely(!pskb_may_pull(skb, VLAN_HLEN))) {
+			kfree_skb(skb);
+			return NULL;
+		}
+
+		vid = ntohs(((struct vlan_hdr *)skb->data)->h_vlan_TCI) &
+			VLAN_VID_MASK;
+		if (vid) {
+			cb->vlan_inline = 1;
+			tagged = true;
+		} else {
+			/* May unshare, frees the frame on failure */
+			skb = skb_vlan_untag(skb);
+			if (unlikely(!skb))
+				return NULL;
+
+			cb = ubr_cb(skb);
+		}
 	}
 
 	/*
 	 * If we end up with VLAN information we handle that here.
-	 * First, the VLAN proto field may be something odd, e.g.
-	 * an S-tag instead of a C-tag, then we convert to C-tag.
-	 * Second, if the frame was a sane C-tag, extract the VID
-	 * for further processing below.
+	 * First, the tag may not be of the bridge's protocol, e.g. a
+	 * C-tag on an 802.1ad bridge.  Then it is put back in the
+	 * payload and passed through untouched, the frame is untagged
+	 * as far as the bridge is concerned.  Second, if the tag is
+	 * ours, extract the VID for further processing below.
 	 */
 	if (unlikely(skb_vlan_tag_present(skb))) {
-		if (unlikely(htons(skb->vlan_proto) != ubr->vlan_proto)) {
+		if (unlikely(ntohs(skb->vlan_proto) != ubr->vlan_proto)) {
+			/* Insertion wants data at the MAC header, and
+			 * frees the frame on failure
+			 */
+			__skb_push(skb, ETH_HLEN);
 			skb = vlan_insert_tag_set_proto(skb, skb->vlan_proto,
 							skb_vlan_tag_get(skb));
 			if (unlikely(!skb))
-				return false;
+				return NULL;
 
+			__skb_pull(skb, ETH_HLEN);
+			__vlan_hwaccel_clear_tag(skb);
 			skb_reset_mac_len(skb);
 		} else {
 			vid = skb_vlan_tag_get_id(skb);
 			tagged = vid ? true : false;
+			if (tagged)
+				vid = ubr_vlan_xlate_ingress(ubr, skb, vid);
 		}
 	}
 
@@ -62,73 +176,406 @@ bool ubr_vlan_ingress(struct ubr *ubr, struct sk_buff *skb)
 	 * vlan (PVID), or tagged packet with a VID not configured on
 	 * this bridge, or PVID does not have a VLAN (yet). Drop.
 	 */
-	if (unlikely(!cb->vlan))
-		return false;
+	if (unlikely(!cb->vlan)) {
+		*allow = false;
+		return skb;
+	}
 
 	if (!tagged)
 		__vlan_hwaccel_put_tag(skb, htons(ubr->vlan_proto), cb->vlan->vid);
 
- 	if (!ubr_vec_test(&cb->vlan->members, cb->pidx))
-		return false;
+	ports = rcu_dereference(cb->vlan->ports);
+	if (!ubr_vec_test(&ports->members, cb->pidx)) {
+		*allow = false;
+		return skb;
+	}
 
-out:
-	ubr_vec_and(&cb->vec, &cb->vlan->members);
-	return true;
+	ubr_vec_and(&cb->vec, &ports->members);
+	return skb;
 }
 
-int ubr_vlan_port_add(struct ubr_vlan *vlan, unsigned pidx, bool tagged)
+/*
+ * Select the tag protocol of the bridge, i.e. whether it is a customer
+ * (802.1Q) or a provider (802.1ad) bridge.  Tags of the other protocol
+ * are passed through in the payload, see ubr_vlan_ingress().
+ */
+int ubr_vlan_proto_set(struct ubr *ubr, u16 proto)
 {
-	if (tagged) {
-		ubr_vec_set(&vlan->tagged, pidx);
-		smp_wmb();
+	struct ubr_fdb_flush_op op = {
+		.per_proto = true,
+		.proto = UBR_FDB_DYNAMIC,
+	};
+	unsigned pidx;
+
+	if (proto != ETH_P_8021Q && proto != ETH_P_8021AD)
+		return -EPROTONOSUPPORT;
+
+	if (proto == ubr->vlan_proto)
+		return 0;
+
+	WRITE_ONCE(ubr->vlan_proto, proto);
+
+	/* Offload of the new tag type may differ */
+	ubr_vec_foreach(&ubr->busy, pidx)
+		ubr_port_update_offloads(&ubr->ports[pidx]);
+
+	/* Learned VIDs were of the old tag type */
+	return ubr_fdb_flush(&ubr->fdb, op);
+}
+
+#define ubr_port_xlate_cfg(_p) \
+	rcu_dereference_protected((_p)->xlate, \
+				  lockdep_is_held(&ubr_from_port(_p)->cfg_lock))
+
+/*
+ * Copy n sorted pairs, leaving out the one from skip, and adding
+ * from -> to in order unless from is 0.
+ */
+static void ubr_vid_pairs_copy(struct ubr_vid_pair *dst,
+				       const struct ubr_vid_pair *src,
+				       unsigned int n, u16 skip,
+				       u16 from, u16 to)
+{
+	unsigned int i, num = 0;
+
+	for (i = 0; i < n; i++) {
+		if (src[i].from == skip)
+			continue;
+
+		if (from && from < src[i].from) {
+			dst[num++] = (struct ubr_vid_pair) { from, to };
+			from = 0;
+		}
+
+		dst[num++] = src[i];
 	}
 
-	ubr_vec_set(&vlan->members, pidx);
+	if (from)
+		dst[num] = (struct ubr_vid_pair) { from, to };
+}
 
+/*
+ * Build p's translation table with port VID vid translated to bridge
+ * VID bvid and back, or the translation of vid removed if bvid is 0.
+ * Each bridge VID can only be mapped to one port VID, otherwise egress
+ * would be ambiguous.  Returns the current table if nothing changes,
+ * NULL if no translations are left.
+ */
+struct ubr_vid_xlate *ubr_vlan_xlate_build(struct ubr_port *p, u16 vid,
+					   u16 bvid)
+{
+	struct ubr_vid_xlate *old = ubr_port_xlate_cfg(p), *new = NULL;
+	unsigned int num = old ? old->num : 0;
+	u16 cur;
+
+	if (!vid || vid >= VLAN_VID_MASK || bvid >= VLAN_VID_MASK)
+		return ERR_PTR(-EINVAL);
+
+	/* The hardware would forward with the untranslated VID */
+	if (ubr_port_offloaded(p))
+		return ERR_PTR(-EOPNOTSUPP);
+
+	cur = old ? ubr_vid_xlate_ingress(old, vid) : 0;
+	if (cur == bvid)
+		return bvid ? old : ERR_PTR(-ENOENT);
+
+	if (bvid && old && ubr_vid_xlate_egress(old, bvid))
+		return ERR_PTR(-EEXIST);
+
+	if (cur)
+		num--;
+	if (bvid)
+		num++;
+
+	if (num) {
+		new = kzalloc(struct_size(new, pairs, 2 * num), GFP_KERNEL);
+		if (!new)
+			return ERR_PTR(-ENOMEM);
+
+		new->num = num;
+		ubr_vid_pairs_copy(new->pairs, old ? old->pairs : NULL,
+				   old ? old->num : 0, vid, bvid ? vid : 0, bvid);
+		ubr_vid_pairs_copy(new->pairs + num,
+				   old ? old->pairs + old->num : NULL,
+				   old ? old->num : 0, cur, bvid, vid);
+	}
+
+	return new;
+}
+
+/* Drop a table from ubr_vlan_xlate_build() that was not published */
+void ubr_vlan_xlate_free(struct ubr_port *p, struct ubr_vid_xlate *new)
+{
+	if (new != ubr_port_xlate_cfg(p))
+		kfree(new);
+}
+
+void ubr_vlan_xlate_publish(struct ubr_port *p, struct ubr_vid_xlate *new)
+{
+	struct ubr_vid_xlate *old = ubr_port_xlate_cfg(p);
+
+	if (new == old)
+		return;
+
+	rcu_assign_pointer(p->xlate, new);
+	if (old)
+		kfree_rcu(old, rcu);
+
+	if (new && !old)
+		static_branch_inc(&ubr_vlan_xlate_used);
+	else if (old && !new)
+		static_branch_dec(&ubr_vlan_xlate_used);
+}
+
+int ubr_vlan_xlate_set(struct ubr_port *p, u16 vid, u16 bvid)
+{
+	struct ubr_vid_xlate *new;
+
+	new = ubr_vlan_xlate_build(p, vid, bvid);
+	if (IS_ERR(new))
+		return PTR_ERR(new);
+
+	ubr_vlan_xlate_publish(p, new);
 	return 0;
 }
+UBR_EXPORT_FOR_TEST(ubr_vlan_xlate_set);
 
-int ubr_vlan_port_del(struct ubr_vlan *vlan, unsigned pidx)
+#define ubr_vlan_ports_cfg(_vlan) \
+	rcu_dereference_protected((_vlan)->ports, \
+				  lockdep_is_held(&(_vlan)->ubr->cfg_lock))
+
+static void __ports_apply(struct ubr_vlan_ports *ports,
+			  const struct ubr_vec *untagged,
+			  const struct ubr_vec *tagged, bool add)
+{
+	if (add) {
+		ubr_vec_or(&ports->members, untagged);
+		ubr_vec_or(&ports->members, tagged);
+		ubr_vec_andnot(&ports->tagged, untagged);
+		ubr_vec_or(&ports->tagged, tagged);
+	} else {
+		ubr_vec_andnot(&ports->members, untagged);
+		ubr_vec_andnot(&ports->members, tagged);
+		ubr_vec_andnot(&ports->tagged, untagged);
+		ubr_vec_andnot(&ports->tagged, tagged);
+	}
+}
+
+static void __ports_publish(struct ubr_vlan *vlan, struct ubr_vlan_ports *ports)
 {
-	ubr_vec_clear(&vlan->members, pidx);
+	struct ubr_vlan_ports *old = ubr_vlan_ports_cfg(vlan);
+
+	rcu_assign_pointer(vlan->ports, ports);
+	kfree_rcu(old, rcu);
+}
+
+/*
+ * Add or remove the given ports to/from all VLANs in [vid, vid_end].
+ * The new membership of every VLAN is prepared before anything is
+ * published, so either the whole request is applied or none of it.
+ * Each VLAN's membership is published on its own though, a frame may
+ * see some VLANs of the range updated and others not yet.
+ */
+int ubr_vlan_ports_update(struct ubr *ubr, u16 vid, u16 vid_end,
+			  const struct ubr_vec *untagged,
+			  const struct ubr_vec *tagged, bool add)
+{
+	struct ubr_vlan_ports **new;
+	struct ubr_vlan *vlan;
+	int err, i, n;
+
+	if (vid_end < vid)
+		return -EINVAL;
+
+	n = vid_end - vid + 1;
+	new = kvcalloc(n, sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++) {
+		vlan = ubr_vlan_find(ubr, vid + i);
+		if (!vlan) {
+			err = -ENOENT;
+			goto err;
+		}
+
+		new[i] = kmemdup(ubr_vlan_ports_cfg(vlan), sizeof(*new[i]),
+				 GFP_KERNEL);
+		if (!new[i]) {
+			err = -ENOMEM;
+			goto err;
+		}
+
+		__ports_apply(new[i], untagged, tagged, add);
+	}
 
-	smp_wmb();
+	for (i = 0; i < n; i++)
+		__ports_publish(ubr_vlan_find(ubr, vid + i), new[i]);
 
-	ubr_vec_clear(&vlan->tagged, pidx);
+	for (i = 0; i < n; i++)
+		ubr_switchdev_vlan(ubr, vid + i, untagged, tagged, add);
 
+	kvfree(new);
 	return 0;
+
+err:
+	for (i = 0; i < n; i++)
+		kfree(new[i]);
+
+	kvfree(new);
+	return err;
+}
+
+static int __port_update(struct ubr_vlan *vlan, unsigned pidx, bool tagged,
+			 bool add)
+{
+	struct ubr_vec none = {}, vec = {};
+
+	ubr_vec_set(&vec, pidx);
+
+	return ubr_vlan_ports_update(vlan->ubr, vlan->vid, vlan->vid,
+				     tagged ? &none : &vec,
+				     tagged ? &vec : &none, add);
+}
+
+int ubr_vlan_port_add(struct ubr_vlan *vlan, unsigned pidx, bool tagged)
+{
+	return __port_update(vlan, pidx, tagged, true);
+}
+
+int ubr_vlan_port_del(struct ubr_vlan *vlan, unsigned pidx)
+{
+	return __port_update(vlan, pidx, false, false);
+}
+
+static void __flood_set(struct ubr_vec *flood, bool on,
+			const struct ubr_vec *ports)
+{
+	struct ubr_vec vec = {};
+
+	if (on)
+		vec = *ports;
+
+	/* Bits that do not change are rewritten with the same value,
+	 * so the data path sees either the old or the new setting.
+	 */
+	*flood = vec;
+}
+
+static void __vlan_flood_update(struct ubr_vlan *vlan)
+{
+	struct ubr *ubr = vlan->ubr;
+
+	__flood_set(&vlan->ucflood, vlan->ucflood_on, &ubr->ucflood);
+	__flood_set(&vlan->mcflood, vlan->mcflood_on, &ubr->mcflood);
+	__flood_set(&vlan->bcflood, vlan->bcflood_on, &ubr->bcflood);
+}
+
+/* Recalculate all VLAN flood vectors after a port flood setting changed */
+void ubr_vlan_flood_update(struct ubr *ubr)
+{
+	struct ubr_vlan *vlan;
+	int bkt;
+
+	hash_for_each(ubr->vlans, bkt, vlan, node)
+		__vlan_flood_update(vlan);
 }
 
 struct ubr_vlan *ubr_vlan_find(struct ubr *ubr, u16 vid)
 {
 	struct ubr_vlan *vlan;
 
-	hash_for_each_possible(ubr->vlans, vlan, node, vid) {
+	hash_for_each_possible_rcu(ubr->vlans, vlan, node, vid,
+				   lockdep_is_held(&ubr->cfg_lock)) {
 		if (vlan->vid == vid)
 			return vlan;
 	}
 
 	return NULL;
 }
+UBR_EXPORT_FOR_TEST(ubr_vlan_find);
 
 static void ubr_vlan_del_rcu(struct rcu_head *head)
 {
 	struct ubr_vlan *vlan = container_of(head, struct ubr_vlan, rcu);
 
 	/* ubr_fdb_put(vlan->fdb); */
+	ubr_learn_limit_destroy(&vlan->learn);
+	kfree(rcu_access_pointer(vlan->ports));
 	kfree(vlan);
 }
 
 int ubr_vlan_del(struct ubr_vlan *vlan)
 {
-	ubr_vec_zero(&vlan->members);
+	struct ubr_vlan_ports *ports = ubr_vlan_ports_cfg(vlan);
+	struct ubr_fdb_flush_op op = {
+		.per_vlan = true,
+		.vid = vlan->vid,
+	};
+	struct ubr_vec untagged;
+
+	/* Offloaded members would otherwise keep forwarding it */
+	if (!ubr_vec_empty(&ports->members)) {
+		untagged = ports->members;
+		ubr_vec_andnot(&untagged, &ports->tagged);
+		ubr_switchdev_vlan(vlan->ubr, vlan->vid, &untagged,
+				   &ports->tagged, false);
+	}
+
+	/* Entries must go while the VLAN is still around to account them */
+	ubr_fdb_flush(&vlan->ubr->fdb, op);
+	ubr_neigh_flush(&vlan->ubr->neigh, vlan);
+	ubr_tunnel_vlan_fini(vlan);
+
+	ubr_vlan_neigh_suppress_set(vlan, false);
+
+	hash_del_rcu(&vlan->node);
 	call_rcu(&vlan->rcu, ubr_vlan_del_rcu);
 
 	return 0;
 }
 
+void ubr_vlan_neigh_suppress_set(struct ubr_vlan *vlan, bool on)
+{
+	if (vlan->neigh_suppress == on)
+		return;
+
+	vlan->neigh_suppress = on;
+	if (on)
+		static_branch_inc(&ubr_neigh_suppress_used);
+	else
+		static_branch_dec(&ubr_neigh_suppress_used);
+}
+UBR_EXPORT_FOR_TEST(ubr_vlan_neigh_suppress_set);
+
+/*
+ * Move a VLAN to another filtering database.  The data path picks up
+ * the new FID with the next frame, addresses learned on the VLAN are
+ * flushed since they now belong to the wrong FID.
+ */
+int ubr_vlan_fid_set(struct ubr_vlan *vlan, u16 fid)
+{
+	struct ubr_fdb_flush_op op = {
+		.per_vlan = true,
+		.vid = vlan->vid,
+		.per_proto = true,
+		.proto = UBR_FDB_DYNAMIC,
+	};
+
+	if (fid > VLAN_VID_MASK)
+		return -EINVAL;
+
+	if (fid == vlan->fid)
+		return 0;
+
+	WRITE_ONCE(vlan->fid, fid);
+	return ubr_fdb_flush(&vlan->ubr->fdb, op);
+}
+UBR_EXPORT_FOR_TEST(ubr_vlan_fid_set);
+
 struct ubr_vlan *ubr_vlan_new(struct ubr *ubr, u16 vid, u16 fid, u16 sid)
 {
+	struct ubr_vlan_ports *ports;
 	struct ubr_vlan *vlan;
 	int err = -ENOMEM;
 
@@ -142,23 +589,41 @@ struct ubr_vlan *ubr_vlan_new(struct ubr *ubr, u16 vid, u16 fid, u16 sid)
 
 	vlan->ubr = ubr;
 	vlan->vid = vid;
+	vlan->fid = fid;
 	vlan->sa_learning = 1;
 
+	err = ubr_learn_limit_init(&vlan->learn);
+	if (err)
+		goto err;
+
+	ports = kzalloc(sizeof(*ports), GFP_KERNEL);
+	if (!ports) {
+		err = -ENOMEM;
+		goto err_learn_destroy;
+	}
+
+	RCU_INIT_POINTER(vlan->ports, ports);
+
 	/* Flood unknown traffic by default. */
-	ubr_vec_fill(&vlan->mcflood);
-	ubr_vec_fill(&vlan->bcflood);
-	ubr_vec_fill(&vlan->ucflood);
+	vlan->ucflood_on = 1;
+	vlan->mcflood_on = 1;
+	vlan->bcflood_on = 1;
+	__vlan_flood_update(vlan);
 
-	hash_add(ubr->vlans, &vlan->node, vlan->vid);
+	/* Fully set up before the data path can find it */
+	hash_add_rcu(ubr->vlans, &vlan->node, vlan->vid);
 
 	return vlan;
 
+err_learn_destroy:
+	ubr_learn_limit_destroy(&vlan->learn);
 err:
 	if (vlan)
 		kfree(vlan);
 
 	return ERR_PTR(err);
 }
+UBR_EXPORT_FOR_TEST(ubr_vlan_new);
 
 int ubr_vlan_newlink(struct ubr *ubr)
 {
@@ -170,11 +635,18 @@ int ubr_vlan_newlink(struct ubr *ubr)
 
 	return 0;
 }
+UBR_EXPORT_FOR_TEST(ubr_vlan_newlink);
 
 void ubr_vlan_dellink(struct ubr *ubr)
 {
-	/* TODO: cleanup all vlans */
+	struct hlist_node *tmp;
+	struct ubr_vlan *vlan;
+	int bkt;
+
+	hash_for_each_safe(ubr->vlans, bkt, tmp, vlan, node)
+		ubr_vlan_del(vlan);
 }
+UBR_EXPORT_FOR_TEST(ubr_vlan_dellink);
 
 static int __get_vid(struct genl_info *info, struct nlattr **attrs, u16 *vid)
 {
@@ -211,13 +683,12 @@ static int __get_port(struct genl_info *info, struct nlattr **attrs,
 	return 0;
 }
 
-static int __get_learning(struct genl_info *info, struct nlattr **attrs,
-			  u32 *learning)
+static int __get_bool(struct nlattr **attrs, int type, u32 *val)
 {
-	if (!attrs[UBR_NLA_VLAN_LEARNING])
+	if (!attrs[type])
 		return -EINVAL;
 
-	*learning = nla_get_u32(attrs[UBR_NLA_VLAN_LEARNING]);
+	*val = !!nla_get_u32(attrs[type]);
 
 	return 0;
 }
@@ -265,7 +736,7 @@ static int __get_bridge_vlan_port(struct genl_info *info,
 	}
 
 	*vlan = ubr_vlan_find(*ubr, *vid);
-	if (!ubr) {
+	if (!*vlan) {
 		err = -ENOENT;
 		goto err2;
 	}
@@ -292,9 +763,9 @@ static void __update_port_vlan(struct ubr *ubr, struct ubr_vlan *vlan, int add)
 			continue;
 
 		if (!add)
-			p->ingress_cb.vlan = NULL;
+			WRITE_ONCE(p->ingress_cb.vlan, NULL);
 		else
-			p->ingress_cb.vlan = vlan;
+			WRITE_ONCE(p->ingress_cb.vlan, vlan);
 	}
 }
 
@@ -304,23 +775,30 @@ int ubr_vlan_nl_add_cmd(struct sk_buff *skb, struct genl_info *info)
 	struct net_device *dev;
 	struct ubr_vlan *vlan;
 	struct ubr *ubr;
-	u16 vid;
+	u16 vid, fid;
 	int err;
 
 	err = __get_vid(info, attrs, &vid);
 	if (err)
 		return err;
 
+	/* Independent VLAN learning unless told otherwise */
+	fid = vid;
+	if (attrs[UBR_NLA_VLAN_FID])
+		fid = nla_get_u16(attrs[UBR_NLA_VLAN_FID]);
+	if (fid > VLAN_VID_MASK)
+		return -EINVAL;
+
 	dev = ubr_netlink_dev(info);
 	if (!dev)
 		return -EINVAL;
 
-	printk(KERN_NOTICE "Add VLAN %u to %s, hello\n", vid, dev->name);
+	printk(KERN_NOTICE "Add VLAN %u FID %u to %s, hello\n", vid, fid, dev->name);
 
 	ubr = netdev_priv(dev);
 	dev_put(dev);
 
-	vlan = ubr_vlan_new(ubr, vid, 0, 0);
+	vlan = ubr_vlan_new(ubr, vid, fid, 0);
 	if (IS_ERR(vlan))
 		return PTR_ERR(vlan);
 
@@ -362,24 +840,79 @@ int ubr_vlan_nl_del_cmd(struct sk_buff *skb, struct genl_info *info)
 int ubr_vlan_nl_set_cmd(struct sk_buff *skb, struct genl_info *info)
 {
 	struct nlattr *attrs[UBR_NLA_VLAN_MAX + 1];
+	struct ubr_learn_limit_cfg learn;
 	struct net_device *dev;
-	char flags[42] = "";
-	u32 learning = -1;
+	struct ubr_vlan *vlan;
+	struct ubr *ubr;
+	u32 val;
 	u16 vid;
 	int err;
 
 	err = __get_vid(info, attrs, &vid);
 	if (err)
 		return err;
-	err = __get_learning(info, attrs, &learning);
-	if (!err)
-		snprintf(flags, sizeof(flags), " learning %s", learning ? "on" : "off");
 
 	dev = ubr_netlink_dev(info);
-	printk(KERN_NOTICE "Set VLAN %u%s on %s, hello\n", vid, flags, dev->name);
-	dev_put(dev);
+	if (!dev)
+		return -EINVAL;
 
-	return 0;
+	ubr = netdev_priv(dev);
+	vlan = ubr_vlan_find(ubr, vid);
+	if (!vlan) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	/* Validate and allocate first, a failing command changes nothing */
+	if (attrs[UBR_NLA_VLAN_FID] &&
+	    nla_get_u16(attrs[UBR_NLA_VLAN_FID]) > VLAN_VID_MASK) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = ubr_learn_limit_nl_build(&vlan->learn,
+				       attrs[UBR_NLA_VLAN_LEARN_LIMIT],
+				       attrs[UBR_NLA_VLAN_LEARN_RATE],
+				       attrs[UBR_NLA_VLAN_LEARN_ACTION],
+				       &learn);
+	if (err)
+		goto out;
+
+	/* The last step that can fail, it undoes itself if it does */
+	if (attrs[UBR_NLA_VLAN_VNI]) {
+		err = ubr_tunnel_vni_set(vlan, nla_get_u32(attrs[UBR_NLA_VLAN_VNI]));
+		if (err) {
+			ubr_police_free(learn.rate);
+			goto out;
+		}
+	}
+
+	ubr_learn_limit_publish(&vlan->learn, &learn);
+	if (attrs[UBR_NLA_VLAN_FID])
+		ubr_vlan_fid_set(vlan, nla_get_u16(attrs[UBR_NLA_VLAN_FID]));
+
+	if (!__get_bool(attrs, UBR_NLA_VLAN_LEARNING, &val))
+		vlan->sa_learning = val;
+	if (!__get_bool(attrs, UBR_NLA_VLAN_FLOOD_UNICAST, &val))
+		vlan->ucflood_on = val;
+	if (!__get_bool(attrs, UBR_NLA_VLAN_FLOOD_MULTICAST, &val))
+		vlan->mcflood_on = val;
+	if (!__get_bool(attrs, UBR_NLA_VLAN_FLOOD_BROADCAST, &val))
+		vlan->bcflood_on = val;
+	if (!__get_bool(attrs, UBR_NLA_VLAN_NEIGH_SUPPRESS, &val))
+		ubr_vlan_neigh_suppress_set(vlan, val);
+
+	__vlan_flood_update(vlan);
+
+	printk(KERN_NOTICE "Set VLAN %u on %s, FID %u learning %s flood uc %s mc %s bc %s neigh-suppress %s\n",
+	       vid, dev->name, vlan->fid, vlan->sa_learning ? "on" : "off",
+	       vlan->ucflood_on ? "on" : "off",
+	       vlan->mcflood_on ? "on" : "off",
+	       vlan->bcflood_on ? "on" : "off",
+	       vlan->neigh_suppress ? "on" : "off");
+out:
+	dev_put(dev);
+	return err;
 }
 
 int ubr_vlan_nl_attach_cmd(struct sk_buff *skb, struct genl_info *info)
@@ -440,3 +973,84 @@ err:
 	dev_put(port);
 	return err;
 }
+
+static int __get_port_list(struct genl_info *info, struct ubr *ubr,
+			   struct nlattr *list, struct ubr_vec *vec)
+{
+	struct nlattr *attr;
+	int rem, pidx;
+
+	if (!list)
+		return 0;
+
+	nla_for_each_nested(attr, list, rem) {
+		if (nla_type(attr) != UBR_NLA_VLAN_PORT ||
+		    nla_len(attr) < sizeof(u32))
+			return -EINVAL;
+
+		pidx = ubr_port_find_by_ifindex(ubr, genl_info_net(info),
+						nla_get_u32(attr));
+		if (pidx < 0)
+			return pidx;
+
+		ubr_vec_set(vec, pidx);
+	}
+
+	return 0;
+}
+
+static int __vlan_nl_bulk(struct genl_info *info, bool add)
+{
+	struct nlattr *attrs[UBR_NLA_VLAN_MAX + 1];
+	struct ubr_vec untagged = {}, tagged = {};
+	struct net_device *dev;
+	struct ubr *ubr;
+	u16 vid, vid_end;
+	int err;
+
+	err = __get_vid(info, attrs, &vid);
+	if (err)
+		return err;
+
+	vid_end = vid;
+	if (attrs[UBR_NLA_VLAN_VID_END])
+		vid_end = nla_get_u16(attrs[UBR_NLA_VLAN_VID_END]);
+
+	if (vid_end < vid || vid_end >= VLAN_N_VID)
+		return -EINVAL;
+
+	dev = ubr_netlink_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	ubr = netdev_priv(dev);
+
+	err = __get_port_list(info, ubr, attrs[UBR_NLA_VLAN_PORTS], &untagged);
+	if (err)
+		goto out;
+
+	err = __get_port_list(info, ubr, attrs[UBR_NLA_VLAN_TAGGED_PORTS],
+			      &tagged);
+	if (err)
+		goto out;
+
+	printk(KERN_NOTICE "Bulk %s VLAN %u-%u on %s, %u untagged %u tagged ports\n",
+	       add ? "attach" : "detach", vid, vid_end, dev->name,
+	       bitmap_weight(untagged.bitmap, UBR_MAX_PORTS),
+	       bitmap_weight(tagged.bitmap, UBR_MAX_PORTS));
+
+	err = ubr_vlan_ports_update(ubr, vid, vid_end, &untagged, &tagged, add);
+out:
+	dev_put(dev);
+	return err;
+}
+
+int ubr_vlan_nl_bulk_attach_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	return __vlan_nl_bulk(info, true);
+}
+
+int ubr_vlan_nl_bulk_detach_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	return __vlan_nl_bulk(info, false);
+}
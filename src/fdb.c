@@ -47,12 +47,58 @@ static int cmd_fdb_flush(struct nlmsghdr *nlh, const struct cmd *cmd,
 	return msg_doit(nlh, NULL, NULL);
 }
 
+static void cmd_fdb_set_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s fdb set [pool-size N]\n", cmdl->argv[0]);
+}
+
+static int cmd_fdb_set(struct nlmsghdr *nlh, const struct cmd *cmd,
+		       struct cmdl *cmdl, void *data)
+{
+	struct nlattr *attrs;
+	struct opt opts[] = {
+		{ "pool-size",		OPT_KEYVAL,	NULL },
+		{ NULL }
+	};
+	struct opt *opt;
+	int val;
+
+	if (parse_opts(opts, cmdl) < 0) {
+		if (help_flag)
+			(cmd->help)(cmdl);
+		return -EINVAL;
+	}
+
+	nlh = msg_init(UBR_NL_FDB_SET);
+	if (!nlh) {
+		warnx("error, message initialisation failed\n");
+		return -1;
+	}
+
+	attrs = mnl_attr_nest_start(nlh, UBR_NLA_FDB);
+
+	opt = get_opt(opts, "pool-size");
+	if (opt) {
+		val = atoi(opt->val);
+		if (val < 0) {
+			warnx("invalid pool-size %s", opt->val);
+			return -EINVAL;
+		}
+		mnl_attr_put_u32(nlh, UBR_NLA_FDB_POOL_SIZE, val);
+	}
+
+	mnl_attr_nest_end(nlh, attrs);
+
+	return msg_doit(nlh, NULL, NULL);
+}
+
 void cmd_fdb_help(struct cmdl *cmdl)
 {
 	printf("Usage: %s fdb COMMAND [OPTS] ...\n"
 	       "\n"
 	       "COMMANDS\n"
-	       " flush       Set flush forwarding database\n",
+	       " flush       Set flush forwarding database\n"
+	       " set         Set forwarding database properties\n",
 	       cmdl->argv[0]);
 }
 
@@ -61,6 +107,7 @@ int cmd_fdb(struct nlmsghdr *nlh, const struct cmd *cmd, struct cmdl *cmdl,
 {
 	const struct cmd cmds[] = {
 		{ "flush",	cmd_fdb_flush,		cmd_fdb_flush_help },
+		{ "set",	cmd_fdb_set,		cmd_fdb_set_help },
 		{ NULL }
 	};
 
@@ -10,8 +10,10 @@
  *		Joachim Nilsson <troglobit@gmail.com>
  */
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <netdb.h>
 #include <errno.h>
 #include <arpa/inet.h>
@@ -24,14 +26,114 @@
 
 #include "ubr-netlink.h"
 #include "cmdl.h"
+#include "msg.h"
 #include "port.h"
 #include "private.h"
 
-#define PORT_OPTS "[pvid none|VID]"
+#define PORT_OPTS "[pvid none|VID] [learning on|off] [flood-unicast on|off]\n" \
+	"\t\t[flood-multicast on|off] [flood-broadcast on|off]\n" \
+	"\t\t[storm-unicast off|RATE] [storm-multicast off|RATE]\n" \
+	"\t\t[storm-broadcast off|RATE] [learn-limit off|N]\n" \
+	"\t\t[learn-rate off|PPS] [learn-action forward|drop|disable]\n" \
+	"\t\t[lag none|ID] [xlate VID:BVID|VID:none]"
 
 static char *ifname;
 static int ifindex;
 
+/*
+ * RATE := N{pps|kpps|mpps|bps|kbps|mbps|gbps}, or "off"
+ * Returns 0 on success with rate in packets or bits per second.
+ */
+static int parse_rate(const char *str, uint64_t *rate, int *pps)
+{
+	struct {
+		const char *unit;
+		uint64_t mult;
+		int pps;
+	} units[] = {
+		{ "pps",  1,          1 },
+		{ "kpps", 1000,       1 },
+		{ "mpps", 1000000,    1 },
+		{ "bps",  1,          0 },
+		{ "kbps", 1000,       0 },
+		{ "mbps", 1000000,    0 },
+		{ "gbps", 1000000000, 0 },
+	};
+	char *end;
+
+	if (!strcmp(str, "off")) {
+		*rate = 0;
+		*pps = 0;
+		return 0;
+	}
+
+	*rate = strtoull(str, &end, 10);
+	if (end == str)
+		return -EINVAL;
+
+	for (size_t i = 0; i < NELEMS(units); i++) {
+		if (strcasecmp(end, units[i].unit))
+			continue;
+
+		*rate *= units[i].mult;
+		*pps = units[i].pps;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static int put_storm(struct nlmsghdr *nlh, int type, const char *str)
+{
+	struct nlattr *attrs;
+	uint64_t rate;
+	int pps;
+
+	if (parse_rate(str, &rate, &pps)) {
+		warnx("invalid rate %s", str);
+		return -EINVAL;
+	}
+
+	attrs = mnl_attr_nest_start(nlh, type);
+	mnl_attr_put_u64(nlh, UBR_NLA_STORM_RATE, rate);
+	mnl_attr_put_u32(nlh, UBR_NLA_STORM_PPS, pps);
+	mnl_attr_nest_end(nlh, attrs);
+
+	return 0;
+}
+
+/* VID:BVID, or VID:none to remove the translation of VID */
+static int put_xlate(struct nlmsghdr *nlh, const char *str)
+{
+	struct nlattr *attrs;
+	long vid, bvid = 0;
+	const char *b;
+	char *end;
+
+	vid = strtol(str, &end, 10);
+	if (end == str || *end != ':')
+		goto err;
+
+	b = end + 1;
+	if (strcasecmp(b, "none")) {
+		bvid = strtol(b, &end, 10);
+		if (end == b || *end || bvid < 1 || bvid > 4094)
+			goto err;
+	}
+
+	if (vid < 1 || vid > 4094)
+		goto err;
+
+	attrs = mnl_attr_nest_start(nlh, UBR_NLA_PORT_VID_XLATE);
+	mnl_attr_put_u16(nlh, UBR_NLA_VID_XLATE_VID, vid);
+	mnl_attr_put_u16(nlh, UBR_NLA_VID_XLATE_BVID, bvid);
+	mnl_attr_nest_end(nlh, attrs);
+
+	return 0;
+err:
+	warnx("invalid xlate %s", str);
+	return -EINVAL;
+}
 
 static void cmd_port_set_help(struct cmdl *cmdl)
 {
@@ -43,9 +145,45 @@ static int cmd_port_set(struct nlmsghdr *nlh, const struct cmd *cmd,
 {
 	struct nlattr *attrs;
 	struct opt opts[] = {
-		{ "pvid",	OPT_KEYVAL,	NULL },
+		{ "pvid",		OPT_KEYVAL,	NULL },
+		{ "learning",		OPT_KEYVAL,	NULL },
+		{ "flood-unicast",	OPT_KEYVAL,	NULL },
+		{ "flood-multicast",	OPT_KEYVAL,	NULL },
+		{ "flood-broadcast",	OPT_KEYVAL,	NULL },
+		{ "storm-unicast",	OPT_KEYVAL,	NULL },
+		{ "storm-multicast",	OPT_KEYVAL,	NULL },
+		{ "storm-broadcast",	OPT_KEYVAL,	NULL },
+		{ "learn-limit",		OPT_KEYVAL,	NULL },
+		{ "learn-rate",		OPT_KEYVAL,	NULL },
+		{ "learn-action",	OPT_KEYVAL,	NULL },
+		{ "lag",		OPT_KEYVAL,	NULL },
+		{ "xlate",		OPT_KEYVAL,	NULL },
 		{ NULL }
 	};
+	struct {
+		char *key;
+		int type;
+	} bools[] = {
+		{ "learning",		UBR_NLA_PORT_LEARNING },
+		{ "flood-unicast",	UBR_NLA_PORT_FLOOD_UNICAST },
+		{ "flood-multicast",	UBR_NLA_PORT_FLOOD_MULTICAST },
+		{ "flood-broadcast",	UBR_NLA_PORT_FLOOD_BROADCAST },
+	};
+	struct {
+		char *key;
+		int type;
+	} limits[] = {
+		{ "learn-limit",	UBR_NLA_PORT_LEARN_LIMIT },
+		{ "learn-rate",		UBR_NLA_PORT_LEARN_RATE },
+	};
+	struct {
+		char *key;
+		int type;
+	} storms[] = {
+		{ "storm-unicast",	UBR_NLA_PORT_STORM_UNICAST },
+		{ "storm-multicast",	UBR_NLA_PORT_STORM_MULTICAST },
+		{ "storm-broadcast",	UBR_NLA_PORT_STORM_BROADCAST },
+	};
 	struct opt *opt;
 	int val;
 
@@ -68,6 +206,53 @@ static int cmd_port_set(struct nlmsghdr *nlh, const struct cmd *cmd,
 	if (opt && -1 != (val = atoi(opt->val)))
 		mnl_attr_put_u16(nlh, UBR_NLA_PORT_PVID, (uint16_t)val);
 
+	for (size_t i = 0; i < NELEMS(bools); i++) {
+		opt = get_opt(opts, bools[i].key);
+		if (opt && -1 != (val = atob(opt->val)))
+			mnl_attr_put_u32(nlh, bools[i].type, val);
+	}
+
+	for (size_t i = 0; i < NELEMS(limits); i++) {
+		opt = get_opt(opts, limits[i].key);
+		if (!opt)
+			continue;
+
+		if (-1 == (val = atolim(opt->val))) {
+			warnx("invalid %s %s", limits[i].key, opt->val);
+			return -EINVAL;
+		}
+		mnl_attr_put_u32(nlh, limits[i].type, val);
+	}
+
+	opt = get_opt(opts, "learn-action");
+	if (opt) {
+		if (-1 == (val = atolearn(opt->val))) {
+			warnx("invalid learn-action %s", opt->val);
+			return -EINVAL;
+		}
+		mnl_attr_put_u32(nlh, UBR_NLA_PORT_LEARN_ACTION, val);
+	}
+
+	opt = get_opt(opts, "lag");
+	if (opt) {
+		val = strcasecmp(opt->val, "none") ? atoi(opt->val) : 0;
+		if (val < 0 || val > 32) {
+			warnx("invalid lag %s", opt->val);
+			return -EINVAL;
+		}
+		mnl_attr_put_u32(nlh, UBR_NLA_PORT_LAG, val);
+	}
+
+	for (size_t i = 0; i < NELEMS(storms); i++) {
+		opt = get_opt(opts, storms[i].key);
+		if (opt && put_storm(nlh, storms[i].type, opt->val))
+			return -EINVAL;
+	}
+
+	opt = get_opt(opts, "xlate");
+	if (opt && put_xlate(nlh, opt->val))
+		return -EINVAL;
+
 	mnl_attr_nest_end(nlh, attrs);
 
 	return msg_doit(nlh, NULL, NULL);
@@ -144,6 +329,89 @@ static int cmd_port_detach(struct nlmsghdr *nlh, const struct cmd *cmd,
 	return msg_query2(nlh, NULL, NULL);
 }
 
+static void cmd_port_show_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s port IFNAME show\n", cmdl->argv[0]);
+}
+
+static int port_show_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct genlmsghdr *genl = mnl_nlmsg_get_payload(nlh);
+	struct nlattr *stats[UBR_NLA_PORT_STATS_MAX + 1] = {};
+	struct nlattr *attrs[UBR_NLA_PORT_MAX + 1] = {};
+	struct nlattr *info[UBR_NLA_MAX + 1] = {};
+	struct {
+		const char *name;
+		int type;
+	} counters[] = {
+		{ "storm-unicast drops",	UBR_NLA_PORT_STATS_STORM_UC_DROPS },
+		{ "storm-multicast drops",	UBR_NLA_PORT_STATS_STORM_MC_DROPS },
+		{ "storm-broadcast drops",	UBR_NLA_PORT_STATS_STORM_BC_DROPS },
+		{ "learned",			UBR_NLA_PORT_STATS_LEARNED },
+		{ "learn overflows",		UBR_NLA_PORT_STATS_LEARN_OVERFLOWS },
+		{ "learn pool empty",		UBR_NLA_PORT_STATS_LEARN_POOL_EMPTY },
+		{ "replication drops",		UBR_NLA_PORT_STATS_REPLICATION_DROPS },
+	};
+
+	mnl_attr_parse(nlh, sizeof(*genl), parse_attrs, info);
+	if (!info[UBR_NLA_PORT])
+		return MNL_CB_ERROR;
+
+	mnl_attr_parse_nested(info[UBR_NLA_PORT], parse_attrs, attrs);
+
+	printf("%s:\n", ifname);
+	if (attrs[UBR_NLA_PORT_PVID])
+		printf("  %-24s %u\n", "pvid",
+		       mnl_attr_get_u16(attrs[UBR_NLA_PORT_PVID]));
+	if (attrs[UBR_NLA_PORT_LEARNING])
+		printf("  %-24s %s\n", "learning",
+		       mnl_attr_get_u32(attrs[UBR_NLA_PORT_LEARNING]) ? "on" : "off");
+	if (attrs[UBR_NLA_PORT_LAG] && mnl_attr_get_u32(attrs[UBR_NLA_PORT_LAG]))
+		printf("  %-24s %u\n", "lag",
+		       mnl_attr_get_u32(attrs[UBR_NLA_PORT_LAG]));
+	if (attrs[UBR_NLA_PORT_OFFLOAD])
+		printf("  %-24s %s\n", "offload",
+		       mnl_attr_get_u32(attrs[UBR_NLA_PORT_OFFLOAD]) ? "on" : "off");
+
+	if (!attrs[UBR_NLA_PORT_STATS])
+		return MNL_CB_OK;
+
+	mnl_attr_parse_nested(attrs[UBR_NLA_PORT_STATS], parse_attrs, stats);
+	for (size_t i = 0; i < NELEMS(counters); i++) {
+		if (!stats[counters[i].type])
+			continue;
+
+		printf("  %-24s %" PRIu64 "\n", counters[i].name,
+		       mnl_attr_get_u64(stats[counters[i].type]));
+	}
+
+	return MNL_CB_OK;
+}
+
+static int cmd_port_show(struct nlmsghdr *nlh, const struct cmd *cmd,
+			 struct cmdl *cmdl, void *data)
+{
+	struct nlattr *attrs;
+
+	if (!ifname) {
+		if (help_flag)
+			cmd->help(cmdl);
+		return -EINVAL;
+	}
+
+	nlh = msg_init(UBR_NL_PORT_GET);
+	if (!nlh) {
+		warnx("error, message initialisation failed\n");
+		return -1;
+	}
+
+	attrs = mnl_attr_nest_start(nlh, UBR_NLA_PORT);
+	mnl_attr_put_u32(nlh, UBR_NLA_PORT_IFINDEX, ifindex);
+	mnl_attr_nest_end(nlh, attrs);
+
+	return msg_doit(nlh, port_show_cb, NULL);
+}
+
 void cmd_port_help(struct cmdl *cmdl)
 {
 	printf("Usage: %s port PORT-LIST COMMAND [OPTS] ...\n"
@@ -151,7 +419,8 @@ void cmd_port_help(struct cmdl *cmdl)
 	       "COMMANDS\n"
 	       " attach      Attach port(s) to bridge\n"
 	       " detach      Detach port(s) from bridge\n"
-	       " set         Set various port properties\n",
+	       " set         Set various port properties\n"
+	       " show        Show port properties and counters\n",
 	       cmdl->argv[0]);
 }
 
@@ -162,6 +431,7 @@ int cmd_port(struct nlmsghdr *nlh, const struct cmd *cmd, struct cmdl *cmdl,
 		{ "attach",	cmd_port_attach,	cmd_port_attach_help },
 		{ "detach",	cmd_port_detach,	cmd_port_detach_help },
 		{ "set",	cmd_port_set,		cmd_port_set_help },
+		{ "show",	cmd_port_show,		cmd_port_show_help },
 		{ NULL }
 	};
 
@@ -24,5 +24,7 @@ extern int brindex;
 extern int help_flag;
 
 int atob(const char *str);
+int atolim(const char *str);
+int atolearn(const char *str);
 
 #endif /* UBR_PRIVATE_H_ */
@@ -11,14 +11,17 @@
  */
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
 #include <unistd.h>
 #include <net/if.h>
+#include <linux/if_ether.h>
 #include <linux/rtnetlink.h>
 
+#include "ubr-netlink.h"
 #include "private.h"
 #include "cmdl.h"
 #include "fdb.h"
@@ -55,6 +58,38 @@ int atob(const char *str)
 	return -1;
 }
 
+/* N, or "off" for no limit */
+int atolim(const char *str)
+{
+	char *end;
+	long val;
+
+	if (!str || !strcasecmp(str, "off"))
+		return 0;
+
+	val = strtol(str, &end, 10);
+	if (end == str || *end || val < 0 || val > INT32_MAX)
+		return -1;
+
+	return (int)val;
+}
+
+int atolearn(const char *str)
+{
+	const char *alt[] = {
+		[UBR_LEARN_LIMIT_FORWARD] = "forward",
+		[UBR_LEARN_LIMIT_DROP]    = "drop",
+		[UBR_LEARN_LIMIT_DISABLE] = "disable",
+	};
+
+	for (size_t i = 0; str && i < NELEMS(alt); i++) {
+		if (!strcasecmp(alt[i], str))
+			return (int)i;
+	}
+
+	return -1;
+}
+
 static void cmd_add_help(struct cmdl *cmdl)
 {
 	printf("Usage: %s -i NAME add", cmdl->argv[0]);
@@ -111,6 +146,64 @@ static int cmd_del(struct nlmsghdr *nlh, const struct cmd *cmd,
 	return msg_query2(nlh, NULL, NULL);
 }
 
+static void cmd_set_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s [-i NAME] set [vlan-protocol 802.1q|802.1ad]\n"
+	       "\t\t[flow-cache off|N]\n", cmdl->argv[0]);
+}
+
+static int cmd_set(struct nlmsghdr *nlh, const struct cmd *cmd,
+		   struct cmdl *cmdl, void *data)
+{
+	struct nlattr *attrs;
+	struct opt opts[] = {
+		{ "vlan-protocol",	OPT_KEYVAL,	NULL },
+		{ "flow-cache",		OPT_KEYVAL,	NULL },
+		{ NULL }
+	};
+	struct opt *opt;
+	int val;
+
+	if (parse_opts(opts, cmdl) < 0) {
+		if (help_flag)
+			(cmd->help)(cmdl);
+		return -EINVAL;
+	}
+
+	nlh = msg_init(UBR_NL_BRIDGE_SET);
+	if (!nlh) {
+		warnx("error, message initialisation failed\n");
+		return -1;
+	}
+
+	attrs = mnl_attr_nest_start(nlh, UBR_NLA_BRIDGE);
+
+	opt = get_opt(opts, "vlan-protocol");
+	if (opt) {
+		if (!strcasecmp(opt->val, "802.1q")) {
+			mnl_attr_put_u16(nlh, UBR_NLA_BRIDGE_VLAN_PROTO, ETH_P_8021Q);
+		} else if (!strcasecmp(opt->val, "802.1ad")) {
+			mnl_attr_put_u16(nlh, UBR_NLA_BRIDGE_VLAN_PROTO, ETH_P_8021AD);
+		} else {
+			warnx("invalid vlan-protocol %s", opt->val);
+			return -EINVAL;
+		}
+	}
+
+	opt = get_opt(opts, "flow-cache");
+	if (opt) {
+		if (-1 == (val = atolim(opt->val))) {
+			warnx("invalid flow-cache %s", opt->val);
+			return -EINVAL;
+		}
+		mnl_attr_put_u32(nlh, UBR_NLA_BRIDGE_FLOW_CACHE, val);
+	}
+
+	mnl_attr_nest_end(nlh, attrs);
+
+	return msg_doit(nlh, NULL, NULL);
+}
+
 static void about(struct cmdl *cmdl)
 {
 	printf("Usage: %s [OPTIONS] COMMAND [ARGS] ...\n"
@@ -123,6 +216,7 @@ static void about(struct cmdl *cmdl)
 	       "Commands:\n"
 	       " add                 Create a new bridge\n"
 	       " del                 Delete a bridge\n"
+	       " set                 Set bridge properties\n"
 	       " fdb                 Manage forwarding (MAC) database\n"
 	       " port PORT           Manage bridge ports\n"
 	       " vlan VID            Manage bridge VLANs\n",
@@ -134,6 +228,7 @@ int main(int argc, char *argv[])
 	const struct cmd cmds[] = {
 		{ "add",        cmd_add,        cmd_add_help  },
 		{ "del",        cmd_del,        cmd_del_help  },
+		{ "set",        cmd_set,        cmd_set_help  },
 		{ "fdb",        cmd_fdb,        cmd_fdb_help  },
 		{ "port",       cmd_port,       cmd_port_help },
 		{ "vlan",       cmd_vlan,       cmd_vlan_help },
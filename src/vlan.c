@@ -12,10 +12,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <netdb.h>
 #include <errno.h>
 #include <arpa/inet.h>
 #include <net/if.h>
+#include <netinet/ether.h>
 
 #include <linux/genetlink.h>
 
@@ -27,25 +29,112 @@
 #include "vlan.h"
 #include "private.h"
 
-#define VLAN_OPTS "[learning on|off] "
+#define VLAN_OPTS "[fid FID] [learning on|off] [flood-unicast on|off]\n" \
+	"\t\t[flood-multicast on|off] [flood-broadcast on|off]\n" \
+	"\t\t[neigh-suppress on|off] [vni off|VNI]\n" \
+	"\t\t[learn-limit off|N] [learn-rate off|PPS]\n" \
+	"\t\t[learn-action forward|drop|disable]"
 
 
 static uint16_t vid = 0;
+static uint16_t vid_end = 0;
+
+/*
+ * Add a nested list of port ifindexes, PORT-LIST is whitespace separated.
+ * Returns number of ports added, or -EINVAL on unknown interface.
+ */
+static int put_port_list(struct nlmsghdr *nlh, int type, char *list)
+{
+	struct nlattr *attrs;
+	char *ifname, *buf;
+	int ifindex;
+	int num = 0;
+
+	buf = strdup(list);
+	if (!buf)
+		return -ENOMEM;
+
+	attrs = mnl_attr_nest_start(nlh, type);
+	for (ifname = strtok(buf, " \t"); ifname; ifname = strtok(NULL, " \t")) {
+		ifindex = if_nametoindex(ifname);
+		if (!ifindex) {
+			warn("%s is not a valid interface", ifname);
+			free(buf);
+			return -EINVAL;
+		}
+
+		mnl_attr_put_u32(nlh, UBR_NLA_VLAN_PORT, ifindex);
+		num++;
+	}
+	mnl_attr_nest_end(nlh, attrs);
+	free(buf);
+
+	return num;
+}
 
 
 static void cmd_vlan_add_help(struct cmdl *cmdl)
 {
-	printf("Usage: %s vlan VID add [protocol VLAN-PROTO] "
+	printf("Usage: %s vlan VID add [protocol VLAN-PROTO] [fid FID] "
 	       "[set %s]\n", cmdl->argv[0], VLAN_OPTS);
 }
 
+/* FID N, VLANs sharing a FID share learned addresses */
+static int put_fid(struct nlmsghdr *nlh, struct opt *opts)
+{
+	struct opt *opt;
+	char *end;
+	long fid;
+
+	opt = get_opt(opts, "fid");
+	if (!opt)
+		return 0;
+
+	fid = strtol(opt->val, &end, 10);
+	if (end == opt->val || *end || fid < 0 || fid > 4095) {
+		warnx("invalid fid %s", opt->val);
+		return -EINVAL;
+	}
+
+	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_FID, (uint16_t)fid);
+	return 0;
+}
+
+static int put_vni(struct nlmsghdr *nlh, struct opt *opts)
+{
+	struct opt *opt;
+	char *end;
+	long vni;
+
+	opt = get_opt(opts, "vni");
+	if (!opt)
+		return 0;
+
+	if (!strcmp(opt->val, "off")) {
+		vni = 0;
+	} else {
+		vni = strtol(opt->val, &end, 10);
+		if (end == opt->val || *end || vni < 1 || vni > 0xffffff) {
+			warnx("invalid vni %s", opt->val);
+			return -EINVAL;
+		}
+	}
+
+	mnl_attr_put_u32(nlh, UBR_NLA_VLAN_VNI, (uint32_t)vni);
+	return 0;
+}
+
 static int cmd_vlan_add(struct nlmsghdr *nlh, const struct cmd *cmd,
 			  struct cmdl *cmdl, void *data)
 {
 	struct nlattr *attrs;
+	struct opt opts[] = {
+		{ "fid",		OPT_KEYVAL,	NULL },
+		{ NULL }
+	};
 	int err;
 
-	if (!vid) {
+	if (!vid || vid != vid_end || parse_opts(opts, cmdl) < 0) {
 		if (help_flag)
 			cmd->help(cmdl);
 		return -EINVAL;
@@ -59,6 +148,9 @@ static int cmd_vlan_add(struct nlmsghdr *nlh, const struct cmd *cmd,
 
 	attrs = mnl_attr_nest_start(nlh, UBR_NLA_VLAN);
 	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_VID, (uint16_t)vid);
+	err = put_fid(nlh, opts);
+	if (err)
+		return err;
 	mnl_attr_nest_end(nlh, attrs);
 
 	return msg_doit(nlh, NULL, NULL);
@@ -75,7 +167,7 @@ static int cmd_vlan_del(struct nlmsghdr *nlh, const struct cmd *cmd,
 	struct nlattr *attrs;
 	int err;
 
-	if (!vid) {
+	if (!vid || vid != vid_end) {
 		if (help_flag)
 			cmd->help(cmdl);
 		return -EINVAL;
@@ -96,7 +188,7 @@ static int cmd_vlan_del(struct nlmsghdr *nlh, const struct cmd *cmd,
 
 static void cmd_vlan_attach_help(struct cmdl *cmdl)
 {
-	printf("Usage: %s vlan VID attach PORT-LIST [tagged]\n",
+	printf("Usage: %s vlan VID[-VID] attach PORT-LIST [tagged]\n",
 	       cmdl->argv[0]);
 }
 
@@ -108,10 +200,7 @@ static int cmd_vlan_attach(struct nlmsghdr *nlh, const struct cmd *cmd,
 		{ "tagged",		OPT_KEY,	NULL },
 		{ NULL }
 	};
-	struct opt *opt;
-	char *ifname;
-	int ifindex;
-	int tagged = 0;
+	char *ports;
 	int err;
 
 	if (!vid) {
@@ -122,32 +211,29 @@ static int cmd_vlan_attach(struct nlmsghdr *nlh, const struct cmd *cmd,
 	}
 
 	/* Read port name(s), required argument */
-	ifname = shift_cmdl(cmdl);
-	if (!ifname) {
+	ports = shift_cmdl(cmdl);
+	if (!ports) {
 		cmd->help(cmdl);
 		return -EINVAL;
 	}
 
-	ifindex = if_nametoindex(ifname);
-	if (!ifindex) {
-		warn("%s is not a valid interface", ifname);
-		return -EINVAL;
-	}
-
 	if (parse_opts(opts, cmdl) < 0)
 		goto err;
 
-	nlh = msg_init(UBR_NL_VLAN_ATTACH);
+	nlh = msg_init(UBR_NL_VLAN_BULK_ATTACH);
 	if (!nlh) {
 		warnx("error, message initialisation failed\n");
 		return -1;
 	}
 
 	attrs = mnl_attr_nest_start(nlh, UBR_NLA_VLAN);
-	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_VID, (uint16_t)vid);
-	tagged = has_opt(opts, "tagged");
-	mnl_attr_put_u32(nlh, UBR_NLA_VLAN_TAGGED, tagged);
-	mnl_attr_put_u32(nlh, UBR_NLA_VLAN_PORT, ifindex);
+	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_VID, vid);
+	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_VID_END, vid_end);
+	err = put_port_list(nlh, has_opt(opts, "tagged") ?
+			    UBR_NLA_VLAN_TAGGED_PORTS : UBR_NLA_VLAN_PORTS,
+			    ports);
+	if (err < 0)
+		return err;
 	mnl_attr_nest_end(nlh, attrs);
 
 	return msg_doit(nlh, NULL, NULL);
@@ -156,7 +242,7 @@ static int cmd_vlan_attach(struct nlmsghdr *nlh, const struct cmd *cmd,
 
 static void cmd_vlan_detach_help(struct cmdl *cmdl)
 {
-	printf("Usage: %s vlan VID detach PORT-LIST [tagged]",
+	printf("Usage: %s vlan VID[-VID] detach PORT-LIST\n",
 	       cmdl->argv[0]);
 }
 
@@ -164,8 +250,7 @@ static int cmd_vlan_detach(struct nlmsghdr *nlh, const struct cmd *cmd,
 			   struct cmdl *cmdl, void *data)
 {
 	struct nlattr *attrs;
-	char *ifname;
-	int ifindex;
+	char *ports;
 	int err;
 
 	if (!vid) {
@@ -175,27 +260,24 @@ static int cmd_vlan_detach(struct nlmsghdr *nlh, const struct cmd *cmd,
 	}
 
 	/* Read port name(s), required argument */
-	ifname = shift_cmdl(cmdl);
-	if (!ifname) {
+	ports = shift_cmdl(cmdl);
+	if (!ports) {
 		cmd->help(cmdl);
 		return -EINVAL;
 	}
 
-	ifindex = if_nametoindex(ifname);
-	if (!ifindex) {
-		warn("%s is not a valid interface", ifname);
-		return -EINVAL;
-	}
-
-	nlh = msg_init(UBR_NL_VLAN_DETACH);
+	nlh = msg_init(UBR_NL_VLAN_BULK_DETACH);
 	if (!nlh) {
 		warnx("error, message initialisation failed\n");
 		return -1;
 	}
 
 	attrs = mnl_attr_nest_start(nlh, UBR_NLA_VLAN);
-	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_VID, (uint16_t)vid);
-	mnl_attr_put_u32(nlh, UBR_NLA_VLAN_PORT, ifindex);
+	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_VID, vid);
+	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_VID_END, vid_end);
+	err = put_port_list(nlh, UBR_NLA_VLAN_PORTS, ports);
+	if (err < 0)
+		return err;
 	mnl_attr_nest_end(nlh, attrs);
 
 	return msg_doit(nlh, NULL, NULL);
@@ -211,13 +293,39 @@ static int cmd_vlan_set(struct nlmsghdr *nlh, const struct cmd *cmd,
 {
 	struct nlattr *attrs;
 	struct opt opts[] = {
+		{ "fid",		OPT_KEYVAL,	NULL },
 		{ "learning",		OPT_KEYVAL,	NULL },
+		{ "flood-unicast",	OPT_KEYVAL,	NULL },
+		{ "flood-multicast",	OPT_KEYVAL,	NULL },
+		{ "flood-broadcast",	OPT_KEYVAL,	NULL },
+		{ "neigh-suppress",	OPT_KEYVAL,	NULL },
+		{ "vni",		OPT_KEYVAL,	NULL },
+		{ "learn-limit",		OPT_KEYVAL,	NULL },
+		{ "learn-rate",		OPT_KEYVAL,	NULL },
+		{ "learn-action",	OPT_KEYVAL,	NULL },
 		{ NULL }
 	};
+	struct {
+		char *key;
+		int type;
+	} bools[] = {
+		{ "learning",		UBR_NLA_VLAN_LEARNING },
+		{ "flood-unicast",	UBR_NLA_VLAN_FLOOD_UNICAST },
+		{ "flood-multicast",	UBR_NLA_VLAN_FLOOD_MULTICAST },
+		{ "flood-broadcast",	UBR_NLA_VLAN_FLOOD_BROADCAST },
+		{ "neigh-suppress",	UBR_NLA_VLAN_NEIGH_SUPPRESS },
+	};
+	struct {
+		char *key;
+		int type;
+	} limits[] = {
+		{ "learn-limit",	UBR_NLA_VLAN_LEARN_LIMIT },
+		{ "learn-rate",		UBR_NLA_VLAN_LEARN_RATE },
+	};
 	struct opt *opt;
 	int val;
 
-	if (!vid || parse_opts(opts, cmdl) < 0) {
+	if (!vid || vid != vid_end || parse_opts(opts, cmdl) < 0) {
 		if (help_flag)
 			(cmd->help)(cmdl);
 		return -EINVAL;
@@ -232,15 +340,276 @@ static int cmd_vlan_set(struct nlmsghdr *nlh, const struct cmd *cmd,
 	attrs = mnl_attr_nest_start(nlh, UBR_NLA_VLAN);
 	mnl_attr_put_u16(nlh, UBR_NLA_VLAN_VID, (uint16_t)vid);
 
-	opt = get_opt(opts, "learning");
-	if (opt && -1 != (val = atob(opt->val)))
-		mnl_attr_put_u32(nlh, UBR_NLA_VLAN_LEARNING, val);
+	for (size_t i = 0; i < NELEMS(bools); i++) {
+		opt = get_opt(opts, bools[i].key);
+		if (opt && -1 != (val = atob(opt->val)))
+			mnl_attr_put_u32(nlh, bools[i].type, val);
+	}
+
+	for (size_t i = 0; i < NELEMS(limits); i++) {
+		opt = get_opt(opts, limits[i].key);
+		if (!opt)
+			continue;
+
+		if (-1 == (val = atolim(opt->val))) {
+			warnx("invalid %s %s", limits[i].key, opt->val);
+			return -EINVAL;
+		}
+		mnl_attr_put_u32(nlh, limits[i].type, val);
+	}
+
+	opt = get_opt(opts, "learn-action");
+	if (opt) {
+		if (-1 == (val = atolearn(opt->val))) {
+			warnx("invalid learn-action %s", opt->val);
+			return -EINVAL;
+		}
+		mnl_attr_put_u32(nlh, UBR_NLA_VLAN_LEARN_ACTION, val);
+	}
+
+	if (put_fid(nlh, opts) || put_vni(nlh, opts))
+		return -EINVAL;
 
 	mnl_attr_nest_end(nlh, attrs);
 
 	return msg_doit(nlh, NULL, NULL);
 }
 
+/*
+ * Put the nested neighbour key, ADDR is an IPv4 or IPv6 address.
+ * Returns the nest, or NULL on invalid address.
+ */
+static struct nlattr *put_neigh(struct nlmsghdr *nlh, const char *addr)
+{
+	struct nlattr *attrs;
+	struct in6_addr ip6;
+	struct in_addr ip4;
+
+	attrs = mnl_attr_nest_start(nlh, UBR_NLA_NEIGH);
+	mnl_attr_put_u16(nlh, UBR_NLA_NEIGH_VID, vid);
+
+	if (inet_pton(AF_INET, addr, &ip4) == 1)
+		mnl_attr_put_u32(nlh, UBR_NLA_NEIGH_IP4, ip4.s_addr);
+	else if (inet_pton(AF_INET6, addr, &ip6) == 1)
+		mnl_attr_put(nlh, UBR_NLA_NEIGH_IP6, sizeof(ip6), &ip6);
+	else {
+		warnx("invalid address %s", addr);
+		return NULL;
+	}
+
+	return attrs;
+}
+
+static void cmd_vlan_neigh_add_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s vlan VID neigh add ADDR lladdr MAC\n",
+	       cmdl->argv[0]);
+}
+
+static int cmd_vlan_neigh_add(struct nlmsghdr *nlh, const struct cmd *cmd,
+			      struct cmdl *cmdl, void *data)
+{
+	struct nlattr *attrs;
+	struct opt opts[] = {
+		{ "lladdr",		OPT_KEYVAL,	NULL },
+		{ NULL }
+	};
+	struct ether_addr *mac;
+	struct opt *opt;
+	char *addr;
+
+	addr = shift_cmdl(cmdl);
+	if (!vid || vid != vid_end || !addr || parse_opts(opts, cmdl) < 0 ||
+	    !(opt = get_opt(opts, "lladdr"))) {
+		cmd->help(cmdl);
+		return -EINVAL;
+	}
+
+	mac = ether_aton(opt->val);
+	if (!mac) {
+		warnx("invalid lladdr %s", opt->val);
+		return -EINVAL;
+	}
+
+	nlh = msg_init(UBR_NL_NEIGH_ADD);
+	if (!nlh) {
+		warnx("error, message initialisation failed\n");
+		return -1;
+	}
+
+	attrs = put_neigh(nlh, addr);
+	if (!attrs)
+		return -EINVAL;
+	mnl_attr_put(nlh, UBR_NLA_NEIGH_LLADDR, ETH_ALEN, mac);
+	mnl_attr_nest_end(nlh, attrs);
+
+	return msg_doit(nlh, NULL, NULL);
+}
+
+static void cmd_vlan_neigh_del_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s vlan VID neigh del ADDR\n", cmdl->argv[0]);
+}
+
+static int cmd_vlan_neigh_del(struct nlmsghdr *nlh, const struct cmd *cmd,
+			      struct cmdl *cmdl, void *data)
+{
+	struct nlattr *attrs;
+	char *addr;
+
+	addr = shift_cmdl(cmdl);
+	if (!vid || vid != vid_end || !addr) {
+		cmd->help(cmdl);
+		return -EINVAL;
+	}
+
+	nlh = msg_init(UBR_NL_NEIGH_DEL);
+	if (!nlh) {
+		warnx("error, message initialisation failed\n");
+		return -1;
+	}
+
+	attrs = put_neigh(nlh, addr);
+	if (!attrs)
+		return -EINVAL;
+	mnl_attr_nest_end(nlh, attrs);
+
+	return msg_doit(nlh, NULL, NULL);
+}
+
+static void cmd_vlan_neigh_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s vlan VID neigh COMMAND [OPTS] ...\n"
+	       "\n"
+	       "COMMANDS\n"
+	       " add         Add static neighbour for ARP/ND suppression\n"
+	       " del         Remove neighbour\n",
+	       cmdl->argv[0]);
+}
+
+static int cmd_vlan_neigh(struct nlmsghdr *nlh, const struct cmd *cmd,
+			  struct cmdl *cmdl, void *data)
+{
+	const struct cmd cmds[] = {
+		{ "add",	cmd_vlan_neigh_add,	cmd_vlan_neigh_add_help },
+		{ "del",	cmd_vlan_neigh_del,	cmd_vlan_neigh_del_help },
+		{ NULL }
+	};
+
+	return run_cmd(nlh, cmd, cmds, cmdl, NULL);
+}
+
+/*
+ * Put the nested tunnel endpoint, ADDR is an IPv4 or IPv6 address.
+ * Returns the nest, or NULL on invalid address.
+ */
+static struct nlattr *put_remote(struct nlmsghdr *nlh, const char *addr)
+{
+	struct nlattr *attrs;
+	struct in6_addr ip6;
+	struct in_addr ip4;
+
+	attrs = mnl_attr_nest_start(nlh, UBR_NLA_REMOTE);
+	mnl_attr_put_u16(nlh, UBR_NLA_REMOTE_VID, vid);
+
+	if (inet_pton(AF_INET, addr, &ip4) == 1)
+		mnl_attr_put_u32(nlh, UBR_NLA_REMOTE_IP4, ip4.s_addr);
+	else if (inet_pton(AF_INET6, addr, &ip6) == 1)
+		mnl_attr_put(nlh, UBR_NLA_REMOTE_IP6, sizeof(ip6), &ip6);
+	else {
+		warnx("invalid address %s", addr);
+		return NULL;
+	}
+
+	return attrs;
+}
+
+static int vlan_remote(struct nlmsghdr *nlh, const struct cmd *cmd,
+		       struct cmdl *cmdl, int type)
+{
+	struct nlattr *attrs;
+	struct opt opts[] = {
+		{ "lladdr",		OPT_KEYVAL,	NULL },
+		{ NULL }
+	};
+	struct ether_addr *mac = NULL;
+	struct opt *opt;
+	char *addr;
+
+	addr = shift_cmdl(cmdl);
+	if (!vid || vid != vid_end || !addr || parse_opts(opts, cmdl) < 0) {
+		cmd->help(cmdl);
+		return -EINVAL;
+	}
+
+	opt = get_opt(opts, "lladdr");
+	if (opt && !(mac = ether_aton(opt->val))) {
+		warnx("invalid lladdr %s", opt->val);
+		return -EINVAL;
+	}
+
+	nlh = msg_init(type);
+	if (!nlh) {
+		warnx("error, message initialisation failed\n");
+		return -1;
+	}
+
+	attrs = put_remote(nlh, addr);
+	if (!attrs)
+		return -EINVAL;
+	if (mac)
+		mnl_attr_put(nlh, UBR_NLA_REMOTE_LLADDR, ETH_ALEN, mac);
+	mnl_attr_nest_end(nlh, attrs);
+
+	return msg_doit(nlh, NULL, NULL);
+}
+
+static void cmd_vlan_remote_add_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s vlan VID remote add ADDR [lladdr MAC]\n",
+	       cmdl->argv[0]);
+}
+
+static int cmd_vlan_remote_add(struct nlmsghdr *nlh, const struct cmd *cmd,
+			       struct cmdl *cmdl, void *data)
+{
+	return vlan_remote(nlh, cmd, cmdl, UBR_NL_REMOTE_ADD);
+}
+
+static void cmd_vlan_remote_del_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s vlan VID remote del ADDR [lladdr MAC]\n",
+	       cmdl->argv[0]);
+}
+
+static int cmd_vlan_remote_del(struct nlmsghdr *nlh, const struct cmd *cmd,
+			       struct cmdl *cmdl, void *data)
+{
+	return vlan_remote(nlh, cmd, cmdl, UBR_NL_REMOTE_DEL);
+}
+
+static void cmd_vlan_remote_help(struct cmdl *cmdl)
+{
+	printf("Usage: %s vlan VID remote COMMAND [OPTS] ...\n"
+	       "\n"
+	       "COMMANDS\n"
+	       " add         Add tunnel endpoint, or address behind one\n"
+	       " del         Remove tunnel endpoint, or address behind one\n",
+	       cmdl->argv[0]);
+}
+
+static int cmd_vlan_remote(struct nlmsghdr *nlh, const struct cmd *cmd,
+			   struct cmdl *cmdl, void *data)
+{
+	const struct cmd cmds[] = {
+		{ "add",	cmd_vlan_remote_add,	cmd_vlan_remote_add_help },
+		{ "del",	cmd_vlan_remote_del,	cmd_vlan_remote_del_help },
+		{ NULL }
+	};
+
+	return run_cmd(nlh, cmd, cmds, cmdl, NULL);
+}
+
 void cmd_vlan_help(struct cmdl *cmdl)
 {
 	printf("Usage: %s vlan VID COMMAND [OPTS] ...\n"
@@ -250,7 +619,9 @@ void cmd_vlan_help(struct cmdl *cmdl)
 	       " del         Remove VLAN from bridge\n"
 	       " attach      Attach port(s) to VLAN\n"
 	       " detach      Detach port(s) from VLAN\n"
-	       " set         Set various VLAN properties\n",
+	       " set         Set various VLAN properties\n"
+	       " neigh       Manage neighbours for ARP/ND suppression\n"
+	       " remote      Manage VXLAN tunnel endpoints\n",
 	       cmdl->argv[0]);
 }
 
@@ -263,27 +634,37 @@ int cmd_vlan(struct nlmsghdr *nlh, const struct cmd *cmd, struct cmdl *cmdl,
 		{ "attach",	cmd_vlan_attach,	cmd_vlan_attach_help },
 		{ "detach",	cmd_vlan_detach,	cmd_vlan_detach_help },
 		{ "set",	cmd_vlan_set,		cmd_vlan_set_help },
+		{ "neigh",	cmd_vlan_neigh,		cmd_vlan_neigh_help },
+		{ "remote",	cmd_vlan_remote,	cmd_vlan_remote_help },
 		{ NULL }
 	};
-	char *arg;
+	char *arg, *end;
 	int val;
 
 	if (help_flag)
 		goto cont;
 
-	/* Read VLAN id, required argument */
+	/* Read VLAN id, or range of VLAN ids, required argument */
 	arg = shift_cmdl(cmdl);
 	if (!arg) {
 		cmd_vlan_help(cmdl);
 		return -EINVAL;
 	}
 
-	val = atoi(arg);
+	val = strtol(arg, &end, 10);
 	if (val < 0 || val > UINT16_MAX)
 		val = 0;
 
-	vid = (uint16_t)val;
-	if (vid < 1 || vid > 4095) {
+	vid = vid_end = (uint16_t)val;
+	if (*end == '-') {
+		val = atoi(end + 1);
+		if (val < 0 || val > UINT16_MAX)
+			val = 0;
+
+		vid_end = (uint16_t)val;
+	}
+
+	if (vid < 1 || vid > 4095 || vid_end < vid || vid_end > 4095) {
 		warnx("error, invalid VLAN %s\n", arg);
 		return -EINVAL;
 	}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Compare benchmark results against a baseline, both as written by
+# bench.sh.  Fails if any Mpps figure drops, or any round-trip time
+# grows, by more than TOLERANCE percent.
+#
+# Usage: bench-cmp.sh BASELINE RESULTS [TOLERANCE]
+
+baseline=$1
+results=$2
+tolerance=${3:-10}
+
+if [ ! -s "$results" ]; then
+    echo "bench: no results in $results"
+    exit 1
+fi
+
+if [ ! -f "$baseline" ]; then
+    echo "bench: no baseline, see 'make bench-baseline'"
+    exit 0
+fi
+
+awk -v tol=$tolerance '
+function field(line, key,    re, v) {
+    re = "\"" key "\":\"?[^,}\"]*";
+    if (!match(line, re))
+	return "";
+    v = substr(line, RSTART, RLENGTH);
+    sub("\"" key "\":\"?", "", v);
+    return v;
+}
+
+function key(line) {
+    return field(line, "workload") "/" field(line, "ports") "/" field(line, "fdb");
+}
+
+NR == FNR {
+    base_mpps[key($0)] = field($0, "mpps");
+    base_rtt[key($0)]  = field($0, "rtt_us");
+    next;
+}
+
+{
+    k = key($0);
+    if (!(k in base_mpps)) {
+	printf("%-28s new\n", k);
+	next;
+    }
+
+    if ((cur = field($0, "mpps")) != "" && base_mpps[k] > 0) {
+	diff = (cur - base_mpps[k]) * 100 / base_mpps[k];
+	bad = diff < -tol;
+	printf("%-28s %8.3f Mpps (%+.1f%%)%s\n", k, cur, diff, bad ? " REGRESSION" : "");
+    } else if ((cur = field($0, "rtt_us")) != "" && base_rtt[k] > 0) {
+	diff = (cur - base_rtt[k]) * 100 / base_rtt[k];
+	bad = diff > tol;
+	printf("%-28s %8.1f us   (%+.1f%%)%s\n", k, cur, diff, bad ? " REGRESSION" : "");
+    } else {
+	bad = 0;
+    }
+
+    fail += bad;
+}
+
+END { exit fail ? 1 : 0; }
+' "$baseline" "$results"
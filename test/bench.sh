@@ -0,0 +1,273 @@
+#!/bin/sh
+# Forwarding benchmarks, started by uml-bench.sh
+#
+# Frames are generated with pktgen on the outside end of a veth pair,
+# so they enter the bridge through the regular rx_handler path.  Each
+# result is written as one JSON object per line to $UBR_BENCH_OUT:
+#
+#   workload    unicast, flood, trunk, learning or latency
+#   ports       number of bridge ports, excluding the bridge itself
+#   fdb         number of FDB entries (unicast), or addresses (learning)
+#   learned     FDB entries reported by the ingress port after prefill
+#   in_pps      frames/s accepted by the ingress port
+#   out_pps     frames/s transmitted by all egress ports together
+#   mpps        in_pps in millions, the number to watch for regressions
+#   ns_per_pkt  average time spent per ingress frame at saturation
+#   rtt_us      average ping round-trip time across the bridge (latency)
+#
+# Lists are comma separated, since they are passed on the kernel
+# command line.
+
+UBR_BENCH_PORTS=${UBR_BENCH_PORTS:-2,16,64,255}
+UBR_BENCH_FDB=${UBR_BENCH_FDB:-1000,10000,100000,1000000}
+UBR_BENCH_TIME=${UBR_BENCH_TIME:-5}
+UBR_BENCH_OUT=${UBR_BENCH_OUT:-/bench.jsonl}
+
+br=ubr-bench-p0
+pg=/proc/net/pktgen
+
+# Station on p1 sending the traffic, and the one on p2 receiving it
+sa=02:be:00:00:00:01
+da=02:be:00:00:00:02
+
+trap 'exit 1' INT HUP QUIT TERM ALRM USR1
+trap 'cleanup' EXIT
+
+list() {
+    echo $1 | tr ',' ' '
+}
+
+ports() {
+    seq 1 $nports
+}
+
+ubr_cmd() {
+    ubr -i $br "$@"
+}
+
+cleanup() {
+    [ -e $pg/pgctrl ] && echo stop >$pg/pgctrl 2>/dev/null
+    ip netns del ubr-bench 2>/dev/null
+
+    for iface in $(cat /proc/net/dev | awk -F: '/ubr-bench/ { print($1); }'); do
+	ip link del dev $iface 2>/dev/null
+    done
+}
+
+setup() {
+    nports=$1
+
+    ip link add dev $br type ubr
+    ip link set dev $br up
+
+    for i in $(ports); do
+	ip link add dev ubr-bench-p$i type veth peer name ubr-bench-b$i
+	ip link set dev ubr-bench-b$i master $br
+	ip link set dev ubr-bench-b$i up
+	ip link set dev ubr-bench-p$i up
+    done
+
+    # Learning in the prefill should not be limited by pool refills
+    ubr_cmd fdb set pool-size 65536
+}
+
+# Centiseconds since boot
+now() {
+    awk '{ printf("%u\n", $1 * 100); }' /proc/uptime
+}
+
+rx() {
+    cat /sys/class/net/$1/statistics/rx_packets
+}
+
+# Frames sent out of the bridge, i.e. received by all port peers but p1
+out() {
+    local sum=0
+
+    for i in $(ports); do
+	[ $i -eq 1 ] && continue
+	sum=$(($sum + $(rx ubr-bench-p$i)))
+    done
+
+    echo $sum
+}
+
+pgset() {
+    if ! echo "$2" >$1; then
+	echo "pktgen: $1: $2: failed"
+	exit 1
+    fi
+}
+
+# pgdev IFACE [KEY VAL]...
+pgdev() {
+    local dev=$1
+    shift
+
+    pgset $pg/kpktgend_0 "rem_device_all"
+    pgset $pg/kpktgend_0 "add_device $dev"
+
+    pgset $pg/$dev "count 0"
+    pgset $pg/$dev "clone_skb 0"
+    pgset $pg/$dev "pkt_size 60"
+    pgset $pg/$dev "delay 0"
+    pgset $pg/$dev "vlan_id 65535"
+
+    while [ "$#" -gt 1 ]; do
+	pgset $pg/$dev "$1 $2"
+	shift 2
+    done
+}
+
+# Run the configured pktgen device until its count is reached
+pgrun() {
+    pgset $pg/pgctrl "start"
+}
+
+# Run the configured pktgen device for UBR_BENCH_TIME seconds
+pgrun_timed() {
+    echo start >$pg/pgctrl &
+    sleep $UBR_BENCH_TIME
+    pgset $pg/pgctrl "stop"
+    wait
+}
+
+result() {
+    local workload=$1 fdb=$2 learned=$3 in=$4 out=$5 cs=$6
+
+    awk -v w=$workload -v p=$nports -v f=$fdb -v l=$learned \
+	-v i=$in -v o=$out -v cs=$cs 'BEGIN {
+	    s = cs / 100;
+	    ipps = s ? i / s : 0;
+	    opps = s ? o / s : 0;
+	    printf("{\"workload\":\"%s\",\"ports\":%u,\"fdb\":%u,\"learned\":%u," \
+		   "\"in_pps\":%u,\"out_pps\":%u,\"mpps\":%.3f,\"ns_per_pkt\":%.1f}\n",
+		   w, p, f, l, ipps, opps, ipps / 1000000,
+		   ipps ? 1000000000 / ipps : 0);
+	}' | tee -a $UBR_BENCH_OUT
+}
+
+# measure WORKLOAD FDB LEARNED [PKTGEN-ARGS]...
+measure() {
+    local workload=$1 fdb=$2 learned=$3
+    shift 3
+
+    pgdev ubr-bench-p1 "$@"
+
+    local in0=$(rx ubr-bench-b1) out0=$(out) t0=$(now)
+    pgrun_timed
+    local in1=$(rx ubr-bench-b1) out1=$(out) t1=$(now)
+
+    result $workload $fdb $learned $(($in1 - $in0)) $(($out1 - $out0)) $(($t1 - $t0))
+}
+
+# learned PORT, FDB entries accounted to a bridge port
+learned() {
+    ubr_cmd port $1 show | awk '/learned/ { print($2); }'
+}
+
+# Teach the bridge where the stations are, $da and N addresses
+# counting up from $da on p2, and $sa on p1.  All frames are sent to
+# a station on the same port, so nothing is flooded during prefill.
+prefill() {
+    local n=$1
+
+    pgdev ubr-bench-p1 count 1 src_mac $sa dst_mac ff:ff:ff:ff:ff:ff
+    pgrun
+    pgdev ubr-bench-p2 count 1 src_mac $da dst_mac ff:ff:ff:ff:ff:ff
+    pgrun
+    pgdev ubr-bench-p2 count $n src_mac $da src_mac_count $n dst_mac $da
+    pgrun
+}
+
+bench_unicast() {
+    local n
+
+    for n in $(list $UBR_BENCH_FDB); do
+	setup $2
+	prefill $n
+	measure unicast $n $(learned ubr-bench-b2) \
+		src_mac $sa dst_mac $da dst_mac_count $n
+	cleanup
+    done
+}
+
+bench_flood() {
+    setup $2
+    prefill 1
+    measure flood 0 0 src_mac $sa dst_mac ff:ff:ff:ff:ff:ff
+    cleanup
+}
+
+# VLAN trunk, all ports are tagged members of VLAN 10.  The PVID
+# turns on VLAN filtering, without it frames stay in VLAN 0.
+bench_trunk() {
+    setup $2
+    ubr_cmd vlan 10 add
+    ubr_cmd vlan 10 attach "$(for i in $(ports); do printf "ubr-bench-b$i "; done)" tagged
+    for i in $(ports); do
+	ubr_cmd port ubr-bench-b$i set pvid 10
+	if ! ubr_cmd port ubr-bench-b$i show | grep -qE "pvid +10$"; then
+	    echo "trunk: ubr-bench-b$i: VLAN filtering not enabled"
+	    exit 1
+	fi
+    done
+    prefill 1
+    measure trunk 0 0 src_mac $sa dst_mac ff:ff:ff:ff:ff:ff vlan_id 10
+    cleanup
+}
+
+# Every frame carries a new source address, all sent to $sa on the
+# ingress port itself so only learning is measured.
+bench_learning() {
+    local n in0 t0
+
+    for n in $(list $UBR_BENCH_FDB); do
+	setup $2
+	prefill 1
+	pgdev ubr-bench-p1 count $n src_mac 02:bf:00:00:00:00 src_mac_count $n \
+	      dst_mac $sa
+
+	in0=$(rx ubr-bench-b1)
+	t0=$(now)
+	pgrun
+	result learning $n $(learned ubr-bench-b1) \
+	       $(($(rx ubr-bench-b1) - $in0)) 0 $(($(now) - $t0))
+	cleanup
+    done
+}
+
+# Idle round-trip time, from the bridge to a station on the last port
+bench_latency() {
+    local rtt
+
+    setup $2
+    ip netns add ubr-bench
+    ip link set dev ubr-bench-p$nports netns ubr-bench
+    ip -n ubr-bench addr add 10.255.0.2/24 dev ubr-bench-p$nports
+    ip -n ubr-bench link set dev ubr-bench-p$nports up
+    ip addr add 10.255.0.1/24 dev $br
+
+    rtt=$(ping -c 10 -q 10.255.0.2 | awk '/round-trip|rtt/ { split($0, a, "= "); split(a[2], v, "/"); print(v[2]); }')
+    printf '{"workload":"latency","ports":%u,"fdb":0,"rtt_us":%s}\n' \
+	   $nports $(awk -v ms=${rtt:-0} 'BEGIN { printf("%.1f", ms * 1000); }') \
+	| tee -a $UBR_BENCH_OUT
+    cleanup
+}
+
+mkdir -p /sys
+mountpoint -q /sys || mount -t sysfs sysfs /sys
+
+if [ ! -e $pg/pgctrl ]; then
+    echo "pktgen not available, enable CONFIG_NET_PKTGEN"
+    exit 1
+fi
+
+truncate -s 0 $UBR_BENCH_OUT
+
+for n in $(list $UBR_BENCH_PORTS); do
+    for workload in latency flood trunk unicast learning; do
+	echo "bench: $workload, $n ports"
+	bench_$workload $workload $n
+    done
+done
@@ -0,0 +1,771 @@
+/*
+ * ubr-replay	Run pcap traces through the forwarding pipeline.
+ *
+ *		The pipeline stages in ubr-vlan.c, ubr-fdb.c, ubr-police.c
+ *		and ubr-forward.c are built unmodified against the shim in
+ *		ubr-shim.h, so they can be profiled with regular userspace
+ *		tools, e.g. perf or valgrind --tool=cachegrind.
+ *
+ *		Each capture file is the ingress of one bridge port, the
+ *		first one is port 1.  Frames from all files are replayed
+ *		in timestamp order, which also drives FDB ageing and the
+ *		storm/learning policers.  For every frame, the ports it
+ *		leaves the bridge on are printed.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "ubr-netlink.h"
+#include "ubr-private.h"
+
+#define PCAP_MAGIC	0xa1b2c3d4
+#define PCAP_MAGIC_NS	0xa1b23c4d
+#define LINKTYPE_ETHERNET 1
+
+/* Room for the tags pushed on egress, and IP header alignment */
+#define REPLAY_HEADROOM	64
+#define NET_IP_ALIGN	2
+
+struct pcap_hdr {
+	u32 magic;
+	u16 major;
+	u16 minor;
+	s32 thiszone;
+	u32 sigfigs;
+	u32 snaplen;
+	u32 linktype;
+};
+
+struct pcap_rec {
+	u32 ts_sec;
+	u32 ts_frac;
+	u32 caplen;
+	u32 len;
+};
+
+struct frame {
+	u64 ns;
+	unsigned int port;
+	unsigned int seq;
+	unsigned int len;
+	u8 *data;
+};
+
+/* One per port the frame left the bridge on */
+struct egress {
+	unsigned int pidx;
+	int vid;		/* -1 when untagged */
+};
+
+static struct ubr *ubr;
+static struct net_device devs[UBR_MAX_PORTS];
+static unsigned int nports;
+
+static struct frame *frames;
+static size_t nframes;
+
+static struct egress out[UBR_MAX_PORTS];
+static unsigned int nout;
+
+static const char *prognm;
+static int inline_tags;
+static int provider;
+static int neigh_suppress;
+
+static void usage(int rc)
+{
+	fprintf(rc ? stderr : stdout,
+		"Usage: %s [OPTIONS] PCAP [PCAP...]\n"
+		"\n"
+		"Replays each PCAP as the ingress of bridge port 1, 2, ...\n"
+		"\n"
+		"Options:\n"
+		" -a                   802.1ad provider bridge, S-tags classify and\n"
+		"                      C-tags are passed through\n"
+		" -n PORTS             Number of bridge ports, default one per PCAP\n"
+		" -v VID[:FID]=PORTS[/PORTS]\n"
+		"                      Add VLAN with untagged[/tagged] member ports,\n"
+		"                      PORTS is a list, e.g. 1,2,5-8.  VLANs with\n"
+		"                      the same FID share learned addresses\n"
+		" -P PORT=PVID         Set port VLAN ID, enables VLAN filtering\n"
+		" -x PORT=VID:BVID     Translate VID on PORT to bridge VID BVID,\n"
+		"                      and back on egress, may be repeated\n"
+		" -L PORTS             Aggregate PORTS into one link aggregation\n"
+		"                      group, may be repeated\n"
+		" -l PORTS             Ports with learning disabled\n"
+		" -N                   ARP/ND suppression on all VLANs\n"
+		" -I                   Leave VLAN tags in the payload on ingress, as\n"
+		"                      for frames sent by the host\n"
+		" -S PORTS             Ports without VLAN TX offload, tags are\n"
+		"                      inserted in software on egress\n"
+		" -s SIZE              FDB node pool size, 0 to allocate from slab\n"
+		" -F SIZE              Flow cache entries, default off\n"
+		" -r COUNT             Replay the traces COUNT times, for profiling\n"
+		" -q                   Quiet, only show the summary\n"
+		" -d                   Show kernel log messages\n"
+		" -h                   Show this help text\n"
+		"\n"
+		"For each frame: NUM PORT VID SRC > DST: EGRESS, where EGRESS is a\n"
+		"list of ports, PORT.VID when tagged, or drop/trap.  Port 0 is the\n"
+		"bridge itself.\n", prognm);
+	exit(rc);
+}
+
+static void die(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2), noreturn));
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", prognm);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+/* Symbols from ubr-port.c and ubr-netlink.c, the harness does not
+ * speak netlink so none of the configuration handlers can be reached.
+ */
+struct net_device *ubr_netlink_dev(struct genl_info *info)
+{
+	return NULL;
+}
+
+void *ubr_netlink_put_reply(struct sk_buff *msg, struct genl_info *info)
+{
+	return NULL;
+}
+
+int ubr_port_find(struct ubr *ubr, struct net_device *dev)
+{
+	return dev->ifindex < (int)nports ? dev->ifindex : -ENODEV;
+}
+
+int ubr_port_find_by_ifindex(struct ubr *ubr, struct net *net, u32 ifindex)
+{
+	return ifindex < nports ? (int)ifindex : -ENODEV;
+}
+
+/* Offloads are fixed at startup, see port_sw_tagging() */
+void ubr_port_update_offloads(struct ubr_port *p)
+{
+}
+
+/* Delivery, the device ifindex is the port index */
+static void replay_egress(struct sk_buff *skb)
+{
+	struct egress *e = &out[nout++];
+
+	e->pidx = skb->dev->ifindex;
+	e->vid = -1;
+	if (skb_vlan_tag_present(skb)) {
+		e->vid = skb_vlan_tag_get_id(skb);
+	} else if (eth_type_vlan(skb->protocol)) {
+		struct vlan_ethhdr *veth = (void *)skb_mac_header(skb);
+
+		e->vid = ntohs(veth->h_vlan_TCI) & VLAN_VID_MASK;
+	}
+
+	kfree_skb(skb);
+}
+
+int netif_receive_skb(struct sk_buff *skb)
+{
+	replay_egress(skb);
+	return 0;
+}
+
+int dev_queue_xmit(struct sk_buff *skb)
+{
+	replay_egress(skb);
+	return 0;
+}
+
+/* pcap files */
+static u32 pcap32(u32 val, bool swap)
+{
+	return swap ? __builtin_bswap32(val) : val;
+}
+
+static void pcap_load(const char *file, unsigned int port)
+{
+	struct pcap_rec rec;
+	struct pcap_hdr hdr;
+	unsigned int seq = 0;
+	bool swap, ns;
+	FILE *fp;
+
+	fp = fopen(file, "r");
+	if (!fp)
+		die("%s: %s", file, strerror(errno));
+
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1)
+		die("%s: not a pcap file", file);
+
+	swap = hdr.magic == __builtin_bswap32(PCAP_MAGIC) ||
+	       hdr.magic == __builtin_bswap32(PCAP_MAGIC_NS);
+	ns = pcap32(hdr.magic, swap) == PCAP_MAGIC_NS;
+	if (pcap32(hdr.magic, swap) != PCAP_MAGIC && !ns)
+		die("%s: not a pcap file, pcapng can be converted with "
+		    "'editcap -F pcap'", file);
+
+	if (pcap32(hdr.linktype, swap) != LINKTYPE_ETHERNET)
+		die("%s: link type %u, only Ethernet is supported", file,
+		    pcap32(hdr.linktype, swap));
+
+	while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+		struct frame *f;
+
+		if (!(nframes & (nframes + 1))) {
+			frames = realloc(frames, (nframes + 1) * 2 * sizeof(*f));
+			if (!frames)
+				die("out of memory");
+		}
+
+		f = &frames[nframes];
+		f->port = port;
+		f->seq = seq++;
+		f->len = pcap32(rec.caplen, swap);
+		f->ns = pcap32(rec.ts_sec, swap) * NSEC_PER_SEC +
+			pcap32(rec.ts_frac, swap) * (ns ? 1 : 1000);
+
+		f->data = malloc(f->len);
+		if (!f->data)
+			die("out of memory");
+
+		if (fread(f->data, f->len, 1, fp) != 1)
+			die("%s: truncated frame %u", file, f->seq);
+
+		/* Runts cannot be classified, skip them */
+		if (f->len < ETH_HLEN) {
+			free(f->data);
+			continue;
+		}
+
+		nframes++;
+	}
+
+	fclose(fp);
+}
+
+static int frame_cmp(const void *a, const void *b)
+{
+	const struct frame *fa = a, *fb = b;
+
+	if (fa->ns != fb->ns)
+		return fa->ns < fb->ns ? -1 : 1;
+	if (fa->port != fb->port)
+		return fa->port < fb->port ? -1 : 1;
+
+	return fa->seq < fb->seq ? -1 : fa->seq > fb->seq;
+}
+
+/* Bridge and port setup, mirrors ubr_dev_newlink() and ubr_port_init() */
+static void port_init(unsigned int pidx)
+{
+	struct ubr_port *p = &ubr->ports[pidx];
+	struct ubr_cb *cb = &p->ingress_cb;
+	struct net_device *dev = &devs[pidx];
+
+	snprintf(dev->name, sizeof(dev->name), pidx ? "p%u" : "ubr0", pidx);
+	dev->ifindex = pidx;
+	dev->priv = ubr;
+	dev->dev_addr[0] = 0x02;
+	dev->dev_addr[5] = pidx;
+
+	p->dev = dev;
+	cb->pidx = pidx;
+	cb->lpidx = pidx;
+
+	p->stats = netdev_alloc_pcpu_stats(struct ubr_port_stats);
+	if (!p->stats || ubr_learn_limit_init(&p->learn))
+		die("out of memory");
+
+	cb->sa_learning = 1;
+	ubr_pipeline_update(cb);
+	ubr_vec_fill(&cb->vec);
+	ubr_vec_clear(&cb->vec, pidx);
+
+	cb->vlan = ubr_vlan_find(ubr, 0);
+	if (ubr_vlan_port_add(cb->vlan, pidx, 0))
+		die("port %u: failed joining VLAN 0", pidx);
+
+	ubr_vec_set(&ubr->busy, pidx);
+	ubr_vec_set(&ubr->active, pidx);
+}
+
+static void bridge_init(void)
+{
+	unsigned int pidx;
+
+	ubr = calloc(1, sizeof(*ubr));
+	if (!ubr || ubr_fdb_cache_init())
+		die("out of memory");
+
+	ubr->dev = &devs[0];
+	ubr->vlan_proto = provider ? ETH_P_8021AD : ETH_P_8021Q;
+	hash_init(ubr->vlans);
+	hash_init(ubr->stps);
+
+	ubr_vec_fill(&ubr->ucflood);
+	ubr_vec_fill(&ubr->mcflood);
+	ubr_vec_fill(&ubr->bcflood);
+
+	if (ubr_fdb_newlink(&ubr->fdb) || ubr_neigh_newlink(&ubr->neigh) ||
+	    ubr_vlan_newlink(ubr))
+		die("failed creating bridge");
+
+	for (pidx = 0; pidx < nports; pidx++)
+		port_init(pidx);
+}
+
+static void bridge_fini(void)
+{
+	unsigned int pidx;
+
+	ubr_vlan_dellink(ubr);
+	ubr_neigh_dellink(&ubr->neigh);
+	ubr_fdb_dellink(&ubr->fdb);
+
+	for (pidx = 0; pidx < nports; pidx++) {
+		ubr_learn_limit_destroy(&ubr->ports[pidx].learn);
+		free_percpu(ubr->ports[pidx].stats);
+		kfree(rcu_access_pointer(ubr->ports[pidx].xlate));
+	}
+
+	ubr_flow_cache_set(ubr, 0);
+	shim_quiesce();
+	ubr_fdb_cache_fini();
+	kfree(rcu_access_pointer(ubr->lags));
+	free(ubr);
+}
+
+/* PORTS, e.g. 1,2,5-8 */
+static char *parse_ports(char *str, struct ubr_vec *vec)
+{
+	unsigned long lo, hi;
+	char *end;
+
+	while (*str && *str != '/') {
+		lo = hi = strtoul(str, &end, 10);
+		if (*end == '-')
+			hi = strtoul(end + 1, &end, 10);
+
+		if (end == str || lo > hi || hi >= nports)
+			die("invalid port list '%s', ports are 0-%u",
+			    str, nports - 1);
+
+		for (; lo <= hi; lo++)
+			ubr_vec_set(vec, lo);
+
+		str = end;
+		if (*str == ',')
+			str++;
+	}
+
+	return str;
+}
+
+/* VID[:FID]=UNTAGGED[/TAGGED] */
+static void vlan_add(char *arg)
+{
+	struct ubr_vec untagged = {}, tagged = {};
+	struct ubr_vlan *vlan;
+	unsigned long vid, fid;
+	char *end;
+
+	vid = fid = strtoul(arg, &end, 10);
+	if (*end == ':')
+		fid = strtoul(end + 1, &end, 10);
+	if (*end != '=' || !vid || vid >= VLAN_N_VID || fid >= VLAN_N_VID)
+		die("invalid VLAN '%s', expected VID[:FID]=PORTS[/PORTS]", arg);
+
+	end = parse_ports(end + 1, &untagged);
+	if (*end == '/')
+		parse_ports(end + 1, &tagged);
+
+	vlan = ubr_vlan_new(ubr, vid, fid, 0);
+	if (IS_ERR(vlan))
+		die("VLAN %lu: %s", vid, strerror(-PTR_ERR(vlan)));
+
+	if (ubr_vlan_ports_update(ubr, vid, vid, &untagged, &tagged, true))
+		die("VLAN %lu: failed adding ports", vid);
+}
+
+/* Each call forms a new group */
+static void port_lag(char *arg)
+{
+	static unsigned int id;
+	struct ubr_vec ports = {};
+	unsigned int pidx;
+
+	if (*parse_ports(arg, &ports) || ubr_vec_test(&ports, 0))
+		die("invalid LAG port list '%s'", arg);
+	if (++id > UBR_MAX_LAGS)
+		die("at most %u LAGs are supported", UBR_MAX_LAGS);
+
+	ubr_vec_foreach(&ports, pidx) {
+		if (ubr_lag_port_set(&ubr->ports[pidx], id))
+			die("port %u: failed joining LAG %u", pidx, id);
+	}
+}
+
+/* As ubr_port_nl_set_cmd() with UBR_NLA_PORT_LEARNING off */
+static void port_no_learning(char *arg)
+{
+	struct ubr_vec ports = {};
+	unsigned int pidx;
+
+	if (*parse_ports(arg, &ports))
+		die("invalid port list '%s'", arg);
+
+	ubr_vec_foreach(&ports, pidx) {
+		ubr->ports[pidx].ingress_cb.sa_learning = 0;
+		ubr_pipeline_update(&ubr->ports[pidx].ingress_cb);
+	}
+}
+
+static void port_sw_tagging(char *arg)
+{
+	struct ubr_vec ports = {};
+
+	if (*parse_ports(arg, &ports))
+		die("invalid port list '%s'", arg);
+
+	/* As ubr_port_update_offloads(), the bridge itself always
+	 * offloads, and all ports do by default.
+	 */
+	ubr_vec_clear(&ports, 0);
+	ubr_vec_or(&ubr->sw_tagging, &ports);
+}
+
+/* As ubr_vlan_nl_set_cmd() with UBR_NLA_VLAN_NEIGH_SUPPRESS */
+static void vlan_neigh_suppress(void)
+{
+	struct ubr_vlan *vlan;
+	int bkt;
+
+	hash_for_each(ubr->vlans, bkt, vlan, node)
+		ubr_vlan_neigh_suppress_set(vlan, true);
+}
+
+/* PORT=PVID, as ubr_port_nl_set_cmd() */
+static void port_pvid(char *arg)
+{
+	unsigned long pidx, pvid;
+	struct ubr_port *p;
+	char *end;
+
+	pidx = strtoul(arg, &end, 10);
+	if (*end != '=' || pidx >= nports)
+		die("invalid PVID '%s', expected PORT=PVID", arg);
+
+	pvid = strtoul(end + 1, &end, 10);
+	if (*end || pvid >= VLAN_N_VID)
+		die("invalid PVID '%s', expected PORT=PVID", arg);
+
+	p = &ubr->ports[pidx];
+	p->pvid = pvid;
+	p->ingress_cb.vlan = ubr_vlan_find(ubr, pvid);
+	p->ingress_cb.vlan_filtering = !!pvid;
+	ubr_pipeline_update(&p->ingress_cb);
+}
+
+/* PORT=VID:BVID, as ubr_port_nl_set_cmd() */
+static void port_xlate(char *arg)
+{
+	unsigned long pidx, vid, bvid;
+	char *end;
+
+	pidx = strtoul(arg, &end, 10);
+	if (*end != '=' || pidx >= nports)
+		goto err;
+
+	vid = strtoul(end + 1, &end, 10);
+	if (*end != ':')
+		goto err;
+
+	bvid = strtoul(end + 1, &end, 10);
+	if (*end || vid >= VLAN_N_VID || bvid >= VLAN_N_VID)
+		goto err;
+
+	if (ubr_vlan_xlate_set(&ubr->ports[pidx], vid, bvid))
+		die("port %lu: failed translating VID %lu to %lu",
+		    pidx, vid, bvid);
+
+	return;
+err:
+	die("invalid translation '%s', expected PORT=VID:BVID", arg);
+}
+
+/* What eth_type_trans() and __netif_receive_skb_core() do before
+ * the rx_handler, and then the handler itself.
+ */
+static struct sk_buff *replay_skb(const struct frame *f)
+{
+	struct ubr_port *p = &ubr->ports[f->port];
+	struct sk_buff *skb;
+
+	skb = alloc_skb(REPLAY_HEADROOM + NET_IP_ALIGN + f->len, GFP_ATOMIC);
+	if (!skb)
+		die("out of memory");
+
+	skb->data += REPLAY_HEADROOM + NET_IP_ALIGN;
+	memcpy(skb->data, f->data, f->len);
+	skb->len = f->len;
+	skb->dev = p->dev;
+
+	skb_reset_mac_header(skb);
+	skb->protocol = eth_hdr(skb)->h_proto;
+	if (is_broadcast_ether_addr(eth_hdr(skb)->h_dest))
+		skb->pkt_type = PACKET_BROADCAST;
+	else if (is_multicast_ether_addr(eth_hdr(skb)->h_dest))
+		skb->pkt_type = PACKET_MULTICAST;
+	else
+		skb->pkt_type = PACKET_OTHERHOST;
+
+	skb_pull(skb, ETH_HLEN);
+	skb_reset_network_header(skb);
+	skb_reset_mac_len(skb);
+
+	if (eth_type_vlan(skb->protocol) && !inline_tags)
+		skb = skb_vlan_untag(skb);
+
+	memcpy(ubr_cb(skb), &p->ingress_cb, sizeof(struct ubr_cb));
+	return skb;
+}
+
+static void print_mac(const u8 *mac)
+{
+	printf("%02x:%02x:%02x:%02x:%02x:%02x",
+	       mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+static int egress_cmp(const void *a, const void *b)
+{
+	const struct egress *ea = a, *eb = b;
+
+	return (int)ea->pidx - (int)eb->pidx;
+}
+
+static void print_frame(size_t num, const struct frame *f, int vid, bool trap)
+{
+	const struct ethhdr *eth = (const struct ethhdr *)f->data;
+	unsigned int i;
+
+	/* Delivery order is an implementation detail, keep diffs stable */
+	qsort(out, nout, sizeof(*out), egress_cmp);
+
+	printf("%zu %u ", num, f->port);
+	if (vid < 0)
+		printf("- ");
+	else
+		printf("%d ", vid);
+
+	print_mac(eth->h_source);
+	printf(" > ");
+	print_mac(eth->h_dest);
+	printf(":");
+
+	if (trap)
+		printf(" trap");
+	else if (!nout)
+		printf(" drop");
+
+	for (i = 0; i < nout; i++) {
+		printf(" %u", out[i].pidx);
+		if (out[i].vid >= 0)
+			printf(".%d", out[i].vid);
+	}
+
+	putchar('\n');
+}
+
+static u64 elapsed_ns(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * NSEC_PER_SEC +
+		t1->tv_nsec - t0->tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long drops = 0, traps = 0, count = 1, pool = ULONG_MAX;
+	unsigned long flows = 0;
+	char **vlans, **pvids, **lags, **xlates, *swtag = NULL, *nolearn = NULL;
+	int c, nvlans = 0, npvids = 0, nlags = 0, nxlates = 0, quiet = 0;
+	u64 span = 0, busy = 0;
+	unsigned long iter;
+	size_t i;
+
+	prognm = argv[0];
+	vlans = calloc(argc, sizeof(*vlans));
+	pvids = calloc(argc, sizeof(*pvids));
+	lags = calloc(argc, sizeof(*lags));
+	xlates = calloc(argc, sizeof(*xlates));
+	if (!vlans || !pvids || !lags || !xlates)
+		die("out of memory");
+
+	while ((c = getopt(argc, argv, "adF:hIl:L:n:NP:qr:s:S:v:x:")) != -1) {
+		switch (c) {
+		case 'a':
+			provider = 1;
+			break;
+		case 'd':
+			shim_verbose = 1;
+			break;
+		case 'F':
+			flows = strtoul(optarg, NULL, 10);
+			break;
+		case 'h':
+			usage(0);
+		case 'I':
+			inline_tags = 1;
+			break;
+		case 'l':
+			nolearn = optarg;
+			break;
+		case 'L':
+			lags[nlags++] = optarg;
+			break;
+		case 'n':
+			nports = strtoul(optarg, NULL, 10) + 1;
+			break;
+		case 'N':
+			neigh_suppress = 1;
+			break;
+		case 'P':
+			pvids[npvids++] = optarg;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'r':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			pool = strtoul(optarg, NULL, 10);
+			break;
+		case 'S':
+			swtag = optarg;
+			break;
+		case 'v':
+			vlans[nvlans++] = optarg;
+			break;
+		case 'x':
+			xlates[nxlates++] = optarg;
+			break;
+		default:
+			usage(1);
+		}
+	}
+
+	if (optind >= argc)
+		usage(1);
+
+	for (c = optind; c < argc; c++)
+		pcap_load(argv[c], c - optind + 1);
+
+	if (nports < (unsigned int)(argc - optind + 1))
+		nports = argc - optind + 1;
+	if (nports > UBR_MAX_PORTS)
+		die("at most %u ports are supported", UBR_MAX_PORTS - 1);
+
+	qsort(frames, nframes, sizeof(*frames), frame_cmp);
+	if (nframes)
+		span = frames[nframes - 1].ns - frames[0].ns + 1;
+
+	bridge_init();
+
+	/* VLANs first, so a PVID always finds its VLAN */
+	for (c = 0; c < nvlans; c++)
+		vlan_add(vlans[c]);
+	for (c = 0; c < npvids; c++)
+		port_pvid(pvids[c]);
+	for (c = 0; c < nxlates; c++)
+		port_xlate(xlates[c]);
+	if (swtag)
+		port_sw_tagging(swtag);
+	if (nolearn)
+		port_no_learning(nolearn);
+	for (c = 0; c < nlags; c++)
+		port_lag(lags[c]);
+	if (neigh_suppress)
+		vlan_neigh_suppress();
+
+	if (pool != ULONG_MAX && ubr_fdb_pool_resize(&ubr->fdb, pool))
+		die("invalid FDB pool size %lu", pool);
+	if (flows && ubr_flow_cache_set(ubr, flows))
+		die("invalid flow cache size %lu", flows);
+
+	for (iter = 0; iter < count; iter++) {
+		for (i = 0; i < nframes; i++) {
+			const struct frame *f = &frames[i];
+			struct timespec t0, t1;
+			struct sk_buff *skb;
+			int vid = -1;
+			bool trap;
+
+			/* Later runs continue where the previous one ended */
+			shim_set_time(f->ns - frames[0].ns + iter * span);
+
+			skb = replay_skb(f);
+			if (skb_vlan_tag_present(skb))
+				vid = skb_vlan_tag_get_id(skb);
+			else if (eth_type_vlan(skb->protocol))
+				vid = ntohs(*(__be16 *)skb->data) & VLAN_VID_MASK;
+
+			nout = 0;
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			rcu_read_lock();
+			skb = ubr_forward(ubr, skb);
+			trap = skb;
+			rcu_read_unlock();
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			busy += elapsed_ns(&t0, &t1);
+
+			/* The host stack would take it from here */
+			if (trap) {
+				kfree_skb(skb);
+				traps++;
+			} else if (!nout) {
+				drops++;
+			}
+
+			if (!quiet)
+				print_frame(iter * nframes + i + 1, f, vid, trap);
+
+			shim_quiesce();
+		}
+	}
+
+	fflush(stdout);
+	fprintf(stderr, "%lu frames, %lu dropped, %lu trapped, %u ports, "
+		"%u FDB entries\n", count * nframes, drops, traps, nports - 1,
+		ubr->fdb.nodes.nelems);
+	if (count && nframes)
+		fprintf(stderr, "%.3f ms in pipeline, %.1f ns/frame, %.3f Mpps\n",
+			busy / 1e6, (double)busy / (count * nframes),
+			busy ? count * nframes * 1e3 / busy : 0);
+
+	bridge_fini();
+
+	for (i = 0; i < nframes; i++)
+		free(frames[i].data);
+	free(frames);
+	free(vlans);
+	free(pvids);
+	free(lags);
+	free(xlates);
+
+	return 0;
+}
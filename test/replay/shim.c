@@ -0,0 +1,587 @@
+/*
+ * Userspace implementations of the kernel APIs declared in ubr-shim.h
+ * that are too large to be inline.
+ */
+#include "ubr-shim.h"
+
+int shim_verbose;
+
+unsigned long jiffies;
+u64 shim_now_ns;
+
+struct net init_net;
+
+struct workqueue_struct *system_wq;
+struct workqueue_struct *system_long_wq;
+
+static struct rcu_head *rcu_pending;
+static struct work_struct *work_pending;
+static struct delayed_work *dwork_pending;
+
+/* Deferred kfree_rcu() objects, linked through their own rcu_head */
+struct shim_kfree {
+	struct rcu_head rcu;
+	void *ptr;
+};
+
+void shim_set_time(u64 ns)
+{
+	if (ns < shim_now_ns)
+		return;
+
+	shim_now_ns = ns;
+	jiffies = ns / NSEC_PER_MSEC;
+}
+
+/* RCU */
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head))
+{
+	head->func = func;
+	head->next = rcu_pending;
+	rcu_pending = head;
+}
+
+static void shim_kfree_rcu_cb(struct rcu_head *head)
+{
+	struct shim_kfree *kf = container_of(head, struct shim_kfree, rcu);
+
+	free(kf->ptr);
+	free(kf);
+}
+
+void shim_kfree_rcu(void *ptr, struct rcu_head *head)
+{
+	struct shim_kfree *kf = malloc(sizeof(*kf));
+
+	if (!kf)
+		abort();
+
+	kf->ptr = ptr;
+	call_rcu(&kf->rcu, shim_kfree_rcu_cb);
+}
+
+/* Every call site is outside of a read section, so a grace period
+ * has always elapsed.  Callbacks may queue new ones, keep going
+ * until there are none left.
+ */
+void rcu_barrier(void)
+{
+	struct rcu_head *head, *next;
+
+	while ((head = rcu_pending)) {
+		rcu_pending = NULL;
+
+		for (; head; head = next) {
+			next = head->next;
+			head->func(head);
+		}
+	}
+}
+
+void synchronize_rcu(void)
+{
+}
+
+/* Work queues */
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work)
+{
+	if (work->pending)
+		return false;
+
+	work->pending = true;
+	work->next = work_pending;
+	work_pending = work;
+	return true;
+}
+
+bool schedule_work(struct work_struct *work)
+{
+	return queue_work(system_wq, work);
+}
+
+static void work_unlink(struct work_struct *work)
+{
+	struct work_struct **pp;
+
+	for (pp = &work_pending; *pp; pp = &(*pp)->next) {
+		if (*pp == work) {
+			*pp = work->next;
+			break;
+		}
+	}
+
+	work->pending = false;
+}
+
+bool cancel_work_sync(struct work_struct *work)
+{
+	bool pending = work->pending;
+
+	if (pending)
+		work_unlink(work);
+
+	return pending;
+}
+
+bool queue_delayed_work(struct workqueue_struct *wq, struct delayed_work *dw,
+			unsigned long delay)
+{
+	if (dw->queued)
+		return false;
+
+	dw->queued = true;
+	dw->expires = jiffies + delay;
+	dw->next = dwork_pending;
+	dwork_pending = dw;
+	return true;
+}
+
+bool cancel_delayed_work_sync(struct delayed_work *dw)
+{
+	struct delayed_work **pp;
+
+	if (!dw->queued)
+		return false;
+
+	for (pp = &dwork_pending; *pp; pp = &(*pp)->next) {
+		if (*pp == dw) {
+			*pp = dw->next;
+			break;
+		}
+	}
+
+	dw->queued = false;
+	return true;
+}
+
+static bool shim_run_work(void)
+{
+	struct delayed_work **pp, *dw;
+	struct work_struct *work;
+	bool ran = false;
+
+	while ((work = work_pending)) {
+		work_unlink(work);
+		work->func(work);
+		ran = true;
+	}
+
+	for (pp = &dwork_pending; (dw = *pp); ) {
+		if (time_before(jiffies, dw->expires)) {
+			pp = &dw->next;
+			continue;
+		}
+
+		*pp = dw->next;
+		dw->queued = false;
+		dw->work.func(&dw->work);
+		ran = true;
+
+		/* The callback may have requeued itself at the head */
+		pp = &dwork_pending;
+	}
+
+	return ran;
+}
+
+/* Called by the driver between frames, i.e. outside of any read
+ * section, to run everything the data path deferred.
+ */
+void shim_quiesce(void)
+{
+	do {
+		rcu_barrier();
+	} while (shim_run_work());
+}
+
+/* Slab */
+
+struct kmem_cache *kmem_cache_create(const char *name, unsigned int size,
+				     unsigned int align, unsigned int flags,
+				     void (*ctor)(void *))
+{
+	struct kmem_cache *c = malloc(sizeof(*c));
+
+	if (c)
+		c->size = size;
+
+	return c;
+}
+
+void kmem_cache_destroy(struct kmem_cache *c)
+{
+	free(c);
+}
+
+/* Network devices, the driver owns them */
+
+struct net_device *dev_get_by_index(struct net *net, int ifindex)
+{
+	return NULL;
+}
+
+struct net_device *dev_get_by_index_rcu(struct net *net, int ifindex)
+{
+	return NULL;
+}
+
+/* Resizable hash tables */
+
+static u32 rht_hashfn(const struct rhashtable *ht, const void *key)
+{
+	const u8 *p = key;
+	u32 h = 2166136261u;
+	u16 i;
+
+	for (i = 0; i < ht->p.key_len; i++)
+		h = (h ^ p[i]) * 16777619u;
+
+	return h;
+}
+
+#define rht_hash(ht, key) (rht_hashfn((ht), (key)) & ((ht)->size - 1))
+
+#define rht_obj(ht, he)  ((char *)(he) - (ht)->p.head_offset)
+#define rht_key(ht, obj) ((char *)(obj) + (ht)->p.key_offset)
+
+static int rht_alloc(struct rhashtable *ht, unsigned int size)
+{
+	struct rhash_head **buckets, *he, *next;
+	unsigned int i;
+	u32 hash;
+
+	buckets = calloc(size, sizeof(*buckets));
+	if (!buckets)
+		return -ENOMEM;
+
+	for (i = 0; i < ht->size; i++) {
+		for (he = ht->buckets[i]; he; he = next) {
+			next = he->next;
+			hash = rht_hashfn(ht, rht_key(ht, rht_obj(ht, he)));
+			hash &= size - 1;
+			he->next = buckets[hash];
+			buckets[hash] = he;
+		}
+	}
+
+	free(ht->buckets);
+	ht->buckets = buckets;
+	ht->size = size;
+	return 0;
+}
+
+int rhashtable_init(struct rhashtable *ht, const struct rhashtable_params *params)
+{
+	memset(ht, 0, sizeof(*ht));
+	ht->p = *params;
+	return rht_alloc(ht, 64);
+}
+
+void rhashtable_destroy(struct rhashtable *ht)
+{
+	free(ht->buckets);
+	ht->buckets = NULL;
+	ht->size = 0;
+}
+
+void *rhashtable_lookup(struct rhashtable *ht, const void *key,
+			const struct rhashtable_params params)
+{
+	struct rhash_head *he;
+
+	for (he = ht->buckets[rht_hash(ht, key)]; he; he = he->next) {
+		char *obj = rht_obj(ht, he);
+
+		if (!memcmp(rht_key(ht, obj), key, ht->p.key_len))
+			return obj;
+	}
+
+	return NULL;
+}
+
+int rhashtable_lookup_insert_fast(struct rhashtable *ht, struct rhash_head *obj,
+				  const struct rhashtable_params params)
+{
+	const void *key = rht_key(ht, rht_obj(ht, obj));
+	u32 hash;
+
+	if (rhashtable_lookup(ht, key, params))
+		return -EEXIST;
+
+	/* Same load factor as the kernel, grow at 75% */
+	if (ht->nelems + 1 > ht->size / 4 * 3 && rht_alloc(ht, ht->size * 2))
+		return -ENOMEM;
+
+	hash = rht_hash(ht, key);
+	obj->next = ht->buckets[hash];
+	ht->buckets[hash] = obj;
+	ht->nelems++;
+	return 0;
+}
+
+int rhashtable_remove_fast(struct rhashtable *ht, struct rhash_head *obj,
+			   const struct rhashtable_params params)
+{
+	struct rhash_head **pp;
+
+	pp = &ht->buckets[rht_hash(ht, rht_key(ht, rht_obj(ht, obj)))];
+	for (; *pp; pp = &(*pp)->next) {
+		if (*pp == obj) {
+			*pp = obj->next;
+			ht->nelems--;
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+void rhashtable_walk_enter(struct rhashtable *ht, struct rhashtable_iter *iter)
+{
+	iter->ht = ht;
+	iter->bucket = 0;
+	iter->next = ht->size ? ht->buckets[0] : NULL;
+}
+
+/* The successor is read before returning an object, so the caller
+ * may remove it from the table before asking for the next one.
+ */
+void *rhashtable_walk_next(struct rhashtable_iter *iter)
+{
+	struct rhashtable *ht = iter->ht;
+	struct rhash_head *he;
+
+	while (!iter->next) {
+		if (++iter->bucket >= ht->size)
+			return NULL;
+
+		iter->next = ht->buckets[iter->bucket];
+	}
+
+	he = iter->next;
+	iter->next = he->next;
+	return rht_obj(ht, he);
+}
+
+/* Socket buffers */
+
+struct sk_buff *alloc_skb(unsigned int size, gfp_t gfp)
+{
+	struct sk_buff *skb = calloc(1, sizeof(*skb));
+
+	if (!skb)
+		return NULL;
+
+	skb->head = malloc(size);
+	if (!skb->head) {
+		free(skb);
+		return NULL;
+	}
+
+	skb->data = skb->head;
+	skb->end = size;
+	return skb;
+}
+
+/* Stands in for the flow dissector, addresses only */
+u32 skb_get_hash(struct sk_buff *skb)
+{
+	const u8 *p = skb_mac_header(skb);
+	u32 hash = 2166136261u;
+	unsigned int i;
+
+	for (i = 0; i < 2 * ETH_ALEN; i++)
+		hash = (hash ^ p[i]) * 16777619u;
+
+	if (skb->protocol == htons(ETH_P_IP)) {
+		p = (const u8 *)&((struct iphdr *)skb->data)->saddr;
+		for (i = 0; i < 8; i++)
+			hash = (hash ^ p[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+/* Unlike the kernel the data is copied, so egress may modify clones
+ * without any copy-on-write bookkeeping.
+ */
+struct sk_buff *skb_clone(struct sk_buff *skb, gfp_t gfp)
+{
+	struct sk_buff *n = alloc_skb(skb->end, gfp);
+	unsigned char *head;
+
+	if (!n)
+		return NULL;
+
+	head = n->head;
+	*n = *skb;
+	n->head = head;
+	n->data = head + (skb->data - skb->head);
+	memcpy(head, skb->head, skb->end);
+	return n;
+}
+
+void kfree_skb(struct sk_buff *skb)
+{
+	if (!skb)
+		return;
+
+	free(skb->head);
+	free(skb);
+}
+
+/* Mirrors the core receive path, data points past the Ethernet header */
+struct sk_buff *skb_vlan_untag(struct sk_buff *skb)
+{
+	struct vlan_hdr *vhdr;
+
+	if (skb_vlan_tag_present(skb) || skb->len < VLAN_HLEN)
+		return skb;
+
+	vhdr = (struct vlan_hdr *)skb->data;
+	__vlan_hwaccel_put_tag(skb, skb->protocol, ntohs(vhdr->h_vlan_TCI));
+	skb->protocol = vhdr->h_vlan_encapsulated_proto;
+
+	skb_pull(skb, VLAN_HLEN);
+	memmove(skb_mac_header(skb) + VLAN_HLEN, skb_mac_header(skb),
+		2 * ETH_ALEN);
+	skb->mac_header += VLAN_HLEN;
+
+	skb_reset_network_header(skb);
+	skb_reset_mac_len(skb);
+	return skb;
+}
+
+/* Put a tag in the frame data, right after the source address.  On
+ * egress data points to the MAC header and moves with it, on ingress
+ * it points to the payload which stays where it is.
+ */
+static int __vlan_insert_tag(struct sk_buff *skb, __be16 vlan_proto,
+			     u16 vlan_tci)
+{
+	bool at_mac = skb->data == skb_mac_header(skb);
+	struct vlan_ethhdr *veth;
+
+	if (skb->mac_header < VLAN_HLEN)
+		return -ENOMEM;
+
+	skb->mac_header -= VLAN_HLEN;
+	if (at_mac)
+		skb_push(skb, VLAN_HLEN);
+
+	memmove(skb_mac_header(skb), skb_mac_header(skb) + VLAN_HLEN,
+		2 * ETH_ALEN);
+
+	veth = (struct vlan_ethhdr *)skb_mac_header(skb);
+	veth->h_vlan_proto = vlan_proto;
+	veth->h_vlan_TCI = htons(vlan_tci);
+	return 0;
+}
+
+struct sk_buff *vlan_insert_tag_set_proto(struct sk_buff *skb,
+					  __be16 vlan_proto, u16 vlan_tci)
+{
+	if (__vlan_insert_tag(skb, vlan_proto, vlan_tci)) {
+		kfree_skb(skb);
+		return NULL;
+	}
+
+	skb->protocol = vlan_proto;
+	return skb;
+}
+
+struct sk_buff *__vlan_hwaccel_push_inside(struct sk_buff *skb)
+{
+	skb = vlan_insert_tag_set_proto(skb, skb->vlan_proto, skb->vlan_tci);
+	if (likely(skb))
+		__vlan_hwaccel_clear_tag(skb);
+
+	return skb;
+}
+
+int skb_vlan_push(struct sk_buff *skb, __be16 vlan_proto, u16 vlan_tci)
+{
+	int err;
+
+	if (skb_vlan_tag_present(skb)) {
+		err = __vlan_insert_tag(skb, skb->vlan_proto, skb->vlan_tci);
+		if (err)
+			return err;
+
+		skb->protocol = skb->vlan_proto;
+		skb->mac_len += VLAN_HLEN;
+	}
+
+	__vlan_hwaccel_put_tag(skb, vlan_proto, vlan_tci);
+	return 0;
+}
+
+/* Data points to the MAC header, as in the kernel */
+int skb_vlan_pop(struct sk_buff *skb)
+{
+	struct vlan_ethhdr *veth = (struct vlan_ethhdr *)skb->data;
+
+	if (skb_vlan_tag_present(skb)) {
+		__vlan_hwaccel_clear_tag(skb);
+	} else {
+		if (!eth_type_vlan(skb->protocol) || skb->len < ETH_HLEN + VLAN_HLEN)
+			return 0;
+
+		skb->protocol = veth->h_vlan_encapsulated_proto;
+		memmove(skb->data + VLAN_HLEN, skb->data, 2 * ETH_ALEN);
+		skb_pull(skb, VLAN_HLEN);
+		skb->mac_header += VLAN_HLEN;
+		if (skb->network_header < skb->mac_header + ETH_HLEN)
+			skb->network_header = skb->mac_header + ETH_HLEN;
+		skb_reset_mac_len(skb);
+	}
+
+	/* Move the next tag, if any, to the metadata */
+	if (!eth_type_vlan(skb->protocol) || skb->len < ETH_HLEN + VLAN_HLEN)
+		return 0;
+
+	veth = (struct vlan_ethhdr *)skb->data;
+	__vlan_hwaccel_put_tag(skb, skb->protocol, ntohs(veth->h_vlan_TCI));
+	skb->protocol = veth->h_vlan_encapsulated_proto;
+	memmove(skb->data + VLAN_HLEN, skb->data, 2 * ETH_ALEN);
+	skb_pull(skb, VLAN_HLEN);
+	skb->mac_header += VLAN_HLEN;
+	skb_reset_mac_len(skb);
+	return 0;
+}
+
+__be16 __vlan_get_protocol(const struct sk_buff *skb, __be16 type, int *depth)
+{
+	unsigned int vlan_depth = skb->mac_len, parse_depth = VLAN_MAX_DEPTH;
+
+	if (eth_type_vlan(type)) {
+		if (vlan_depth) {
+			if (vlan_depth < VLAN_HLEN)
+				return 0;
+			vlan_depth -= VLAN_HLEN;
+		} else {
+			vlan_depth = ETH_HLEN;
+		}
+
+		do {
+			struct vlan_hdr *vh;
+
+			if (!parse_depth--)
+				return 0;
+
+			vh = skb_header_pointer(skb, vlan_depth, sizeof(*vh), NULL);
+			if (!vh)
+				return 0;
+
+			type = vh->h_vlan_encapsulated_proto;
+			vlan_depth += VLAN_HLEN;
+		} while (eth_type_vlan(type));
+	}
+
+	if (depth)
+		*depth = vlan_depth;
+
+	return type;
+}
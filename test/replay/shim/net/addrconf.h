@@ -0,0 +1 @@
+/* Provided by ubr-shim.h */
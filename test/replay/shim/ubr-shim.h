@@ -0,0 +1,1099 @@
+/*
+ * Minimal userspace stand-ins for the kernel APIs used by the
+ * forwarding pipeline, just enough to build ubr-fdb.c, ubr-forward.c,
+ * ubr-police.c and ubr-vlan.c unmodified.  Forced in front of every
+ * source file with -include, so the <linux/...> and <net/...> headers
+ * under shim/ are all empty.
+ *
+ * Everything runs on a single "CPU", RCU read sections are no-ops and
+ * RCU callbacks and work items are deferred until the driver calls
+ * shim_quiesce() between frames.  Time only moves when the driver
+ * advances it, usually from the capture timestamps.
+ */
+#ifndef __UBR_SHIM_H
+#define __UBR_SHIM_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+/* Constant expressions, the kernel uses htons() in case labels */
+#undef htons
+#undef ntohs
+#undef htonl
+#undef ntohl
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define htons(x)	((u16)__builtin_bswap16(x))
+#define htonl(x)	((u32)__builtin_bswap32(x))
+#else
+#define htons(x)	((u16)(x))
+#define htonl(x)	((u32)(x))
+#endif
+#define ntohs(x)	htons(x)
+#define ntohl(x)	htonl(x)
+
+typedef u16 __be16;
+typedef u32 __be32;
+typedef unsigned int gfp_t;
+
+/* Compiler and config */
+#define __rcu
+#define __percpu
+#define __read_mostly
+#define __init
+#define __exit
+#define __packed	__attribute__((packed))
+#define __aligned(x)	__attribute__((aligned(x)))
+
+#define likely(x)	__builtin_expect(!!(x), 1)
+#define unlikely(x)	__builtin_expect(!!(x), 0)
+
+#define READ_ONCE(x)		(*(volatile typeof(x) *)&(x))
+#define WRITE_ONCE(x, val)	(*(volatile typeof(x) *)&(x) = (val))
+
+#define __ARG_PLACEHOLDER_1 0,
+#define __take_second_arg(__ignored, val, ...) val
+#define __is_defined(x)			___is_defined(x)
+#define ___is_defined(val)		____is_defined(__ARG_PLACEHOLDER_##val)
+#define ____is_defined(arg1_or_junk)	__take_second_arg(arg1_or_junk 1, 0)
+#define IS_ENABLED(option)		__is_defined(option)
+
+#define EXPORT_SYMBOL(sym)
+#define EXPORT_SYMBOL_GPL(sym)
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define struct_size(p, member, n) \
+	(sizeof(*(p)) + sizeof((p)->member[0]) * (n))
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define min_t(t, a, b)		((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b)		((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+
+#define WARN_ON(x)		unlikely(!!(x))
+#define BUG_ON(x)		do { if (x) abort(); } while (0)
+
+#define IS_ERR_VALUE(x)		unlikely((unsigned long)(x) >= (unsigned long)-4095)
+static inline void *ERR_PTR(long err)        { return (void *)err; }
+static inline long PTR_ERR(const void *ptr)  { return (long)ptr; }
+static inline bool IS_ERR(const void *ptr)   { return IS_ERR_VALUE(ptr); }
+static inline bool IS_ERR_OR_NULL(const void *ptr)
+{
+	return !ptr || IS_ERR_VALUE(ptr);
+}
+
+#define KERN_NOTICE ""
+#define KERN_INFO   ""
+#define KERN_ERR    ""
+extern int shim_verbose;
+#define printk(fmt, ...) \
+	do { if (shim_verbose) fprintf(stderr, fmt, ##__VA_ARGS__); } while (0)
+
+#define smp_wmb()		__sync_synchronize()
+#define cond_resched()		do { } while (0)
+#define local_bh_disable()	do { } while (0)
+#define local_bh_enable()	do { } while (0)
+
+/* Bitmaps */
+#define BITS_PER_LONG		(sizeof(long) * 8)
+#define BITS_TO_LONGS(n)	DIV_ROUND_UP(n, BITS_PER_LONG)
+#define BIT_WORD(n)		((n) / BITS_PER_LONG)
+#define BIT_MASK(n)		(1UL << ((n) % BITS_PER_LONG))
+
+static inline void set_bit(long nr, unsigned long *addr)
+{
+	addr[BIT_WORD(nr)] |= BIT_MASK(nr);
+}
+
+static inline void clear_bit(long nr, unsigned long *addr)
+{
+	addr[BIT_WORD(nr)] &= ~BIT_MASK(nr);
+}
+
+static inline bool test_bit(long nr, const unsigned long *addr)
+{
+	return !!(addr[BIT_WORD(nr)] & BIT_MASK(nr));
+}
+
+#define __bitmap_loop(dst, nbits, expr) do {				\
+	unsigned int __k;						\
+	for (__k = 0; __k < BITS_TO_LONGS(nbits); __k++)		\
+		(dst)[__k] = (expr);					\
+} while (0)
+
+static inline void bitmap_zero(unsigned long *dst, unsigned int nbits)
+{
+	memset(dst, 0, BITS_TO_LONGS(nbits) * sizeof(long));
+}
+
+static inline void bitmap_fill(unsigned long *dst, unsigned int nbits)
+{
+	memset(dst, 0xff, BITS_TO_LONGS(nbits) * sizeof(long));
+}
+
+static inline bool bitmap_and(unsigned long *dst, const unsigned long *a,
+			      const unsigned long *b, unsigned int nbits)
+{
+	unsigned long any = 0;
+	unsigned int k;
+
+	for (k = 0; k < BITS_TO_LONGS(nbits); k++)
+		any |= (dst[k] = a[k] & b[k]);
+
+	return !!any;
+}
+
+static inline void bitmap_or(unsigned long *dst, const unsigned long *a,
+			     const unsigned long *b, unsigned int nbits)
+{
+	__bitmap_loop(dst, nbits, a[__k] | b[__k]);
+}
+
+static inline bool bitmap_andnot(unsigned long *dst, const unsigned long *a,
+				 const unsigned long *b, unsigned int nbits)
+{
+	unsigned long any = 0;
+	unsigned int k;
+
+	for (k = 0; k < BITS_TO_LONGS(nbits); k++)
+		any |= (dst[k] = a[k] & ~b[k]);
+
+	return !!any;
+}
+
+static inline void bitmap_copy(unsigned long *dst, const unsigned long *src,
+			       unsigned int nbits)
+{
+	memcpy(dst, src, BITS_TO_LONGS(nbits) * sizeof(long));
+}
+
+static inline bool bitmap_empty(const unsigned long *src, unsigned int nbits)
+{
+	unsigned int k;
+
+	for (k = 0; k < BITS_TO_LONGS(nbits); k++)
+		if (src[k])
+			return false;
+
+	return true;
+}
+
+static inline bool bitmap_equal(const unsigned long *a, const unsigned long *b,
+				unsigned int nbits)
+{
+	return !memcmp(a, b, BITS_TO_LONGS(nbits) * sizeof(long));
+}
+
+static inline bool bitmap_intersects(const unsigned long *a,
+				     const unsigned long *b, unsigned int nbits)
+{
+	unsigned int k;
+
+	for (k = 0; k < BITS_TO_LONGS(nbits); k++)
+		if (a[k] & b[k])
+			return true;
+
+	return false;
+}
+
+static inline unsigned int bitmap_weight(const unsigned long *src,
+					 unsigned int nbits)
+{
+	unsigned int k, w = 0;
+
+	for (k = 0; k < BITS_TO_LONGS(nbits); k++)
+		w += __builtin_popcountl(src[k]);
+
+	return w;
+}
+
+static inline unsigned long find_next_bit(const unsigned long *addr,
+					  unsigned long size,
+					  unsigned long offset)
+{
+	unsigned long word;
+
+	if (offset >= size)
+		return size;
+
+	word = addr[BIT_WORD(offset)] & (~0UL << (offset % BITS_PER_LONG));
+	offset -= offset % BITS_PER_LONG;
+
+	while (!word) {
+		offset += BITS_PER_LONG;
+		if (offset >= size)
+			return size;
+		word = addr[BIT_WORD(offset)];
+	}
+
+	offset += __builtin_ctzl(word);
+	return offset < size ? offset : size;
+}
+
+#define find_first_bit(addr, size) find_next_bit((addr), (size), 0)
+
+#define for_each_set_bit(bit, addr, size)				\
+	for ((bit) = find_next_bit((addr), (size), 0);			\
+	     (bit) < (size);						\
+	     (bit) = find_next_bit((addr), (size), (bit) + 1))
+
+#define for_each_set_bit_from(bit, addr, size)				\
+	for ((bit) = find_next_bit((addr), (size), (bit));		\
+	     (bit) < (size);						\
+	     (bit) = find_next_bit((addr), (size), (bit) + 1))
+
+/* Atomics, there is only one CPU */
+typedef struct { int counter; } atomic_t;
+typedef struct { s64 counter; } atomic64_t;
+typedef struct { unsigned int refs; } refcount_t;
+
+#define ATOMIC_INIT(i)		{ (i) }
+#define atomic_read(v)		READ_ONCE((v)->counter)
+#define atomic_set(v, i)	WRITE_ONCE((v)->counter, (i))
+#define atomic_add(i, v)	((v)->counter += (i))
+#define atomic_sub(i, v)	((v)->counter -= (i))
+#define atomic_inc(v)		((v)->counter++)
+#define atomic_dec(v)		((v)->counter--)
+#define atomic64_read(v)	READ_ONCE((v)->counter)
+#define atomic64_inc(v)		((v)->counter++)
+
+/* Static keys, a plain counter tested at runtime */
+struct static_key_false { atomic_t enabled; };
+
+#define DEFINE_STATIC_KEY_FALSE(name)	struct static_key_false name = {}
+#define DECLARE_STATIC_KEY_FALSE(name)	extern struct static_key_false name
+#define static_branch_unlikely(x)	unlikely(atomic_read(&(x)->enabled) > 0)
+#define static_branch_likely(x)		likely(atomic_read(&(x)->enabled) > 0)
+#define static_branch_inc(x)		atomic_inc(&(x)->enabled)
+#define static_branch_dec(x)		atomic_dec(&(x)->enabled)
+
+/* Memory */
+#define GFP_KERNEL		0x01u
+#define GFP_ATOMIC		0x02u
+#define __GFP_NOWARN		0x04u
+#define __GFP_ZERO		0x08u
+#define SLAB_HWCACHE_ALIGN	0x01u
+
+static inline void *kmalloc(size_t size, gfp_t gfp)
+{
+	return (gfp & __GFP_ZERO) ? calloc(1, size) : malloc(size);
+}
+
+#define kzalloc(size, gfp)	calloc(1, (size))
+#define kcalloc(n, size, gfp)	calloc((n), (size))
+#define kvcalloc(n, size, gfp)	calloc((n), (size))
+#define kvzalloc(size, gfp)	calloc(1, (size))
+#define vzalloc(size)		calloc(1, (size))
+#define kfree(p)		free((void *)(p))
+#define kvfree(p)		free((void *)(p))
+#define vfree(p)		free((void *)(p))
+
+static inline void *kmemdup(const void *src, size_t len, gfp_t gfp)
+{
+	void *p = malloc(len);
+
+	if (p)
+		memcpy(p, src, len);
+
+	return p;
+}
+
+struct kmem_cache {
+	size_t size;
+};
+
+struct kmem_cache *kmem_cache_create(const char *name, unsigned int size,
+				     unsigned int align, unsigned int flags,
+				     void (*ctor)(void *));
+void kmem_cache_destroy(struct kmem_cache *c);
+
+#define kmem_cache_alloc(c, gfp)	malloc((c)->size)
+#define kmem_cache_zalloc(c, gfp)	calloc(1, (c)->size)
+#define kmem_cache_free(c, p)		free(p)
+
+/* Per-CPU data */
+#define NR_CPUS 1
+
+#define alloc_percpu(type)		((type *)calloc(1, sizeof(type)))
+#define alloc_percpu_gfp(type, gfp)	alloc_percpu(type)
+#define netdev_alloc_pcpu_stats(type)	alloc_percpu(type)
+#define free_percpu(p)			free(p)
+#define this_cpu_ptr(p)			(p)
+#define per_cpu_ptr(p, cpu)		((void)(cpu), (p))
+#define get_cpu_ptr(p)			(p)
+#define put_cpu_ptr(p)			do { } while (0)
+#define smp_processor_id()		0
+#define for_each_possible_cpu(cpu)	for ((cpu) = 0; (cpu) < NR_CPUS; (cpu)++)
+#define for_each_online_cpu(cpu)	for_each_possible_cpu(cpu)
+
+struct percpu_counter {
+	s64 count;
+};
+
+#define percpu_counter_init(fbc, val, gfp)	((fbc)->count = (val), 0)
+#define percpu_counter_destroy(fbc)		do { } while (0)
+#define percpu_counter_inc(fbc)			((fbc)->count++)
+#define percpu_counter_dec(fbc)			((fbc)->count--)
+#define percpu_counter_add(fbc, n)		((fbc)->count += (n))
+#define percpu_counter_read(fbc)		((fbc)->count)
+#define percpu_counter_sum(fbc)			((fbc)->count)
+#define percpu_counter_sum_positive(fbc)	((fbc)->count > 0 ? (fbc)->count : 0)
+#define percpu_counter_compare(fbc, rhs) \
+	(((fbc)->count > (s64)(rhs)) - ((fbc)->count < (s64)(rhs)))
+
+typedef struct { u64 v; } u64_stats_t;
+struct u64_stats_sync { };
+
+#define u64_stats_update_begin(syncp)		do { } while (0)
+#define u64_stats_update_end(syncp)		do { } while (0)
+#define u64_stats_fetch_begin_irq(syncp)	0
+#define u64_stats_fetch_retry_irq(syncp, s)	false
+#define u64_stats_init(syncp)			do { } while (0)
+#define u64_stats_inc(p)			((p)->v++)
+#define u64_stats_add(p, n)			((p)->v += (n))
+#define u64_stats_read(p)			((p)->v)
+
+/* Time */
+#define HZ		1000
+#define MSEC_PER_SEC	1000L
+#define NSEC_PER_SEC	1000000000L
+#define NSEC_PER_MSEC	1000000L
+
+extern unsigned long jiffies;
+extern u64 shim_now_ns;
+
+#define msecs_to_jiffies(ms)		((unsigned long)(ms))
+#define jiffies_to_msecs(j)		((unsigned int)(j))
+#define time_after(a, b)		((long)((b) - (a)) < 0)
+#define time_before(a, b)		time_after(b, a)
+#define time_is_before_jiffies(a)	time_after(jiffies, a)
+#define time_is_after_jiffies(a)	time_before(jiffies, a)
+
+static inline u64 ktime_get_ns(void)
+{
+	return shim_now_ns;
+}
+
+/* RCU, callbacks run from shim_quiesce() */
+struct rcu_head {
+	struct rcu_head *next;
+	void (*func)(struct rcu_head *head);
+};
+
+#define rcu_read_lock()				do { } while (0)
+#define rcu_read_unlock()			do { } while (0)
+#define rcu_read_lock_bh()			do { } while (0)
+#define rcu_read_unlock_bh()			do { } while (0)
+#define rcu_dereference(p)			(p)
+#define rcu_dereference_bh(p)			(p)
+#define rcu_dereference_protected(p, c)		(p)
+#define rtnl_dereference(p)			(p)
+#define lockdep_is_held(l)			1
+#define lockdep_assert_held(l)			do { } while (0)
+#define rcu_access_pointer(p)			(p)
+#define rcu_assign_pointer(p, v)		do { smp_wmb(); (p) = (v); } while (0)
+#define RCU_INIT_POINTER(p, v)			((p) = (v))
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head));
+void shim_kfree_rcu(void *ptr, struct rcu_head *head);
+void synchronize_rcu(void);
+void rcu_barrier(void);
+
+#define kfree_rcu(ptr, field) do {					\
+	typeof(ptr) __kfree_p = (ptr);					\
+	if (__kfree_p)							\
+		shim_kfree_rcu(__kfree_p, &__kfree_p->field);		\
+} while (0)
+
+/* Lock-less lists */
+struct llist_node {
+	struct llist_node *next;
+};
+
+struct llist_head {
+	struct llist_node *first;
+};
+
+#define llist_entry(ptr, type, member)	container_of(ptr, type, member)
+#define init_llist_head(h)		((h)->first = NULL)
+#define llist_empty(h)			(READ_ONCE((h)->first) == NULL)
+
+#define member_address_is_nonnull(ptr, member) \
+	((uintptr_t)(ptr) + offsetof(typeof(*(ptr)), member) != 0)
+
+#define llist_for_each_entry_safe(pos, n, node, member)			\
+	for (pos = llist_entry((node), typeof(*pos), member);		\
+	     member_address_is_nonnull(pos, member) &&			\
+		(n = llist_entry(pos->member.next, typeof(*n), member), true); \
+	     pos = n)
+
+static inline bool llist_add_batch(struct llist_node *first,
+				   struct llist_node *last,
+				   struct llist_head *head)
+{
+	last->next = head->first;
+	head->first = first;
+	return last->next == NULL;
+}
+
+static inline bool llist_add(struct llist_node *node, struct llist_head *head)
+{
+	return llist_add_batch(node, node, head);
+}
+
+static inline struct llist_node *llist_del_first(struct llist_head *head)
+{
+	struct llist_node *node = head->first;
+
+	if (node)
+		head->first = node->next;
+
+	return node;
+}
+
+static inline struct llist_node *llist_del_all(struct llist_head *head)
+{
+	struct llist_node *node = head->first;
+
+	head->first = NULL;
+	return node;
+}
+
+/* Hash lists and fixed size hash tables */
+struct hlist_node {
+	struct hlist_node *next, **pprev;
+};
+
+struct hlist_head {
+	struct hlist_node *first;
+};
+
+#define hlist_entry(ptr, type, member) container_of(ptr, type, member)
+#define hlist_entry_safe(ptr, type, member) \
+	({ typeof(ptr) ____ptr = (ptr); \
+	   ____ptr ? hlist_entry(____ptr, type, member) : NULL; })
+
+static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
+{
+	n->next = h->first;
+	if (n->next)
+		n->next->pprev = &n->next;
+	h->first = n;
+	n->pprev = &h->first;
+}
+
+static inline void hlist_del_init(struct hlist_node *n)
+{
+	if (!n->pprev)
+		return;
+
+	*n->pprev = n->next;
+	if (n->next)
+		n->next->pprev = n->pprev;
+	n->next = NULL;
+	n->pprev = NULL;
+}
+
+#define hlist_for_each_entry(pos, head, member)				\
+	for (pos = hlist_entry_safe((head)->first, typeof(*(pos)), member); \
+	     pos;							\
+	     pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+
+#define hlist_for_each_entry_safe(pos, n, head, member)			\
+	for (pos = hlist_entry_safe((head)->first, typeof(*pos), member); \
+	     pos && ({ n = pos->member.next; 1; });			\
+	     pos = hlist_entry_safe(n, typeof(*pos), member))
+
+#define DECLARE_HASHTABLE(name, bits) struct hlist_head name[1 << (bits)]
+#define HASH_SIZE(name)		ARRAY_SIZE(name)
+#define hash_min(key, size)	((u32)(key) * 0x61C88647u % (size))
+
+#define hash_init(table)	memset((table), 0, sizeof(table))
+
+static inline u32 hash_32(u32 val, unsigned int bits)
+{
+	return bits ? (val * 0x61C88647u) >> (32 - bits) : 0;
+}
+
+#define ilog2(n)		(31 - __builtin_clz(n))
+#define roundup_pow_of_two(n)	((n) > 1 ? 1u << (32 - __builtin_clz((n) - 1)) : 1u)
+#define hash_add(table, node, key) \
+	hlist_add_head((node), &(table)[hash_min((key), HASH_SIZE(table))])
+#define hash_del(node)		hlist_del_init(node)
+#define hash_add_rcu		hash_add
+#define hash_del_rcu		hash_del
+
+#define hash_for_each(name, bkt, obj, member)				\
+	for ((bkt) = 0, (obj) = NULL; (obj) == NULL && (bkt) < HASH_SIZE(name); \
+	     (bkt)++)							\
+		hlist_for_each_entry(obj, &(name)[bkt], member)
+
+#define hash_for_each_safe(name, bkt, tmp, obj, member)			\
+	for ((bkt) = 0, (obj) = NULL; (obj) == NULL && (bkt) < HASH_SIZE(name); \
+	     (bkt)++)							\
+		hlist_for_each_entry_safe(obj, tmp, &(name)[bkt], member)
+
+#define hash_for_each_possible(name, obj, member, key)			\
+	hlist_for_each_entry(obj, &(name)[hash_min((key), HASH_SIZE(name))], member)
+
+#define hash_for_each_rcu		hash_for_each
+#define hash_for_each_possible_rcu(name, obj, member, key, cond...) \
+	hash_for_each_possible(name, obj, member, key)
+
+/* Resizable hash tables, chained buckets that double when full */
+struct rhash_head {
+	struct rhash_head *next;
+};
+
+struct rhashtable_params {
+	u16 key_len;
+	u16 key_offset;
+	u16 head_offset;
+	bool automatic_shrinking;
+};
+
+struct rhashtable {
+	struct rhash_head **buckets;
+	unsigned int size;
+	unsigned int nelems;
+	struct rhashtable_params p;
+};
+
+struct rhashtable_iter {
+	struct rhashtable *ht;
+	unsigned int bucket;
+	struct rhash_head *next;
+};
+
+int   rhashtable_init(struct rhashtable *ht, const struct rhashtable_params *params);
+void  rhashtable_destroy(struct rhashtable *ht);
+void *rhashtable_lookup(struct rhashtable *ht, const void *key,
+			const struct rhashtable_params params);
+int   rhashtable_lookup_insert_fast(struct rhashtable *ht, struct rhash_head *obj,
+				    const struct rhashtable_params params);
+int   rhashtable_remove_fast(struct rhashtable *ht, struct rhash_head *obj,
+			     const struct rhashtable_params params);
+
+#define rhashtable_lookup_fast rhashtable_lookup
+
+void  rhashtable_walk_enter(struct rhashtable *ht, struct rhashtable_iter *iter);
+void *rhashtable_walk_next(struct rhashtable_iter *iter);
+#define rhashtable_walk_start(iter)	do { } while (0)
+#define rhashtable_walk_stop(iter)	do { } while (0)
+#define rhashtable_walk_exit(iter)	do { } while (0)
+
+/* Work queues, pending items run from shim_quiesce() */
+/* Single threaded, configuration is never contended */
+struct mutex { int locked; };
+
+#define mutex_init(m)				((m)->locked = 0)
+#define mutex_lock(m)				((m)->locked = 1)
+#define mutex_unlock(m)				((m)->locked = 0)
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+	work_func_t func;
+	bool pending;
+	struct work_struct *next;
+};
+
+struct delayed_work {
+	struct work_struct work;
+	unsigned long expires;
+	bool queued;
+	struct delayed_work *next;
+};
+
+struct workqueue_struct;
+extern struct workqueue_struct *system_wq;
+extern struct workqueue_struct *system_long_wq;
+
+#define INIT_WORK(w, f) \
+	do { memset((w), 0, sizeof(*(w))); (w)->func = (f); } while (0)
+#define INIT_DELAYED_WORK(dw, f) \
+	do { memset((dw), 0, sizeof(*(dw))); (dw)->work.func = (f); } while (0)
+#define to_delayed_work(w) container_of((w), struct delayed_work, work)
+
+bool schedule_work(struct work_struct *work);
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+bool queue_delayed_work(struct workqueue_struct *wq, struct delayed_work *dw,
+			unsigned long delay);
+bool cancel_work_sync(struct work_struct *work);
+bool cancel_delayed_work_sync(struct delayed_work *dw);
+
+#define schedule_delayed_work(dw, delay) \
+	queue_delayed_work(system_wq, (dw), (delay))
+
+/* Ethernet */
+#define ETH_ALEN	6
+#define ETH_TLEN	2
+#define ETH_HLEN	14
+#define ETH_ZLEN	60
+#define ETH_DATA_LEN	1500
+#define ETH_FRAME_LEN	1514
+#define ETH_P_IP	0x0800
+#define ETH_P_ARP	0x0806
+#define ETH_P_8021Q	0x8100
+#define ETH_P_IPV6	0x86DD
+#define ETH_P_8021AD	0x88A8
+
+#define VLAN_HLEN	4
+#define VLAN_ETH_HLEN	18
+#define VLAN_N_VID	4096
+#define VLAN_VID_MASK	0x0fff
+#define VLAN_PRIO_MASK	0xe000
+#define VLAN_PRIO_SHIFT	13
+#define VLAN_MAX_DEPTH	8
+
+struct ethhdr {
+	u8     h_dest[ETH_ALEN];
+	u8     h_source[ETH_ALEN];
+	__be16 h_proto;
+} __packed;
+
+struct vlan_hdr {
+	__be16 h_vlan_TCI;
+	__be16 h_vlan_encapsulated_proto;
+};
+
+struct vlan_ethhdr {
+	u8     h_dest[ETH_ALEN];
+	u8     h_source[ETH_ALEN];
+	__be16 h_vlan_proto;
+	__be16 h_vlan_TCI;
+	__be16 h_vlan_encapsulated_proto;
+} __packed;
+
+struct iphdr {
+	u8     ihl_version;
+	u8     tos;
+	__be16 tot_len;
+	__be16 id;
+	__be16 frag_off;
+	u8     ttl;
+	u8     protocol;
+	u16    check;
+	__be32 saddr;
+	__be32 daddr;
+};
+
+#define CONFIG_IPV6 1
+/* struct in6_addr comes from <arpa/inet.h> */
+
+struct ipv6hdr {
+	u8     priority_version;
+	u8     flow_lbl[3];
+	__be16 payload_len;
+	u8     nexthdr;
+	u8     hop_limit;
+	struct in6_addr saddr;
+	struct in6_addr daddr;
+};
+
+static inline bool ipv6_addr_any(const struct in6_addr *a)
+{
+	static const struct in6_addr any;
+
+	return !memcmp(a, &any, sizeof(any));
+}
+
+static inline bool ipv6_addr_is_multicast(const struct in6_addr *a)
+{
+	return a->s6_addr[0] == 0xff;
+}
+
+#define ARPHRD_ETHER	1
+#define ARPOP_REQUEST	1
+#define ARPOP_REPLY	2
+
+struct arphdr {
+	__be16 ar_hrd;
+	__be16 ar_pro;
+	u8     ar_hln;
+	u8     ar_pln;
+	__be16 ar_op;
+};
+
+#define NDISC_NEIGHBOUR_SOLICITATION	135
+#define NDISC_NEIGHBOUR_ADVERTISEMENT	136
+
+struct icmp6hdr {
+	u8     icmp6_type;
+	u8     icmp6_code;
+	u16    icmp6_cksum;
+	__be32 icmp6_dataun;
+};
+
+struct nd_msg {
+	struct icmp6hdr icmph;
+	struct in6_addr target;
+	u8 opt[];
+};
+
+static inline bool ether_addr_equal(const u8 *a, const u8 *b)
+{
+	return !memcmp(a, b, ETH_ALEN);
+}
+
+static inline void ether_addr_copy(u8 *dst, const u8 *src)
+{
+	memcpy(dst, src, ETH_ALEN);
+}
+
+static inline bool is_zero_ether_addr(const u8 *addr)
+{
+	static const u8 zero[ETH_ALEN];
+
+	return ether_addr_equal(addr, zero);
+}
+
+static inline bool is_multicast_ether_addr(const u8 *addr)
+{
+	return addr[0] & 0x01;
+}
+
+static inline bool is_broadcast_ether_addr(const u8 *addr)
+{
+	return (addr[0] & addr[1] & addr[2] & addr[3] & addr[4] & addr[5]) == 0xff;
+}
+
+static inline bool is_valid_ether_addr(const u8 *addr)
+{
+	return !is_multicast_ether_addr(addr) && !is_zero_ether_addr(addr);
+}
+
+#define eth_zero_addr(addr) memset((addr), 0, ETH_ALEN)
+
+static inline bool eth_type_vlan(__be16 ethertype)
+{
+	return ethertype == htons(ETH_P_8021Q) ||
+	       ethertype == htons(ETH_P_8021AD);
+}
+
+/* Network devices */
+#define IFNAMSIZ 16
+
+struct net { int unused; };
+extern struct net init_net;
+
+struct net_device_ops;
+
+struct net_device {
+	char name[IFNAMSIZ];
+	int ifindex;
+	unsigned int priv_flags;
+	unsigned char dev_addr[ETH_ALEN];
+	unsigned short needed_headroom;
+	const struct net_device_ops *netdev_ops;
+	void __rcu *rx_handler_data;
+	void *priv;
+};
+
+#define netdev_priv(dev)	((dev)->priv)
+#define dev_hold(dev)		do { } while (0)
+#define dev_put(dev)		do { } while (0)
+#define dev_net(dev)		(&init_net)
+
+#define dev_sw_netstats_rx_add(dev, len)	do { } while (0)
+#define dev_sw_netstats_tx_add(dev, n, len)	do { } while (0)
+
+struct net_device *dev_get_by_index(struct net *net, int ifindex);
+struct net_device *dev_get_by_index_rcu(struct net *net, int ifindex);
+
+/* Socket buffers */
+#define PACKET_HOST		0
+#define PACKET_BROADCAST	1
+#define PACKET_MULTICAST	2
+#define PACKET_OTHERHOST	3
+
+struct sk_buff {
+	struct net_device *dev;
+	char cb[48] __aligned(8);
+
+	unsigned int len;
+	__be16 protocol;
+	__be16 vlan_proto;
+	u16 vlan_tci;
+	u8 vlan_present:1;
+	u8 pkt_type:3;
+
+	u16 mac_header;
+	u16 network_header;
+	u16 mac_len;
+
+	unsigned char *head;
+	unsigned char *data;
+	unsigned int end;
+};
+
+struct sk_buff *alloc_skb(unsigned int size, gfp_t gfp);
+struct sk_buff *skb_clone(struct sk_buff *skb, gfp_t gfp);
+void kfree_skb(struct sk_buff *skb);
+#define consume_skb kfree_skb
+
+/* Frames in the replay never carry a dst */
+static inline void skb_dst_drop(struct sk_buff *skb) {}
+
+static inline unsigned char *skb_mac_header(const struct sk_buff *skb)
+{
+	return skb->head + skb->mac_header;
+}
+
+static inline unsigned char *skb_network_header(const struct sk_buff *skb)
+{
+	return skb->head + skb->network_header;
+}
+
+static inline struct ethhdr *eth_hdr(const struct sk_buff *skb)
+{
+	return (struct ethhdr *)skb_mac_header(skb);
+}
+
+static inline struct iphdr *ip_hdr(const struct sk_buff *skb)
+{
+	return (struct iphdr *)skb_network_header(skb);
+}
+
+static inline struct ipv6hdr *ipv6_hdr(const struct sk_buff *skb)
+{
+	return (struct ipv6hdr *)skb_network_header(skb);
+}
+
+static inline void skb_reset_mac_header(struct sk_buff *skb)
+{
+	skb->mac_header = skb->data - skb->head;
+}
+
+static inline void skb_reset_network_header(struct sk_buff *skb)
+{
+	skb->network_header = skb->data - skb->head;
+}
+
+static inline void skb_set_network_header(struct sk_buff *skb, int offset)
+{
+	skb->network_header = skb->data - skb->head + offset;
+}
+
+static inline void skb_reset_mac_len(struct sk_buff *skb)
+{
+	skb->mac_len = skb->network_header - skb->mac_header;
+}
+
+static inline unsigned int skb_headroom(const struct sk_buff *skb)
+{
+	return skb->data - skb->head;
+}
+
+static inline unsigned char *skb_push(struct sk_buff *skb, unsigned int len)
+{
+	BUG_ON(skb_headroom(skb) < len);
+	skb->data -= len;
+	skb->len += len;
+	return skb->data;
+}
+
+static inline unsigned char *skb_pull(struct sk_buff *skb, unsigned int len)
+{
+	if (len > skb->len)
+		return NULL;
+
+	skb->len -= len;
+	return skb->data += len;
+}
+
+#define __skb_push skb_push
+#define __skb_pull skb_pull
+
+static inline bool pskb_may_pull(struct sk_buff *skb, unsigned int len)
+{
+	return len <= skb->len;
+}
+
+/* Clones have their own copy of the data, see skb_clone() */
+static inline int skb_ensure_writable(struct sk_buff *skb, unsigned int len)
+{
+	return pskb_may_pull(skb, len) ? 0 : -ENOMEM;
+}
+
+static inline void *skb_header_pointer(const struct sk_buff *skb, int offset,
+				       int len, void *buffer)
+{
+	if (offset < -(int)skb_headroom(skb) || offset + len > (int)skb->len)
+		return NULL;
+
+	return skb->data + offset;
+}
+
+/* VLAN acceleration, i.e. the tag kept outside of the frame data */
+#define skb_vlan_tag_present(skb)	((skb)->vlan_present)
+#define skb_vlan_tag_get(skb)		((skb)->vlan_tci)
+#define skb_vlan_tag_get_id(skb)	((skb)->vlan_tci & VLAN_VID_MASK)
+
+static inline void __vlan_hwaccel_put_tag(struct sk_buff *skb,
+					  __be16 vlan_proto, u16 vlan_tci)
+{
+	skb->vlan_proto = vlan_proto;
+	skb->vlan_tci = vlan_tci;
+	skb->vlan_present = 1;
+}
+
+static inline void __vlan_hwaccel_clear_tag(struct sk_buff *skb)
+{
+	skb->vlan_present = 0;
+}
+
+struct sk_buff *skb_vlan_untag(struct sk_buff *skb);
+struct sk_buff *vlan_insert_tag_set_proto(struct sk_buff *skb,
+					  __be16 vlan_proto, u16 vlan_tci);
+struct sk_buff *__vlan_hwaccel_push_inside(struct sk_buff *skb);
+int skb_vlan_push(struct sk_buff *skb, __be16 vlan_proto, u16 vlan_tci);
+int skb_vlan_pop(struct sk_buff *skb);
+__be16 __vlan_get_protocol(const struct sk_buff *skb, __be16 type, int *depth);
+
+int netif_receive_skb(struct sk_buff *skb);
+int dev_queue_xmit(struct sk_buff *skb);
+
+/* No NAPI, host-bound frames are received right away */
+struct gro_cells { int unused; };
+
+static inline int gro_cells_receive(struct gro_cells *gcells,
+				    struct sk_buff *skb)
+{
+	return netif_receive_skb(skb);
+}
+
+u32 skb_get_hash(struct sk_buff *skb);
+
+static inline u32 reciprocal_scale(u32 val, u32 ep_ro)
+{
+	return (u32)(((u64)val * ep_ro) >> 32);
+}
+
+/* Traffic control rate tables */
+#define TC_LINKLAYER_ETHERNET 1
+
+struct tc_ratespec {
+	u8  cell_log;
+	u8  linklayer;
+	u16 overhead;
+	s16 cell_align;
+	u16 mpu;
+	u32 rate;
+};
+
+struct psched_ratecfg {
+	u64 rate_bytes_ps;
+	u8  linklayer;
+};
+
+struct psched_pktrate {
+	u64 rate_pkts_ps;
+};
+
+static inline void psched_ratecfg_precompute(struct psched_ratecfg *r,
+					     const struct tc_ratespec *conf,
+					     u64 rate64)
+{
+	r->rate_bytes_ps = rate64 ? rate64 : conf->rate;
+	r->linklayer = conf->linklayer;
+}
+
+static inline void psched_ppscfg_precompute(struct psched_pktrate *r,
+					    u64 pktrate64)
+{
+	r->rate_pkts_ps = pktrate64;
+}
+
+static inline u64 psched_l2t_ns(const struct psched_ratecfg *r,
+				unsigned int len)
+{
+	return r->rate_bytes_ps ? len * NSEC_PER_SEC / r->rate_bytes_ps : 0;
+}
+
+static inline u64 psched_pkt2t_ns(const struct psched_pktrate *r,
+				  unsigned int pkt_num)
+{
+	return r->rate_pkts_ps ? pkt_num * NSEC_PER_SEC / r->rate_pkts_ps : 0;
+}
+
+/* Netlink, the harness never parses any messages */
+enum {
+	NLA_UNSPEC,
+	NLA_U8,
+	NLA_U16,
+	NLA_U32,
+	NLA_U64,
+	NLA_STRING,
+	NLA_FLAG,
+	NLA_MSECS,
+	NLA_NESTED,
+};
+
+struct nlattr {
+	u16 nla_len;
+	u16 nla_type;
+};
+
+struct nla_policy {
+	u8 type;
+	u16 len;
+};
+
+struct netlink_ext_ack;
+
+struct genl_info {
+	struct nlattr **attrs;
+	struct netlink_ext_ack *extack;
+};
+
+#define NLA_HDRLEN		((int)sizeof(struct nlattr))
+#define nla_data(nla)		((void *)((char *)(nla) + NLA_HDRLEN))
+#define nla_len(nla)		((int)(nla)->nla_len - NLA_HDRLEN)
+#define nla_type(nla)		((nla)->nla_type)
+#define nla_get_u8(nla)		(*(u8 *)nla_data(nla))
+#define nla_get_u16(nla)	(*(u16 *)nla_data(nla))
+#define nla_get_u32(nla)	(*(u32 *)nla_data(nla))
+#define nla_get_u64(nla)	(*(u64 *)nla_data(nla))
+#define nla_get_in_addr(nla)	(*(__be32 *)nla_data(nla))
+#define nla_get_in6_addr(nla)	(*(struct in6_addr *)nla_data(nla))
+#define nla_get_flag(nla)	(!!(nla))
+
+#define nla_for_each_nested(pos, nla, rem) \
+	for ((pos) = NULL, (rem) = 0; (pos) && (rem) > 0; )
+
+#define NL_SET_ERR_MSG(extack, msg)	do { } while (0)
+#define genl_info_net(info)		(&init_net)
+
+static inline int nla_parse_nested(struct nlattr **tb, int maxtype,
+				   const struct nlattr *nla,
+				   const struct nla_policy *policy,
+				   struct netlink_ext_ack *extack)
+{
+	return -EOPNOTSUPP;
+}
+
+/* Driver hooks */
+void shim_quiesce(void);
+void shim_set_time(u64 ns);
+
+#endif	/* __UBR_SHIM_H */
@@ -0,0 +1,89 @@
+#!/bin/sh
+# Verify switchdev port detection against netdevsim
+# - Two netdevsim ports, sharing a parent ID, and one veth
+#   - Expect: offload on for the netdevsim ports, off for the veth
+# - Set port flags and PVID, and attach a VLAN, on the netdevsim ports,
+#   then delete a VLAN that still has them as members
+#   - Expect: all succeed, without rtnl assertions in the kernel log
+# - Remove one netdevsim port
+#   - Expect: the other one stays offloaded
+# - Remove the bridge
+#   - Expect: clean teardown, netdevsim device can be deleted
+#
+# netdevsim implements neither switchdev objects nor FDB events, this
+# covers domain membership and the fallback when a driver returns
+# -EOPNOTSUPP.
+
+br=ubr-sw
+fail=0
+
+mkdir -p sys
+grep -q sysfs /proc/mounts || mount -t sysfs sysfs sys
+
+check() {
+    local port=$1 expect=$2
+
+    if ubr -i $br port $port show | grep -qE "offload +$expect"; then
+	echo "PASS $port offload $expect"
+    else
+	echo "FAIL $port offload $expect"
+	fail=1
+    fi
+}
+
+run() {
+    if ubr -i $br "$@"; then
+	echo "PASS $*"
+    else
+	echo "FAIL $*"
+	fail=1
+    fi
+}
+
+echo "1 2" >/sys/bus/netdevsim/new_device || exit 1
+sleep 1
+nsim=$(ls /sys/bus/netdevsim/devices/netdevsim1/net/)
+set -- $nsim
+nsim0=$1
+nsim1=$2
+
+ip link add dev $br type ubr
+ip link add dev ubr-sw-v0 type veth peer name ubr-sw-v1
+
+for port in $nsim0 $nsim1 ubr-sw-v0; do
+    ip link set dev $port master $br
+    ip link set dev $port up
+done
+ip link set dev $br up
+
+check $nsim0 on
+check $nsim1 on
+check ubr-sw-v0 off
+
+dmesg -c >/dev/null
+run vlan 10 add
+for port in $nsim0 $nsim1; do
+    run port $port set learning off flood-unicast off
+    run vlan 10 attach $port tagged
+    run port $port set pvid 10
+done
+run vlan 10 detach "$nsim0 $nsim1"
+run vlan 20 add
+run vlan 20 attach "$nsim0 $nsim1" tagged
+run vlan 20 del
+
+if dmesg | grep -q "RTNL: assertion failed"; then
+    echo "FAIL switchdev calls without rtnl"
+    fail=1
+else
+    echo "PASS switchdev calls under rtnl"
+fi
+
+ip link set dev $nsim0 nomaster
+check $nsim1 on
+
+ip link del dev $br
+ip link del dev ubr-sw-v0
+echo 1 >/sys/bus/netdevsim/del_device || fail=1
+
+exit $fail
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+mkdir -p proc
+mount -t proc proc proc
+
+insmod /lib/ubr.ko
+
+/bench.sh
+halt -f
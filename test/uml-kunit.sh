@@ -0,0 +1,14 @@
+#!/bin/sh
+
+mkdir -p proc
+mount -t proc proc proc
+
+insmod /lib/ubr.ko
+insmod /lib/ubr-test.ko
+
+# KUnit reports in KTAP format on the kernel log
+dmesg | sed -n '/TAP version/,$p'
+
+dmesg | grep -q 'not ok' || halt -f
+
+exit 1
@@ -5,6 +5,6 @@ mount -t proc proc proc
 
 insmod /lib/ubr.ko
 
-/test.sh && halt -f
+/test.sh && /switchdev.sh && halt -f
 
 exit 1